@@ -17,8 +17,8 @@ public:
     }
 
 private:
-    Status SayHello(Channel& c, const std::string& name) {
-        auto html = std::string("<b>Hello, ") + name + "</b>\n";
+    Status SayHello(Channel& c, std::string_view name) {
+        auto html = std::string("<b>Hello, ").append(name) + "</b>\n";
         c.GetResponse().SetContent(html);
         return Status::Ok;
     }
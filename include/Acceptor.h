@@ -1,6 +1,7 @@
 #pragma once
 
 #include "IPEndpoint.h"
+#include "Poller.h"
 #include "Profiler.h"
 #include "Semaphore.h"
 #include "SocketStream.h"
@@ -9,6 +10,7 @@
 #include <exception>
 #include <future>
 #include <memory>
+#include <optional>
 #include <queue>
 #include <thread>
 
@@ -19,7 +21,13 @@ namespace Chili {
  */
 class Acceptor {
 public:
-    Acceptor(int listeners);
+    /**
+     * With the IoUring backend, each listener accepts connections
+     * through a multishot accept request, which stays armed across
+     * connections, so that a burst of them is picked up with a single
+     * system call. Falls back to accept() if the kernel doesn't support it.
+     */
+    Acceptor(int listeners, Poller::Backend = Poller::Backend::Epoll);
     virtual ~Acceptor();
 
     /**
@@ -36,20 +44,28 @@ public:
     void Stop();
 
 protected:
-    virtual void RelinquishSocket(int fd, IPEndpoint remote) = 0;
+    /**
+     * Hands over an accepted socket. The remote endpoint
+     * is missing if the socket was accepted without it.
+     */
+    virtual void RelinquishSocket(int fd, std::optional<IPEndpoint> remote) = 0;
     virtual void ResetListenerSocket(SocketStream&) = 0;
     virtual void* AddressBuffer() = 0;
     virtual std::size_t* AddressBufferSize() = 0;
 
 private:
     void AcceptLoop(int listener);
+    bool RingAcceptLoop(int listener);
+    void SubmitAccept(IoUring&, int listener);
+    void Queue(int fd, std::optional<IPEndpoint> remote);
     void DispatchLoop();
 
     int _listeners;
+    Poller::Backend _backend;
     std::vector<SocketStream> _listenerSockets;
     std::promise<void> _promise;
     std::exception_ptr _promiseException;
-    std::queue<std::pair<int, IPEndpoint>> _acceptedFds;
+    std::queue<std::pair<int, std::optional<IPEndpoint>>> _acceptedFds;
     std::unique_ptr<Semaphore> _semaphore;
     std::mutex _mutex;
     std::mutex _startStopMutex;
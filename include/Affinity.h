@@ -0,0 +1,19 @@
+#pragma once
+
+#include <thread>
+#include <vector>
+
+namespace Chili {
+
+/**
+ * Gets the CPUs this process may run on.
+ */
+std::vector<int> GetAvailableCpus();
+
+/**
+ * Pins a thread so that it only runs on the specified CPU.
+ * Does nothing if the CPU number is negative.
+ */
+void SetThreadAffinity(std::thread&, int cpu);
+
+} // namespace Chili
@@ -1,14 +1,18 @@
 #pragma once
 
 #include "Clock.h"
+#include "MonotonicArena.h"
 #include "Poller.h"
 #include "Profiler.h"
 #include "Request.h"
 #include "Response.h"
+#include "ResponseCache.h"
 #include "Signal.h"
-#include "Synchronized.h"
+#include "Slab.h"
 #include "Throttler.h"
 
+#include <atomic>
+#include <deque>
 #include <functional>
 #include <memory>
 #include <mutex>
@@ -77,12 +81,47 @@ public:
      */
     Response& GetResponse();
 
+    /**
+     * Gets the arena holding memory for the request
+     * being processed. Whatever is allocated in it is
+     * released as soon as the response has been sent.
+     */
+    MonotonicArena& GetArena();
+
     /**
      * Instructs the server to fetch the rest of the content
      * (message body) of the request being processed.
      */
     void FetchContent(std::function<void()> callback);
 
+    /**
+     * Instructs the server to fetch the rest of the content
+     * (message body) of the request being processed, handing
+     * it over slice by slice, as it arrives, rather than keeping
+     * it all in the request. Each slice is only valid during
+     * the call to onData.
+     *
+     * Once all of it has been handed over,
+     * the callback is called, as with FetchContent().
+     */
+    void StreamContent(std::function<void(std::string_view)> onData, std::function<void()> callback);
+
+    /**
+     * Instructs the server to fetch the rest of the content
+     * (message body) of the request being processed straight
+     * into the specified file. The content is spliced there
+     * from the socket through a pipe, so it is never copied
+     * into memory, and it is read subject to throttling.
+     *
+     * If set, onProgress is called with the length of the
+     * content written so far, whenever more of it is.
+     * Once all of it has been written, the callback
+     * is called, as with FetchContent().
+     */
+    void SpliceContent(std::shared_ptr<FileStream> file,
+                       std::function<void()> callback,
+                       std::function<void(std::size_t)> onProgress = {});
+
     /**
      * Instructs the server to reject the rest of the content
      * (message body) of the request being processed.
@@ -166,6 +205,8 @@ private:
 
     /**
      * Gets and sets the stage the channel is currently in.
+     * Setting the stage lets the orchestrator know that
+     * the channel might be able to advance.
      */
     Stage GetTentativeStage() const;
     Stage GetDefiniteStage() const;
@@ -204,24 +245,43 @@ private:
 
     bool FetchData(bool(Request::*)(std::size_t, std::size_t&), std::size_t maxRead);
     void ResetResponse();
+    bool IsCacheable() const;
+    bool UseCachedResponse();
+    void CacheResponse();
+    void AnswerConditionalRequest();
     void LogNewRequest();
     void SendInternalError();
     bool FlushData(std::size_t maxWrite);
+    bool CanQueueResponse() const;
+    void QueueResponse();
+    bool FlushQueuedResponses(std::size_t maxWrite);
+
+    // The maximum number of responses to pipelined
+    // requests which may wait to be sent together.
+    static constexpr std::size_t MaxQueuedResponses = 0x10;
 
     std::weak_ptr<class Orchestrator> _orchestrator;
     std::uint64_t _id;
     std::shared_ptr<FileStream> _stream;
+    std::shared_ptr<SlabCache> _slab;
+    MonotonicArena _arena;
     Throttlers _throttlers;
     Request _request;
     Response _response;
-    Synchronized<Clock::TimePoint> _timeout;
+    std::deque<Response> _queuedResponses;
+    std::atomic<Clock::TimePoint> _timeout;
     std::atomic<Stage> _stage;
     std::mutex _setStageMutex;
     bool _forceClose = false;
     bool _fetchingContent = false;
     bool _autoFetchContent = true;
+    std::size_t _chunkSize = 0x1000;
+    std::size_t _maxChunkSize = 0;
+    std::shared_ptr<ResponseCache> _responseCache;
     Signal<> _readyToWrite;
+    Signal<> _readyToAdvance;
     std::function<void()> _fetchContentCallback;
+    std::function<void(std::size_t)> _contentProgressCallback;
 
     friend class Orchestrator;
 };
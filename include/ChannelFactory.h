@@ -31,6 +31,15 @@ public:
      *                     all open channels.
      */
     virtual std::shared_ptr<Channel> CreateChannel(std::shared_ptr<FileStream> fs) = 0;
+
+    /**
+     * Creates a new channel, whose memory may be allocated
+     * with the specified allocator, so that channels are
+     * recycled rather than allocated from the heap.
+     *
+     * By default, this simply calls CreateChannel(fs).
+     */
+    virtual std::shared_ptr<Channel> CreateChannel(std::shared_ptr<FileStream> fs, const SlabAllocator<Channel>&);
 };
 
 } // namespace Chili
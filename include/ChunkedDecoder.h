@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace Chili {
+
+/**
+ * Decodes a message body sent with the chunked transfer coding.
+ *
+ * The decoder never copies any data; it only keeps track of
+ * where it is in the chunk framing, and points out the chunk
+ * data within its input. Chunk extensions and trailer fields
+ * are skipped.
+ */
+class ChunkedDecoder {
+public:
+    /**
+     * Decodes input up to and including the next run of chunk data,
+     * which is set as a view into the input (or left empty if there
+     * was none). Returns the number of input bytes consumed.
+     *
+     * Once the body has ended, no more input is consumed, and so
+     * whatever wasn't consumed belongs to the next message.
+     *
+     * Throws std::runtime_error if the body is malformed.
+     */
+    std::size_t Decode(const char* data, std::size_t size, std::string_view& chunkData);
+
+    /**
+     * Gets the number of data bytes left in the current chunk,
+     * or 0 if the decoder isn't in the middle of chunk data.
+     * These can be consumed elsewhere, and then skipped.
+     */
+    std::uint64_t GetDataRemaining() const;
+
+    /**
+     * Skips data bytes of the current chunk
+     * that were consumed without decoding.
+     */
+    void SkipData(std::uint64_t size);
+
+    /**
+     * Returns true if the last chunk and trailer were decoded.
+     */
+    bool IsDone() const;
+
+    /**
+     * Prepares for decoding a new body.
+     */
+    void Reset();
+
+private:
+    enum class State {
+        Size,
+        Extension,
+        SizeLf,
+        Data,
+        DataCr,
+        DataLf,
+        Trailer,
+        TrailerLine,
+        TrailerLf,
+        FinalLf,
+        Done
+    };
+
+    State _state = State::Size;
+    std::uint64_t _chunkSize = 0;
+    std::size_t _sizeDigits = 0;
+    std::size_t _lineLength = 0;
+    std::size_t _trailerLength = 0;
+};
+
+} // namespace Chili
+
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "Protocol.h"
+
+#include <memory>
+#include <string_view>
+#include <vector>
+
+struct z_stream_s;
+
+namespace Chili {
+
+/**
+ * Compresses content with zlib, either all at once,
+ * or a piece at a time, as with the chunks of a
+ * streamed response.
+ */
+class Compressor {
+public:
+    /**
+     * Creates a compressor producing the specified
+     * content coding, which must not be None.
+     */
+    explicit Compressor(Compression);
+    ~Compressor();
+
+    Compressor(const Compressor&) = delete;
+    Compressor& operator=(const Compressor&) = delete;
+
+    /**
+     * Compresses the input, appending the result to the output.
+     * Unless finishing, the output is flushed, so that everything
+     * compressed so far can be decoded by the client right away.
+     * Once finished, the compressor must not be used again.
+     */
+    void Compress(std::string_view input, std::vector<char>& output, bool finish);
+
+    /**
+     * Picks the content coding the client prefers, of those
+     * supported, given its Accept-Encoding header. Returns
+     * None if it accepts none of them.
+     */
+    static Compression Negotiate(std::string_view acceptEncoding);
+
+    /**
+     * Gets the name of the content coding,
+     * as in the Content-Encoding header.
+     */
+    static std::string_view GetName(Compression);
+
+private:
+    std::unique_ptr<z_stream_s> _stream;
+};
+
+} // namespace Chili
@@ -0,0 +1,470 @@
+#pragma once
+
+#include "MemoryPool.h"
+#include "SystemError.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <vector>
+
+namespace Chili {
+
+namespace Detail {
+
+/**
+ * The free slots a thread keeps
+ * for itself from a single pool.
+ */
+struct ThreadCache {
+    std::weak_ptr<void> Pool;
+    std::uint64_t Generation = 0;
+    void* Head = nullptr;
+    std::size_t Count = 0;
+    void (*Flush)(void* pool, void* head) = nullptr;
+};
+
+/**
+ * Gets the calling thread's caches, indexed by pool ID.
+ * Whatever they hold is given back to their (living)
+ * pools when the thread exits.
+ */
+inline std::vector<ThreadCache>& GetThreadCaches() {
+    struct Caches {
+        ~Caches() {
+            for (auto& c : Entries)
+                if (c.Head)
+                    if (auto pool = c.Pool.lock())
+                        c.Flush(pool.get(), c.Head);
+        }
+
+        std::vector<ThreadCache> Entries;
+    };
+
+    static thread_local Caches caches;
+    return caches.Entries;
+}
+
+/**
+ * The IDs of destroyed pools, to be given to new ones,
+ * so that thread caches only ever grow with the number
+ * of pools alive at the same time.
+ */
+struct PoolIds {
+    std::mutex Mutex;
+    std::vector<std::size_t> Free;
+    std::size_t Next = 0;
+};
+
+inline PoolIds& GetPoolIds() {
+    static PoolIds ids;
+    return ids;
+}
+
+inline std::size_t AcquirePoolId() {
+    auto& ids = GetPoolIds();
+    std::lock_guard lock{ids.Mutex};
+
+    if (ids.Free.empty())
+        return ids.Next++;
+
+    auto id = ids.Free.back();
+    ids.Free.pop_back();
+    return id;
+}
+
+inline void ReleasePoolId(std::size_t id) {
+    auto& ids = GetPoolIds();
+    std::lock_guard lock{ids.Mutex};
+    ids.Free.push_back(id);
+}
+
+/**
+ * Tells apart pools that were given the same ID,
+ * so that caches left over by a destroyed pool
+ * are never mistaken for those of its successor.
+ */
+inline std::atomic_uint64_t nextPoolGeneration{1};
+
+} // namespace Detail
+
+/**
+ * A memory pool meant for use on hot paths.
+ *
+ * Unlike MemoryPool, it never runs out of memory: whenever
+ * its free list is empty, it maps another arena and chains
+ * it to the previous ones. The free list is a lock-free
+ * stack, and each thread also keeps a small cache of free
+ * slots of its own, so that most allocations don't even
+ * contend on that. A mutex is only taken when growing.
+ *
+ * Arenas whose slots are all free may be released back to
+ * the OS by calling ReleaseIdleArenas(). They stay mapped,
+ * though, so that they may later be reused for growth.
+ */
+template <class T>
+class ConcurrentMemoryPool : public std::enable_shared_from_this<ConcurrentMemoryPool<T>> {
+public: // public types
+    struct Deleter {
+        Deleter() = default;
+
+        Deleter(std::shared_ptr<ConcurrentMemoryPool<T>> mp) :
+            _mp{std::move(mp)} {}
+
+        void operator()(T* t) {
+            _mp->Delete(t);
+        }
+
+    private:
+        std::shared_ptr<ConcurrentMemoryPool<T>> _mp;
+    };
+
+    using Ptr = std::unique_ptr<T, Deleter>;
+
+private: // private types
+    union alignas(T) alignas(void*) Slot {
+        char _data[sizeof(T)];
+        Slot* _next;
+    };
+
+    struct Arena {
+        Slot* Begin;
+        std::size_t Slots;
+        bool Released;
+    };
+
+    // The free list's head is tagged with a counter in its
+    // upper bits, which changes on every modification, so
+    // that a stale head is never mistaken for the current.
+    static constexpr int TagShift = 48;
+    static constexpr std::uint64_t PointerMask = (std::uint64_t(1) << TagShift) - 1;
+
+public: // public functions
+    /**
+     * @param pagesPerArena The number of pages each arena spans.
+     * @param cacheSize     The number of free slots each thread
+     *                      may keep to itself.
+     */
+    static std::shared_ptr<ConcurrentMemoryPool> Create(std::size_t pagesPerArena = Detail::MinPagesFor(sizeof(Slot)),
+                                                        std::size_t cacheSize = 0x20) {
+        return std::shared_ptr<ConcurrentMemoryPool>{new ConcurrentMemoryPool{pagesPerArena, cacheSize}};
+    }
+
+    ConcurrentMemoryPool(const ConcurrentMemoryPool&) = delete;
+    ConcurrentMemoryPool& operator=(const ConcurrentMemoryPool&) = delete;
+
+    ~ConcurrentMemoryPool() {
+        for (auto& a : _arenas)
+            ::munmap(a.Begin, GetArenaSize());
+
+        // Whatever other threads still cache of ours is
+        // discarded when the ID's next owner finds it.
+        Detail::ReleasePoolId(_id);
+    }
+
+    template <class... Args>
+    Ptr New(Args&&... args) {
+        auto t = static_cast<T*>(Allocate());
+
+        try {
+            new(t) T{std::forward<Args>(args)...};
+        } catch(...) {
+            Deallocate(t);
+            throw;
+        }
+
+        return {t, this->shared_from_this()};
+    }
+
+    void* Allocate() {
+        auto& cache = GetThreadCache();
+        Slot* slot;
+
+        if (cache.Head) {
+            slot = static_cast<Slot*>(cache.Head);
+            cache.Head = slot->_next;
+            --cache.Count;
+        } else {
+            while (!(slot = Pop()))
+                Grow();
+        }
+
+        _slotsInUse.fetch_add(1, std::memory_order_relaxed);
+
+        return slot;
+    }
+
+    void Deallocate(void* mem) {
+        auto slot = static_cast<Slot*>(mem);
+
+        if (!slot)
+            return;
+
+        _slotsInUse.fetch_sub(1, std::memory_order_relaxed);
+
+        auto& cache = GetThreadCache();
+
+        slot->_next = static_cast<Slot*>(cache.Head);
+        cache.Head = slot;
+
+        if (++cache.Count <= _cacheSize)
+            return;
+
+        // Give half of the cache back, in one go
+        auto last = slot;
+
+        for (std::size_t i = 1; i < _cacheSize / 2; ++i)
+            last = last->_next;
+
+        cache.Head = last->_next;
+        cache.Count -= _cacheSize / 2;
+
+        Push(slot, last);
+    }
+
+    /**
+     * Releases the physical memory of arenas none of whose
+     * slots are in use, nor kept in any thread's cache.
+     * Returns the number of arenas released.
+     */
+    std::size_t ReleaseIdleArenas() {
+        std::lock_guard lock{_arenasMutex};
+
+        // Take over the whole free list, so that
+        // no one allocates from it in the meantime.
+        auto head = _head.load(std::memory_order_acquire);
+
+        while (!_head.compare_exchange_weak(head, MakeTagged(nullptr, head),
+                                            std::memory_order_acq_rel,
+                                            std::memory_order_acquire));
+
+        auto arenas = std::vector<Arena*>();
+
+        for (auto& a : _arenas)
+            if (!a.Released)
+                arenas.push_back(&a);
+
+        std::sort(begin(arenas), end(arenas), [](auto a, auto b) { return a->Begin < b->Begin; });
+
+        auto freeSlots = std::vector<std::size_t>(arenas.size());
+
+        for (auto s = GetPointer(head); s; s = s->_next)
+            ++freeSlots[FindArena(arenas, s)];
+
+        std::size_t released = 0;
+
+        for (std::size_t i = 0; i < arenas.size(); ++i) {
+            if (freeSlots[i] != arenas[i]->Slots)
+                continue;
+
+            ::madvise(arenas[i]->Begin, GetArenaSize(), MADV_DONTNEED);
+            arenas[i]->Released = true;
+            _capacity -= arenas[i]->Slots;
+            ++released;
+        }
+
+        // Put back whatever is left
+        Slot* first = nullptr;
+        Slot* last = nullptr;
+
+        for (auto s = GetPointer(head); s;) {
+            auto next = s->_next;
+
+            if (!arenas[FindArena(arenas, s)]->Released) {
+                if (last)
+                    last->_next = s;
+                else
+                    first = s;
+
+                last = s;
+            }
+
+            s = next;
+        }
+
+        if (first)
+            Push(first, last);
+
+        return released;
+    }
+
+    std::size_t GetCapacity() const noexcept {
+        return _capacity;
+    }
+
+    std::size_t GetFreeSlots() const noexcept {
+        return _capacity - _slotsInUse;
+    }
+
+    std::size_t GetArenaCount() const {
+        std::lock_guard lock{_arenasMutex};
+
+        return std::count_if(begin(_arenas), end(_arenas), [](auto& a) {
+            return !a.Released;
+        });
+    }
+
+private:
+    ConcurrentMemoryPool(std::size_t pagesPerArena, std::size_t cacheSize) :
+        _pagesPerArena(pagesPerArena),
+        _cacheSize(std::max<std::size_t>(cacheSize, 2)),
+        _id(Detail::AcquirePoolId()),
+        _generation(Detail::nextPoolGeneration++) {
+        if (GetArenaSize() < sizeof(Slot)) {
+            Detail::ReleasePoolId(_id);
+            throw std::logic_error("Memory pool arena size is too small");
+        }
+    }
+
+    void Delete(T* t) {
+        t->~T();
+        Deallocate(t);
+    }
+
+    std::size_t GetArenaSize() const noexcept {
+        return _pagesPerArena * ::getpagesize();
+    }
+
+    static Slot* GetPointer(std::uint64_t tagged) noexcept {
+        return reinterpret_cast<Slot*>(tagged & PointerMask);
+    }
+
+    static std::uint64_t MakeTagged(Slot* s, std::uint64_t previous) noexcept {
+        auto tag = (previous >> TagShift) + 1;
+        return reinterpret_cast<std::uintptr_t>(s) | (tag << TagShift);
+    }
+
+    Slot* Pop() {
+        auto head = _head.load(std::memory_order_acquire);
+
+        for (;;) {
+            auto slot = GetPointer(head);
+
+            if (!slot)
+                return nullptr;
+
+            // The slot may be popped and reused by another thread
+            // before we get to it, in which case this reads garbage,
+            // but then the head will have changed and the CAS fails.
+            // Arenas are never unmapped, so reading is always safe.
+            auto next = slot->_next;
+
+            if (_head.compare_exchange_weak(head, MakeTagged(next, head),
+                                            std::memory_order_acq_rel,
+                                            std::memory_order_acquire))
+                return slot;
+        }
+    }
+
+    void Push(Slot* first, Slot* last) {
+        auto head = _head.load(std::memory_order_relaxed);
+
+        do {
+            last->_next = GetPointer(head);
+        } while (!_head.compare_exchange_weak(head, MakeTagged(first, head),
+                                              std::memory_order_release,
+                                              std::memory_order_relaxed));
+    }
+
+    void Grow() {
+        std::lock_guard lock{_arenasMutex};
+
+        // Someone might have just grown the
+        // pool, or freed some slots already.
+        if (GetPointer(_head.load(std::memory_order_acquire)))
+            return;
+
+        auto slots = GetArenaSize() / sizeof(Slot);
+        auto arena = std::find_if(begin(_arenas), end(_arenas), [](auto& a) {
+            return a.Released;
+        });
+
+        if (arena == end(_arenas)) {
+            auto mem = ::mmap(nullptr,
+                    GetArenaSize(),
+                    PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS,
+                    -1, 0);
+
+            if (mem == MAP_FAILED)
+                throw SystemError();
+
+            if (reinterpret_cast<std::uintptr_t>(mem) & ~PointerMask) {
+                ::munmap(mem, GetArenaSize());
+                throw std::logic_error("mmap() returned memory that cannot be tagged");
+            }
+
+            _arenas.push_back({static_cast<Slot*>(mem), slots, false});
+            arena = end(_arenas) - 1;
+        }
+
+        arena->Released = false;
+
+        auto first = arena->Begin;
+        auto last = first + slots - 1;
+
+        for (auto s = first; s != last; ++s)
+            s->_next = s + 1;
+
+        _capacity += slots;
+
+        Push(first, last);
+    }
+
+    static std::size_t FindArena(const std::vector<Arena*>& sorted, const Slot* s) {
+        auto it = std::upper_bound(begin(sorted), end(sorted), s, [](auto s, auto a) {
+            return s < a->Begin;
+        });
+
+        return it - begin(sorted) - 1;
+    }
+
+    Detail::ThreadCache& GetThreadCache() {
+        auto& caches = Detail::GetThreadCaches();
+
+        if (caches.size() <= _id)
+            caches.resize(_id + 1);
+
+        auto& cache = caches[_id];
+
+        if (cache.Generation != _generation) {
+            // Anything left here belonged to a pool that was
+            // destroyed, along with the arenas its slots were in.
+            cache.Head = nullptr;
+            cache.Count = 0;
+            cache.Generation = _generation;
+            cache.Pool = this->weak_from_this();
+            cache.Flush = [](void* pool, void* head) {
+                auto mp = static_cast<ConcurrentMemoryPool*>(pool);
+                auto first = static_cast<Slot*>(head);
+                auto last = first;
+
+                while (last->_next)
+                    last = last->_next;
+
+                mp->Push(first, last);
+            };
+        }
+
+        return cache;
+    }
+
+    std::size_t _pagesPerArena;
+    std::size_t _cacheSize;
+    std::size_t _id;
+    std::uint64_t _generation;
+    std::atomic<std::uint64_t> _head{0};
+    std::atomic_size_t _capacity{0};
+    std::atomic_size_t _slotsInUse{0};
+    std::vector<Arena> _arenas;
+    mutable std::mutex _arenasMutex;
+};
+
+} // namespace Chili
+
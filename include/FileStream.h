@@ -5,6 +5,8 @@
 
 #include <atomic>
 #include <chrono>
+#include <cstdint>
+#include <ctime>
 #include <memory>
 #include <string>
 #include <vector>
@@ -42,10 +44,35 @@ public:
 
     std::size_t Read(void* buffer, std::size_t maxBytes) override;
     std::size_t Read(void* buffer, std::size_t maxBytes, std::chrono::milliseconds timeout) override;
+
+    /**
+     * Reads data starting at the specified offset,
+     * without changing the file position.
+     */
+    std::size_t ReadAt(void* buffer, std::size_t maxBytes, std::uint64_t offset);
     std::size_t Write(const void* buffer, std::size_t maxBytes) override;
     std::size_t WriteVector(std::vector<std::pair<const void*, std::size_t>>) override;
     virtual std::size_t WriteTo(FileStream&, std::size_t maxBytes);
 
+    /**
+     * Writes data starting at the specified offset, which
+     * is then advanced, without changing the file position.
+     * Returns 0 if the other stream can't take any more
+     * data for now. Throws if the file has nothing left
+     * to send from the offset on.
+     */
+    std::size_t WriteTo(FileStream&, std::size_t maxBytes, std::uint64_t& offset);
+
+    /**
+     * Gets the size of the file.
+     */
+    std::uint64_t GetSize() const;
+
+    /**
+     * Gets the time the file was last modified.
+     */
+    std::time_t GetModificationTime() const;
+
     bool EndOfStream() const override;
 
 protected:
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "HeaderParser.h"
+#include "Protocol.h"
+
+#include <array>
+#include <cstdint>
+#include <string_view>
+
+namespace Chili {
+
+/**
+ * An index of a request's header fields by name.
+ *
+ * Known headers are identified by a perfect hash of their
+ * names, computed at compile time, and are then found by
+ * a single array access. Other headers are kept in a small
+ * case-insensitive hash table.
+ */
+class HeaderIndex {
+public:
+    static constexpr std::size_t npos = -1;
+
+    /**
+     * Gets the known header with the specified name,
+     * regardless of case, or Header::Unknown.
+     */
+    static Header GetKnownHeader(std::string_view name);
+
+    /**
+     * Gets the name of a known header.
+     */
+    static std::string_view GetName(Header);
+
+    /**
+     * Removes all indexed fields.
+     */
+    void Clear();
+
+    /**
+     * Indexes a field, given its position in the field list.
+     * Fields must be added in order, as only the first field
+     * of each name is ever found.
+     */
+    void Add(std::string_view name, std::size_t position);
+
+    /**
+     * Gets the position of the first field of the
+     * specified known header, or npos if there's none.
+     */
+    std::size_t Find(Header) const;
+
+    /**
+     * Gets the position of the first field with the
+     * specified name, or npos if there's none.
+     */
+    std::size_t Find(std::string_view name, const HeaderParser::FieldList&) const;
+
+private:
+    static constexpr std::size_t KnownHeaders = static_cast<std::size_t>(Header::Unknown);
+    static constexpr std::size_t UnknownSlots = 0x20;
+    static constexpr std::size_t MaxUnknownHeaders = UnknownSlots * 3 / 4;
+
+    // Positions are kept off by one, so that 0 means none
+    std::array<std::uint16_t, KnownHeaders> _known{};
+    std::array<std::uint16_t, UnknownSlots> _unknown{};
+    std::size_t _unknownCount = 0;
+    bool _overflow = false;
+};
+
+} // namespace Chili
+
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "Slab.h"
+
+#include <cstdint>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace Chili {
+
+/**
+ * A parser for complete HTTP/1.x request headers.
+ *
+ * Rather than running a byte-at-a-time state machine,
+ * it first waits for the entire header to arrive, and
+ * then scans it for delimiters using SIMD instructions,
+ * as supported by the CPU.
+ *
+ * All parsed strings refer to the parsed data.
+ */
+class HeaderParser {
+public:
+    enum class InstructionSet {
+        Generic,
+        Sse42,
+        Avx2
+    };
+
+    using Field = std::pair<std::string_view, std::string_view>;
+    using FieldList = std::vector<Field, SlabAllocator<Field>>;
+
+    /**
+     * The request line, and whatever the headers
+     * say about the framing of the message.
+     */
+    struct Result {
+        std::string_view Method;
+        std::string_view Uri;
+        int VersionMajor = 0;
+        int VersionMinor = 0;
+        std::uint64_t ContentLength = 0;
+        bool Chunked = false;
+        bool KeepAlive = false;
+    };
+
+    /**
+     * Gets the best instruction set supported by the CPU.
+     */
+    static InstructionSet GetSupportedInstructionSet();
+
+    /**
+     * Creates a parser using the specified instruction set,
+     * which must be supported by the CPU.
+     */
+    explicit HeaderParser(InstructionSet = GetSupportedInstructionSet());
+
+    InstructionSet GetInstructionSet() const;
+
+    /**
+     * Looks for the empty line ending a request header.
+     * Returns a pointer right past it, or null if it's not there.
+     */
+    const char* FindEnd(const char* begin, const char* end) const;
+
+    /**
+     * Parses a complete request header, including the empty
+     * line ending it, and appends its fields to the list.
+     * Throws std::runtime_error if the header is malformed.
+     */
+    Result Parse(std::string_view header, FieldList& fields) const;
+
+private:
+    struct Scanner;
+
+    static const Scanner* GetScanner(InstructionSet);
+
+    InstructionSet _instructionSet;
+    const Scanner* _scanner;
+};
+
+} // namespace Chili
+
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <ctime>
+#include <string_view>
+
+namespace Chili {
+
+/**
+ * The current date, as sent in the Date header.
+ *
+ * The date is kept formatted in a global buffer, which is
+ * refreshed at most once per second, by whichever thread
+ * first notices that it's out of date. Readers never lock;
+ * they copy the buffer under a sequence lock, retrying
+ * in the rare case that it changed while they did.
+ */
+class HttpDate {
+public:
+    /**
+     * The length of a formatted date,
+     * e.g. "Sun, 06 Nov 1994 08:49:37 GMT".
+     */
+    static constexpr std::size_t Length = 29;
+
+    /**
+     * Copies the current date, formatted as in RFC 7231,
+     * into the buffer, which must have room for Length
+     * characters. Returns the time it was formatted from.
+     */
+    static std::time_t Get(char* buffer);
+
+    /**
+     * Formats the specified time as in RFC 7231 into the
+     * buffer, which must have room for Length characters.
+     */
+    static void Format(std::time_t, char* buffer);
+
+    /**
+     * Parses a date formatted as in RFC 7231, as sent in the
+     * If-Modified-Since header. Returns false if it's invalid.
+     * The obsolete RFC 850 and asctime() formats aren't supported.
+     */
+    static bool Parse(std::string_view, std::time_t&);
+};
+
+} // namespace Chili
@@ -3,6 +3,9 @@
 #include "Orchestrator.h"
 #include "TcpAcceptor.h"
 
+#include <atomic>
+#include <vector>
+
 namespace Chili {
 
 /**
@@ -10,6 +13,15 @@ namespace Chili {
  */
 class HttpServer {
 public:
+    /**
+     * Determines how new connections are
+     * spread across the server's shards.
+     */
+    enum class ShardingPolicy {
+        RoundRobin,
+        LeastLoaded
+    };
+
     /**
      * Creates a new server listening on \p endpoint.
      *
@@ -20,6 +32,37 @@ public:
      */
     HttpServer(const IPEndpoint& endpoint, std::shared_ptr<ChannelFactory> channelFactory, int listeners = 1);
 
+    /**
+     * Creates a new sharded server listening on \p endpoint.
+     *
+     * Each shard has its own event loop and handles a disjoint set
+     * of connections, so that shards never contend with each other.
+     * When there is more than one shard, each shard's event loop
+     * threads are pinned to a CPU, while its thread pools aren't.
+     *
+     * @param endpoint        The IP endpoint to listen on.
+     *
+     * @param channelFactory  The factory from which to create new
+     *                        channels when connections are received.
+     *
+     * @param listeners       The number of threads accepting connections.
+     *
+     * @param shards          The number of shards, or 0 to have
+     *                        one for every available CPU.
+     *
+     * @param threads         The number of threads each shard may
+     *                        use for handling its channels.
+     *
+     * @param backend         The kernel facility used for polling
+     *                        and for accepting connections.
+     */
+    HttpServer(const IPEndpoint& endpoint,
+               std::shared_ptr<ChannelFactory> channelFactory,
+               int listeners,
+               int shards,
+               int threads = 8,
+               Poller::Backend backend = Poller::Backend::Epoll);
+
     /**
      * Starts the server so that new connections can be accepted.
      *
@@ -52,9 +95,42 @@ public:
      */
     void SetInactivityTimeout(std::chrono::milliseconds);
 
+    /**
+     * Sets the default size of the chunks streamed responses
+     * are sent in, and whether it adapts to the connection.
+     * See Response::SetChunkSize().
+     */
+    void SetChunkSize(std::size_t size, std::size_t maxSize = 0);
+
+    /**
+     * Sets a cache of responses, which requests are looked up
+     * in before they are processed. Responses are only added
+     * to it when they were given a TTL, as in Response::SetCacheTtl().
+     * Should be called before Start().
+     */
+    void SetResponseCache(std::shared_ptr<ResponseCache>);
+
+    /**
+     * Lets channels be advanced by the same thread that was
+     * notified of their readiness, rather than being handed over
+     * to another thread. This works best for handlers that respond
+     * quickly and synchronously. The default is disabled.
+     */
+    void SetInlineActivation(bool);
+
+    /**
+     * Sets how new connections are spread across shards.
+     * The default is ShardingPolicy::RoundRobin.
+     */
+    void SetShardingPolicy(ShardingPolicy);
+
 private:
+    Orchestrator& PickShard();
+
     TcpAcceptor _tcpAcceptor;
-    std::shared_ptr<Orchestrator> _orchestrator;
+    std::vector<std::shared_ptr<Orchestrator>> _shards;
+    std::atomic<ShardingPolicy> _shardingPolicy{ShardingPolicy::RoundRobin};
+    std::atomic_size_t _nextShard{0};
 };
 
 } // namespace Chili
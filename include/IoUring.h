@@ -0,0 +1,115 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct io_uring_sqe;
+
+namespace Chili {
+
+/**
+ * A minimal io_uring instance, talking
+ * directly to the kernel's interface.
+ *
+ * Submission and completion are independent,
+ * but neither is synchronized by itself. It is
+ * up to the owner to serialize submitters, and
+ * to have a single thread reap completions.
+ */
+class IoUring {
+public:
+    struct Completion {
+        std::uint64_t UserData;
+        std::int32_t Result;
+        std::uint32_t Flags;
+    };
+
+    /**
+     * Checks whether the running kernel supports
+     * all the io_uring features this class relies on,
+     * as well as multishot polls, by trying one out.
+     */
+    static bool IsSupported();
+
+    IoUring(unsigned entries);
+    IoUring(const IoUring&) = delete;
+    IoUring& operator=(const IoUring&) = delete;
+    ~IoUring();
+
+    /**
+     * Gets a cleared submission queue entry to fill in,
+     * submitting pending ones first if the queue is full.
+     */
+    ::io_uring_sqe& GetSqe();
+
+    /**
+     * Submits all pending entries in a single system call.
+     */
+    void Submit();
+
+    /**
+     * Waits until at least one completion is available,
+     * or until the timeout expires. Returns false on timeout.
+     */
+    bool Wait(std::chrono::milliseconds timeout);
+
+    /**
+     * Moves all available completions into the
+     * specified vector, and returns their count.
+     */
+    std::size_t Reap(std::vector<Completion>&);
+
+    /**
+     * Registers a ring of equally sized buffers with the kernel,
+     * as the specified buffer group. Requests selecting a buffer
+     * from the group take one as they complete, and report its ID
+     * in their completion flags. The count must be a power of 2.
+     * Returns false if the kernel doesn't support buffer rings.
+     */
+    bool RegisterBuffers(std::uint16_t group, unsigned count, std::size_t size);
+
+    /**
+     * Gets the data of a buffer taken from the registered group.
+     */
+    const char* GetBuffer(unsigned id) const;
+
+    /**
+     * Hands a buffer taken from the registered group back
+     * to the kernel. Must be called by the reaping thread.
+     */
+    void RecycleBuffer(unsigned id);
+
+private:
+    int Enter(unsigned toSubmit, unsigned minComplete, unsigned flags, void* arg, std::size_t argSize);
+
+    int _fd = -1;
+    void* _sqRing = nullptr;
+    void* _cqRing = nullptr;
+    std::size_t _sqRingSize = 0;
+    std::size_t _cqRingSize = 0;
+    ::io_uring_sqe* _sqes = nullptr;
+    std::size_t _sqesSize = 0;
+
+    unsigned* _sqHead;
+    unsigned* _sqTail;
+    unsigned* _sqMask;
+    unsigned* _sqArray;
+    unsigned _sqEntries;
+    unsigned _sqPending = 0;
+
+    unsigned* _cqHead;
+    unsigned* _cqTail;
+    unsigned* _cqMask;
+    void* _cqes;
+
+    void* _bufferRing = nullptr;
+    std::size_t _bufferRingSize = 0;
+    std::vector<char> _buffers;
+    std::size_t _bufferSize = 0;
+    unsigned _bufferCount = 0;
+    std::uint16_t _bufferTail = 0;
+};
+
+} // namespace Chili
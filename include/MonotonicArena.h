@@ -0,0 +1,126 @@
+#pragma once
+
+#include "Slab.h"
+
+#include <cstddef>
+#include <new>
+#include <string_view>
+#include <type_traits>
+
+namespace Chili {
+
+/**
+ * A bump allocator for short-lived data.
+ *
+ * Memory is handed out sequentially from blocks, and
+ * is only reclaimed all at once, by calling Reset().
+ * The first block is kept across resets, so that as
+ * long as whatever is allocated in between fits in it,
+ * a reset arena allocates no memory at all.
+ *
+ * The arena is not synchronized.
+ */
+class MonotonicArena {
+public:
+    /**
+     * @param allocator The allocator from which to allocate blocks.
+     * @param blockSize The default size of each block.
+     */
+    explicit MonotonicArena(SlabAllocator<char> = {}, std::size_t blockSize = 0x1000);
+    MonotonicArena(MonotonicArena&&) noexcept;
+    MonotonicArena& operator=(MonotonicArena&&) noexcept;
+    ~MonotonicArena();
+
+    void* Allocate(std::size_t size, std::size_t alignment = alignof(std::max_align_t));
+
+    /**
+     * Copies the string into the arena.
+     */
+    std::string_view Store(std::string_view);
+
+    /**
+     * Releases everything allocated so far.
+     */
+    void Reset();
+
+    /**
+     * Gets the number of bytes allocated since the last reset.
+     */
+    std::size_t GetBytesUsed() const;
+
+private:
+    struct Block {
+        Block* Next;
+        std::size_t Size;
+    };
+
+    void AddBlock(std::size_t minSize);
+    void FreeBlocks(Block* first);
+    char* GetBlockData(Block*) const;
+
+    SlabAllocator<char> _allocator;
+    std::size_t _blockSize;
+    Block* _blocks = nullptr;
+    char* _cursor = nullptr;
+    char* _end = nullptr;
+    std::size_t _bytesUsed = 0;
+};
+
+/**
+ * A standard allocator allocating from an arena.
+ * Deallocation does nothing, as the memory is only
+ * reclaimed when the arena is reset. Without an
+ * arena, it simply allocates from the heap.
+ */
+template <class T>
+class ArenaAllocator {
+public:
+    using value_type = T;
+    using propagate_on_container_copy_assignment = std::true_type;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+
+    ArenaAllocator() = default;
+
+    ArenaAllocator(MonotonicArena* arena) :
+        _arena{arena} {}
+
+    template <class U>
+    ArenaAllocator(const ArenaAllocator<U>& other) :
+        _arena{other._arena} {}
+
+    T* allocate(std::size_t n) {
+        if (_arena)
+            return static_cast<T*>(_arena->Allocate(n * sizeof(T), alignof(T)));
+        else
+            return static_cast<T*>(::operator new(n * sizeof(T)));
+    }
+
+    void deallocate(T* t, std::size_t) noexcept {
+        if (!_arena)
+            ::operator delete(t);
+    }
+
+    MonotonicArena* GetArena() const {
+        return _arena;
+    }
+
+    template <class U>
+    bool operator==(const ArenaAllocator<U>& other) const {
+        return _arena == other._arena;
+    }
+
+    template <class U>
+    bool operator!=(const ArenaAllocator<U>& other) const {
+        return _arena != other._arena;
+    }
+
+private:
+    MonotonicArena* _arena = nullptr;
+
+    template <class U>
+    friend class ArenaAllocator;
+};
+
+} // namespace Chili
+
@@ -6,26 +6,29 @@
 #include "FileStream.h"
 #include "Poller.h"
 #include "Profiler.h"
+#include "ResponseCache.h"
 #include "Signal.h"
-#include "Synchronized.h"
+#include "Slab.h"
 #include "ThreadPool.h"
 #include "Throttler.h"
+#include "TimerWheel.h"
 #include "WaitEvent.h"
 
 #include <atomic>
 #include <chrono>
 #include <future>
-#include <map>
 #include <memory>
 #include <mutex>
 #include <thread>
 #include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 namespace Chili {
 
 class Orchestrator : public std::enable_shared_from_this<Orchestrator> {
 public:
-    static std::shared_ptr<Orchestrator> Create(std::shared_ptr<ChannelFactory>, int threads);
+    static std::shared_ptr<Orchestrator> Create(std::shared_ptr<ChannelFactory>, int threads, Poller::Backend = Poller::Backend::Epoll);
 
     ~Orchestrator();
 
@@ -37,47 +40,113 @@ public:
     void ThrottleWrite(Throttler);
     void SetInactivityTimeout(std::chrono::milliseconds);
 
+    /**
+     * Sets the default size of the chunks streamed
+     * responses are sent in, as in Response::SetChunkSize().
+     */
+    void SetChunkSize(std::size_t size, std::size_t maxSize = 0);
+
+    /**
+     * Sets the cache responses are looked up in before
+     * requests are processed. Should be called before Start().
+     */
+    void SetResponseCache(std::shared_ptr<ResponseCache>);
+
+    /**
+     * When enabled, channels that become ready due to poller events
+     * are advanced right away by the thread receiving the event,
+     * rather than being handed over to an activation thread. This
+     * saves a few thread switches per request, and works best when
+     * channels process their requests quickly and synchronously.
+     */
+    void SetInlineActivation(bool);
+
+    /**
+     * Pins the orchestrator's own thread and its poller's
+     * thread to the specified CPU. Its thread pools aren't
+     * pinned, as they'd all crowd onto that single CPU.
+     * Should be called before Start().
+     */
+    void SetAffinity(int cpu);
+
+    /**
+     * Makes this orchestrator share its master throttlers
+     * with another one, so that throttling either of them
+     * limits the channels of both as a whole.
+     * Should be called before any channel is added.
+     */
+    void ShareThrottlers(const Orchestrator&);
+
+    /**
+     * Gets the number of channels currently being handled.
+     */
+    std::size_t GetChannelCount() const;
+
     Signal<> OnStop;
 
 private:
-    class Task {
+    class Task : public std::enable_shared_from_this<Task> {
     public:
-        void MarkHandlingInProcess(bool);
         bool IsHandlingInProcess() const;
+        bool TryMarkHandlingInProcess();
+        bool MarkQueued(bool);
         void Activate();
+        void MarkCompleted();
+        bool IsCompleted() const;
+        void MarkCollected();
+        bool IsCollected() const;
+        void SetReadiness(int events);
+        void ClearReadiness();
+        bool ResumeIfReady();
         bool ReachedInactivityTimeout() const;
+        Clock::TimePoint GetInactivityDeadline() const;
         Channel& GetChannel();
+        const std::shared_ptr<FileStream>& GetStream() const;
+        TimerWheel::Timer& GetThrottleTimer();
+        TimerWheel::Timer& GetInactivityTimer();
         std::mutex& GetMutex();
 
     private:
         Orchestrator* _orchestrator;
         std::shared_ptr<Channel> _channel;
-        Synchronized<Clock::TimePoint> _lastActive;
+        std::shared_ptr<FileStream> _stream;
+        std::atomic<Clock::TimePoint> _lastActive;
+        TimerWheel::Timer _throttleTimer;
+        TimerWheel::Timer _inactivityTimer;
+        bool _collected = false; // guarded by the timer wheel mutex
         std::mutex _mutex;
         std::atomic_bool _inProcess{false};
+        std::atomic_bool _queued{false};
+        std::atomic_bool _completed{false};
+        std::atomic_bool _readable{false};
+        std::atomic_bool _writable{false};
 
         friend void Orchestrator::Add(std::shared_ptr<FileStream>);
     };
 
-    Orchestrator(std::shared_ptr<ChannelFactory>, int threads);
+    Orchestrator(std::shared_ptr<ChannelFactory>, int threads, Poller::Backend);
 
     template <class T>
     void RecordChannelEvent(const Channel&) const;
 
     void WakeUp();
-    void OnEvent(std::shared_ptr<FileStream>, int events);
-    void HandleChannelEvent(Channel&, int events);
+    void Schedule(std::shared_ptr<Task>);
+    void ScheduleAt(std::shared_ptr<Task>, Clock::TimePoint);
+    void OnEvent(std::shared_ptr<Task>, int events);
+    bool HandleChannelEvent(Task&);
     void IterateOnce();
     std::vector<std::shared_ptr<Task>> CaptureTasks();
-    std::vector<std::shared_ptr<Task>> FilterReadyTasks();
+    std::vector<std::shared_ptr<Task>> FilterReadyTasks(std::vector<std::shared_ptr<Task>>);
     void InternalStop();
     void InternalForceStopOnError();
-    bool AtLeastOneTaskIsReady();
     bool IsTaskReady(Task&);
     Clock::TimePoint GetLatestAllowedWakeup();
-    void CollectGarbage();
+    void ScheduleExpiredTimers();
+    void ReleaseIdleMemory();
+    void CollectGarbage(const std::shared_ptr<Task>&);
 
     std::shared_ptr<ChannelFactory> _channelFactory;
+    std::shared_ptr<SlabCache> _slab;
     std::promise<void> _threadPromise;
     Poller _poller;
     ThreadPool _activationThreadPool;
@@ -87,10 +156,20 @@ private:
     std::thread _thread;
     WaitEvent _newEvent;
     std::atomic_bool _stop{true};
+    std::atomic_int _cpu{-1};
+    std::atomic_bool _inlineActivation{false};
+    std::atomic_size_t _channelCount{0};
     std::mutex _mutex;
-    std::map<void*, std::weak_ptr<Task>> _taskFastLookup;
-    std::vector<std::shared_ptr<Task>> _tasks;
+    std::unordered_set<std::shared_ptr<Task>> _tasks;
+    TimerWheel _timerWheel;
+    std::mutex _timerWheelMutex;
+    Clock::TimePoint _nextMemoryRelease;
+    std::mutex _readyTasksMutex;
+    std::vector<std::shared_ptr<Task>> _readyTasks;
     std::atomic<std::chrono::milliseconds> _inactivityTimeout{std::chrono::milliseconds(10000)};
+    std::atomic_size_t _chunkSize{0x1000};
+    std::atomic_size_t _maxChunkSize{0};
+    std::shared_ptr<ResponseCache> _responseCache;
 
     friend class Channel;
 };
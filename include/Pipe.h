@@ -9,6 +9,29 @@
 
 namespace Chili {
 
+/**
+ * The reading end of a pipe, whose data can
+ * be moved into any file without copying.
+ */
+class PipeStream : public FileStream {
+public:
+    using FileStream::FileStream;
+    using FileStream::WriteTo;
+
+    std::size_t WriteTo(FileStream& fs, std::size_t maxBytes) override {
+        ::ssize_t result = ::splice(_nativeHandle,
+                                    nullptr,
+                                    fs.GetNativeHandle(),
+                                    nullptr,
+                                    maxBytes,
+                                    0);
+        if (result == -1)
+            throw SystemError{};
+
+        return result;
+    }
+};
+
 struct Pipe {
     static auto Create() {
         int fds[2];
@@ -16,12 +39,27 @@ struct Pipe {
         if (::pipe(fds))
             throw SystemError();
 
-        return Pipe{std::make_shared<FileStream>(fds[0]),
-                    std::make_shared<FileStream>(fds[1])};
+        auto pipe = Pipe{std::make_shared<PipeStream>(fds[0]),
+                         std::make_shared<FileStream>(fds[1])};
+
+        auto capacity = ::fcntl(fds[1], F_GETPIPE_SZ);
+
+        if (capacity == -1)
+            throw SystemError();
+
+        pipe.Capacity = capacity;
+
+        return pipe;
     }
 
     std::shared_ptr<FileStream> Read;
     std::shared_ptr<FileStream> Write;
+
+    /**
+     * The number of bytes the pipe can hold,
+     * looked up once when it's created.
+     */
+    std::size_t Capacity = 0;
 };
 
 } // namespace Chili
@@ -1,18 +1,22 @@
 #pragma once
 
 #include "FileStream.h"
+#include "IoUring.h"
 #include "Profiler.h"
 #include "Signal.h"
+#include "SocketStream.h"
 #include "ThreadPool.h"
 
 #include <atomic>
 #include <chrono>
+#include <cstdint>
 #include <functional>
 #include <future>
 #include <memory>
 #include <mutex>
 #include <thread>
 #include <unordered_map>
+#include <vector>
 
 namespace Chili {
 
@@ -28,36 +32,149 @@ public:
         NotifyAll = EndOfStream | Writable | Readable
     };
 
+    /**
+     * Determines how files are watched.
+     *
+     * OneShot:       Each call to Poll() watches the file for a single
+     *                event, after which it has to be polled again.
+     *
+     * EdgeTriggered: The first call to Poll() registers the file until
+     *                it is removed, and every change in its readiness
+     *                is reported, whether it was asked for or not.
+     *                The handler must remember readiness by itself,
+     *                since it's only reported once per change.
+     */
+    enum class Mode {
+        OneShot,
+        EdgeTriggered
+    };
+
+    /**
+     * Determines which kernel facility is used for polling.
+     *
+     * Epoll:   The classic readiness API.
+     *
+     * IoUring: Poll requests are submitted to an io_uring, and
+     *          edge-triggered files use multishot polls, which
+     *          stay armed without being resubmitted. Falls back
+     *          to epoll if the kernel doesn't support it.
+     *          Sockets may also be received from through the
+     *          ring; see SetRingReceive().
+     */
+    enum class Backend {
+        Epoll,
+        IoUring
+    };
+
     using EventHandler = std::function<void(std::shared_ptr<FileStream>, int events)>;
+    using ContextEventHandler = std::function<void(std::shared_ptr<FileStream>, const std::shared_ptr<void>& context, int events)>;
 
-    Poller(int threads);
+    Poller(int threads, Mode = Mode::OneShot, Backend = Backend::Epoll);
     Poller(const Poller&) = delete;
     ~Poller();
 
     std::size_t GetWatchedCount();
-    void Poll(std::shared_ptr<FileStream>, int events = Events::NotifyAll);
+    Backend GetBackend() const;
+
+    /**
+     * Watches the file for the specified events.
+     *
+     * The optional context is kept alongside the file
+     * for as long as it is watched, and is handed to
+     * context event handlers along with every event.
+     */
+    void Poll(std::shared_ptr<FileStream>,
+              int events = Events::NotifyAll,
+              std::shared_ptr<void> context = nullptr);
+
     void Remove(const std::shared_ptr<FileStream>&);
 
     std::future<void> Start(EventHandler);
+    std::future<void> Start(ContextEventHandler);
     void Stop();
 
+    /**
+     * Pins the polling thread to the specified CPU
+     * when it is started. The dispatch threads are
+     * left free to run wherever there's room.
+     */
+    void SetAffinity(int cpu);
+
+    /**
+     * With the IoUring backend, in edge-triggered mode, makes
+     * sockets registered from now on be received from by the
+     * ring, with multishot receive requests into a registered
+     * ring of buffers. Their data is then delivered to them
+     * as it arrives, and reading them takes no system call.
+     * A socket whose unread data piles up, or whose receive
+     * request fails, goes back to being read directly.
+     * Does nothing if the kernel doesn't support it.
+     */
+    void SetRingReceive(bool);
+
     Signal<> OnStop;
 
 private:
-    void InsertOrIncrementRefCount(std::shared_ptr<FileStream>&, int events);
+    /**
+     * The control block of a watched file. Events carry its
+     * address, tagged with its generation in the upper bits,
+     * so they can be resolved without looking anything up.
+     * Slots are recycled but never freed while the poller
+     * lives, and a stale event is recognized by its tag.
+     */
+    struct Slot {
+        std::mutex Mutex;
+        std::uint16_t Generation = 0;
+        unsigned RefCount = 0;
+        int Events = 0;
+        std::shared_ptr<FileStream> Stream;
+        std::shared_ptr<void> Context;
+
+        // Guarded by the files mutex
+        bool Receiving = false;
+        bool StoppingReceive = false;
+    };
+
+    static constexpr int GenerationShift = 48;
+
+    // Slots are aligned, so the lowest bit of a tag is free
+    // to tell receive requests apart from poll requests.
+    static constexpr std::uint64_t ReceiveTag = 1;
+
+    void Register(std::shared_ptr<FileStream>&, int events, std::shared_ptr<void> context);
+    void InsertOrIncrementRefCount(std::shared_ptr<FileStream>&, int events, std::shared_ptr<void> context);
     void DecrementRefCount(const FileStream&);
-    void PollLoop(const EventHandler&);
-    void DispatchEvents(void* events, std::size_t n, const EventHandler&);
-    std::shared_ptr<FileStream> GetFileStreamFromPtr(void*);
+    Slot& AllocateSlot(std::shared_ptr<FileStream>&, int events, std::shared_ptr<void> context);
+    void ReleaseSlot(Slot&);
+    static std::uint64_t GetTag(const Slot&);
+    static Slot& GetSlot(std::uint64_t tag);
+    bool Watch(Slot&, bool rearm);
+    void Unwatch(Slot&);
+    void PollLoop(const ContextEventHandler&);
+    bool WaitForEpollEvents(std::vector<std::pair<std::uint64_t, int>>&);
+    bool WaitForRingEvents(std::vector<std::pair<std::uint64_t, int>>&);
+    bool HandleEndedPoll(const IoUring::Completion&);
+    void Receive(Slot&);
+    bool HandleReceive(const IoUring::Completion&, std::vector<std::pair<std::uint64_t, int>>&);
+    void StopReceiving(Slot&, SocketStream&);
+    void DispatchEvents(const std::vector<std::pair<std::uint64_t, int>>&, const ContextEventHandler&);
     int ConvertFromNative(int);
     int ConvertToNative(int);
 
     std::shared_ptr<ThreadPool> _threadPool;
-    int _fd;
+    Mode _mode;
+    int _fd = -1;
+    std::unique_ptr<IoUring> _ring;
+    std::vector<IoUring::Completion> _completions;
+    bool _buffersRegistered = false;
+    std::atomic_bool _ringReceive{false};
     std::atomic_bool _stop;
+    std::atomic_int _cpu{-1};
     std::thread _thread;
     std::promise<void> _promise;
-    std::unordered_map<const void*, std::pair<unsigned, std::shared_ptr<FileStream>>> _files;
+    std::unordered_map<const void*, Slot*> _files;
+    std::vector<std::unique_ptr<Slot>> _slots;
+    std::vector<Slot*> _freeSlots;
     std::mutex _filesMutex;
 };
 
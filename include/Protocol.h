@@ -34,6 +34,39 @@ enum class Version {
     Http11 ///< HTTP/1.1
 };
 
+/**
+ * A commonly used HTTP request header.
+ */
+enum class Header {
+    Accept, ///< Accept
+    AcceptCharset, ///< Accept-Charset
+    AcceptEncoding, ///< Accept-Encoding
+    AcceptLanguage, ///< Accept-Language
+    Authorization, ///< Authorization
+    CacheControl, ///< Cache-Control
+    Connection, ///< Connection
+    ContentEncoding, ///< Content-Encoding
+    ContentLength, ///< Content-Length
+    ContentType, ///< Content-Type
+    Cookie, ///< Cookie
+    Date, ///< Date
+    Expect, ///< Expect
+    Host, ///< Host
+    IfMatch, ///< If-Match
+    IfModifiedSince, ///< If-Modified-Since
+    IfNoneMatch, ///< If-None-Match
+    IfRange, ///< If-Range
+    IfUnmodifiedSince, ///< If-Unmodified-Since
+    Origin, ///< Origin
+    Pragma, ///< Pragma
+    Range, ///< Range
+    Referer, ///< Referer
+    TransferEncoding, ///< Transfer-Encoding
+    Upgrade, ///< Upgrade
+    UserAgent, ///< User-Agent
+    Unknown ///< Any other header
+};
+
 /**
  * An HTTP response status.
  */
@@ -1,9 +1,16 @@
 #pragma once
 
+#include "ChunkedDecoder.h"
+#include "HeaderIndex.h"
+#include "HeaderParser.h"
 #include "InputStream.h"
+#include "Pipe.h"
 #include "Protocol.h"
+#include "Slab.h"
 
+#include <functional>
 #include <memory>
+#include <optional>
 #include <string>
 #include <string_view>
 #include <utility>
@@ -16,8 +23,19 @@ namespace Chili {
  */
 class Request {
 public:
+    using ContentSink = std::function<void(std::string_view)>;
+
     Request() = default;
-    Request(std::shared_ptr<InputStream> input);
+
+    /**
+     * Creates a request read from the specified input.
+     * Its parsing state and header buffer are allocated
+     * with the specified allocator.
+     */
+    Request(std::shared_ptr<InputStream> input, SlabAllocator<char> = {});
+
+    Request(Request&&) noexcept;
+    Request& operator=(Request&&) noexcept;
     ~Request();
 
     /**
@@ -45,6 +63,11 @@ public:
      */
     bool HasHeader(const std::string_view& name) const;
 
+    /**
+     * Returns true if the request contains the specified known header.
+     */
+    bool HasHeader(Header) const;
+
     /**
      * Tries to get a header by name, returns true if it was found.
      *
@@ -53,6 +76,13 @@ public:
      */
     bool GetHeader(const std::string_view& name, std::string* value) const;
 
+    /**
+     * Tries to get a header by name, returns true if it was found.
+     * Unlike the overload above, this does not copy the value;
+     * it is only valid for as long as the request is.
+     */
+    bool GetHeader(const std::string_view& name, std::string_view* value) const;
+
     /**
      * Gets a header by name.
      * Throws if the header does not exist.
@@ -60,11 +90,30 @@ public:
     std::string_view GetHeader(const std::string_view& name) const;
 
     /**
-     * Returns true if the request has a message
-     * body (i.e. Content-Length > 0).
+     * Tries to get a known header, returns true if it was found.
+     * This is a single lookup, and is preferable to getting it by name.
+     */
+    bool GetHeader(Header, std::string_view* value) const;
+
+    /**
+     * Gets a known header.
+     * Throws if the header does not exist.
+     */
+    std::string_view GetHeader(Header) const;
+
+    /**
+     * Returns true if the request has a message body
+     * (i.e. Content-Length > 0, or it is chunked).
      */
     bool HasContent() const;
 
+    /**
+     * Returns true if the message body is sent with the
+     * chunked transfer coding, and so its length is not
+     * known in advance.
+     */
+    bool IsChunked() const;
+
     /**
      * If the message has associated content, returns true if
      * the content is already entirely available to be read.
@@ -73,10 +122,17 @@ public:
 
     /**
      * Gets the length of the associated content.
-     * Returns 0 if the Content-Length header is not present.
+     * Returns 0 if the Content-Length header is not present,
+     * as is the case for chunked requests.
      */
     std::size_t GetContentLength() const;
 
+    /**
+     * Gets the length of the content consumed so far.
+     * For chunked requests, this is the decoded length.
+     */
+    std::size_t GetConsumedContentLength() const;
+
     /**
      * Gets whether the connection should be kept alive.
      */
@@ -84,6 +140,8 @@ public:
 
     /**
      * Gets the message content, beside the header.
+     * For chunked requests, this is the decoded content,
+     * and it grows as more of it is consumed.
      */
     const std::vector<char>& GetContent() const;
 
@@ -101,22 +159,84 @@ public:
      */
     bool ConsumeContent(std::size_t maxBytes, std::size_t& totalBytesRead);
 
+    /**
+     * @internal
+     * Hands the content to the specified function as it is
+     * consumed, rather than keeping it all in the request,
+     * which then has no content to get. Each slice is only
+     * valid during the call.
+     */
+    void SetContentSink(ContentSink);
+
+    /**
+     * @internal
+     * Writes the content into the specified file as it is
+     * consumed, rather than keeping it in the request. If the
+     * input is a file stream, such as a socket, the content is
+     * spliced into the file through a pipe, and so never copied
+     * into memory. Chunked content is decoded, and so always is.
+     */
+    void SetContentFile(std::shared_ptr<FileStream>);
+
+    /**
+     * @internal
+     * Prepares the request for reading the next request
+     * on the same connection, reusing its buffers.
+     * Any bytes already read past the end of this request
+     * are kept, to be parsed as the start of the next one.
+     */
+    void Reset();
+
+    /**
+     * @internal
+     * Returns true if some of the next request on the
+     * same connection has already been read.
+     */
+    bool HasPipelinedData() const;
+
+    /**
+     * @internal
+     * Returns true if the whole header of the next
+     * request on the same connection has already been read.
+     */
+    bool HasPipelinedHeader() const;
+
 private:
     friend class HttpParserSettings;
 
     class HttpParserStringBuilder& GetStringBuilder();
-
-    std::vector<char> _buffer;
+    bool FinishHeader();
+    bool ConsumeChunkedContent(std::size_t maxBytes, std::size_t& totalBytesRead);
+    bool StreamContent(std::size_t maxBytes, std::size_t& totalBytesRead);
+    bool SpliceContent(std::size_t maxBytes, std::size_t& totalBytesRead);
+    void WriteContent(const char* data, std::size_t size);
+    void DecodeBufferedChunks();
+    char* ExtendContent(std::size_t size);
+    std::size_t GetEndPosition() const;
+    void ParseWithHttpParser(std::size_t bytesRead);
+    void ParseWithHeaderParser(const HeaderParser&, std::size_t bytesRead);
+
+    std::vector<char, SlabAllocator<char>> _buffer;
     std::size_t _bufferPosition = 0;
+    std::size_t _leftoverBytes = 0;
     std::shared_ptr<InputStream> _input;
-    void* _privateData;
+    std::shared_ptr<void> _privateData;
     std::size_t _headerBytesParsed = 0;
     bool _parsedHeader = false;
     bool _onlySentHeaderFirst = false;
-    std::string_view _uri;
-    std::vector<std::pair<std::string_view, std::string_view>> _headers;
+    HeaderParser::Result _header;
+    HeaderParser::FieldList _headers;
+    HeaderIndex _index;
     std::vector<char> _content;
     std::size_t _contentPosition = 0;
+    ChunkedDecoder _chunkedDecoder;
+    std::size_t _chunkedBodyPosition = 0;
+    std::vector<char> _framingBuffer;
+    std::size_t _framingPosition = 0;
+    std::size_t _framingEnd = 0;
+    ContentSink _contentSink;
+    std::shared_ptr<FileStream> _contentFile;
+    std::optional<Pipe> _contentPipe;
 };
 
 } // namespace Chili
@@ -1,27 +1,85 @@
 #pragma once
 
 #include "BufferedInputStream.h"
+#include "Compressor.h"
+#include "FileStream.h"
 #include "InputStream.h"
+#include "MonotonicArena.h"
 #include "OutputStream.h"
 #include "Protocol.h"
 #include "Signal.h"
+#include "Slab.h"
 
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <ctime>
 #include <functional>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <string_view>
 #include <utility>
 #include <vector>
 
 namespace Chili {
 
 class CachedResponse {
+public:
+    /**
+     * Gets the number of bytes the response keeps in memory.
+     */
+    std::size_t GetSize() const;
+
+private:
+    /**
+     * Gets the wire image to send, refreshing
+     * its Date header if it's gone stale.
+     * For file content, it's only the head.
+     */
+    std::shared_ptr<const std::string> GetWire(bool keepAlive);
+
+    /**
+     * Gets the variant of the response compressed with the
+     * specified content coding, compressing it the first time.
+     * Returns null if it's better sent as it is.
+     */
+    std::shared_ptr<CachedResponse> GetCompressed(Compression);
+
+    /**
+     * Gets the 304 Not Modified variant of the
+     * response, making it the first time.
+     */
+    std::shared_ptr<CachedResponse> GetNotModified();
+
+    std::shared_ptr<CachedResponse> Compress(Compression);
+    std::shared_ptr<CachedResponse> MakeNotModified();
+    void SetWire(std::string_view header, std::string_view body);
+
+    struct Variant {
+        std::once_flag Once;
+        std::shared_ptr<CachedResponse> Response;
+    };
+
     TransferMode _transferMode;
     Status _status;
     bool _keepAlive = true;
-    std::string _header;
+    std::string_view _header;
     std::shared_ptr<InputStream> _stream;
     std::shared_ptr<std::string> _strBody;
     std::shared_ptr<std::vector<char>> _body;
+    std::shared_ptr<FileStream> _file;
+    std::uint64_t _fileOffset = 0;
+    std::uint64_t _fileLength = 0;
+    std::shared_ptr<const std::string> _wire;
+    std::shared_ptr<const std::string> _closeWire;
+    std::size_t _bodySize = 0;
+    std::size_t _dateOffset = 0;
+    std::atomic<std::time_t> _date{0};
+    std::array<Variant, 2> _compressed;
+    Variant _notModified;
+    std::string _etag;
+    std::string _lastModified;
 
     friend class Response;
 };
@@ -43,8 +101,17 @@ public:
     };
 
     Response() = default;
+
+    /**
+     * Creates a response written to the specified stream.
+     * Headers and the serialized response head are kept in
+     * the specified arena, which must outlive the response.
+     * Without one, the response uses an arena of its own.
+     */
     Response(std::shared_ptr<OutputStream>,
-             std::weak_ptr<Signal<>> readyToWrite);
+             std::weak_ptr<Signal<>> readyToWrite,
+             SlabAllocator<CachedResponse> = {},
+             MonotonicArena* = nullptr);
 
     /**
      * Resets the state of the response.
@@ -59,6 +126,16 @@ public:
      * Creates a cached response which can later
      * be sent through to improve efficiency.
      *
+     * The response is frozen into its complete wire image, head
+     * and content together, once for connections that are kept
+     * alive and once for those that are closed, so that sending
+     * it takes a single write. Any Connection header is replaced
+     * accordingly. A file's content is left out of the images,
+     * and is still sent from the file.
+     *
+     * A frozen 200 OK response gets an ETag header, made from a
+     * hash of its content, unless it already has one.
+     *
      * NOTE: A response that has a stream as its
      * content cannot be cached, and attempting
      * to cache it will throw an error.
@@ -83,7 +160,13 @@ public:
      * @param name  The HTTP response header name
      * @param value The header's value
      */
-    void AppendHeader(std::string name, std::string value);
+    void AppendHeader(std::string_view name, std::string_view value);
+
+    /**
+     * Tries to get a header that was set, by name,
+     * returns true if it was found.
+     */
+    bool GetHeader(std::string_view name, std::string_view* value) const;
 
     /**
      * Sets a cookie.
@@ -91,7 +174,7 @@ public:
      * @param name  The name of the cookie
      * @param value The value of the cookie
      */
-    void SetCookie(std::string name, std::string value);
+    void SetCookie(std::string_view name, std::string_view value);
 
     /**
      * Sets a cookie with extra cookie options.
@@ -100,7 +183,7 @@ public:
      * @param value The value of the cookie
      * @param opts  Extra options for the cookie
      */
-    void SetCookie(std::string name, std::string value, const CookieOptions& opts);
+    void SetCookie(std::string_view name, std::string_view value, const CookieOptions& opts);
 
     /**
      * Sets the response message content (e.g. HTML, or some file data).
@@ -120,10 +203,81 @@ public:
      * Sets the response message content from a stream.
      * This will cause the response to be chunked.
      *
+     * Whatever data the stream has available is read into
+     * several chunks, which are then sent all at once.
+     *
      * @param stream The stream containing the data to be sent
      */
     void SetContent(std::shared_ptr<InputStream> stream);
 
+    /**
+     * Sets the response message content to part of a file.
+     * It is sent with a Content-Length header, straight from
+     * the file to the socket with sendfile(), and so is never
+     * copied into memory. The file position is not changed,
+     * so the same file may be used for many responses.
+     *
+     * A 200 OK response gets ETag and Last-Modified headers, made
+     * from the file's modification time and the data's size and
+     * offset, unless they're set by the time the status is.
+     *
+     * @param file   The file containing the data to be sent
+     * @param offset The offset of the data in the file
+     * @param length The length of the data
+     */
+    void SetContent(std::shared_ptr<FileStream> file, std::uint64_t offset, std::uint64_t length);
+
+    /**
+     * Compresses the content with the specified content coding,
+     * and sets the Content-Encoding header accordingly. Content
+     * in memory is compressed at once, unless it's too small for
+     * it to be worthwhile, and streamed content is compressed a
+     * chunk at a time. File content is never compressed, since
+     * it's sent straight from the file.
+     *
+     * When using a cached response, its compressed variant is
+     * sent instead, which is only compressed the first time.
+     *
+     * Must be called before setting the status.
+     */
+    void SetCompression(Compression);
+
+    /**
+     * Compresses the content with whichever content coding the
+     * client prefers, given its Accept-Encoding header, if any,
+     * and adds Accept-Encoding to the Vary header.
+     * See SetCompression().
+     */
+    void Compress(std::string_view acceptEncoding);
+
+    /**
+     * Returns true if the client already has the response, given
+     * the values of the request's If-None-Match and If-Modified-Since
+     * headers, or empty ones if they're missing. The response's ETag
+     * and Last-Modified headers are compared against them, so it must
+     * have been prepared first.
+     */
+    bool IsNotModified(std::string_view ifNoneMatch, std::string_view ifModifiedSince) const;
+
+    /**
+     * Turns the prepared response into a 304 Not Modified,
+     * dropping its content, along with any headers but those
+     * that describe it, like ETag and Cache-Control. A file
+     * set as the content is then never read.
+     */
+    void SetNotModified();
+
+    /**
+     * Sets the size of the chunks a streamed response is sent in.
+     * The default is 4 KiB.
+     *
+     * If maxSize is greater than size, then the chunk size adapts:
+     * it doubles with every chunk read while the socket keeps up, up
+     * to maxSize or the socket's send buffer size, whichever is
+     * smaller, and halves, down to size, whenever it doesn't.
+     */
+    void SetChunkSize(std::size_t size, std::size_t maxSize = 0);
+
     /**
      * Sets the status of the response.
      */
@@ -131,9 +285,25 @@ public:
 
     /**
      * Uses a previously cached response as this response.
+     * Whether the connection is kept alive after it is sent
+     * is kept as it was set before this call.
      */
     void UseCached(std::shared_ptr<CachedResponse>);
 
+    /**
+     * Lets the server's response cache, if it has one, keep
+     * this response for the specified time, and send it to
+     * matching requests without processing them. Only GET and
+     * HEAD responses whose content is in memory are kept.
+     * See HttpServer::SetResponseCache().
+     */
+    void SetCacheTtl(std::chrono::milliseconds);
+
+    /**
+     * @internal
+     */
+    std::chrono::milliseconds GetCacheTtl() const;
+
     /**
      * @internal
      * Writes response data to the output stream.
@@ -155,7 +325,7 @@ public:
 
     /**
      * @internal
-     * Gets the chunk buffer size.
+     * Gets the size of the next chunk of a streamed response.
      */
     std::size_t GetBufferSize() const;
 
@@ -164,14 +334,62 @@ public:
      */
     bool IsPrepared() const;
 
+    /**
+     * @internal
+     * Returns true if the entire response is in memory,
+     * such that it may be written along with others.
+     */
+    bool IsBuffered() const;
+
+    /**
+     * @internal
+     * Appends whatever is left to write of a buffered response
+     * to the vector, up to the specified number of bytes.
+     * Returns the number of bytes appended.
+     */
+    std::size_t GatherData(std::vector<std::pair<const void*, std::size_t>>&, std::size_t maxBytes) const;
+
+    /**
+     * @internal
+     * Marks data of a buffered response as written, given the
+     * number of bytes written in total, starting with it.
+     * Returns how many of these bytes belonged to it.
+     */
+    std::size_t ConsumeData(std::size_t bytesWritten);
+
+    /**
+     * @internal
+     * Returns true if a buffered response was entirely written.
+     */
+    bool IsFlushed() const;
+
 private:
+    static constexpr std::size_t DefaultChunkSize = 0x1000;
+    static constexpr std::size_t MaxGatheredChunks = 0x10;
+
     enum class ReadResult {
         Buffering,
         DataAvailable,
     };
 
+    /**
+     * A chunk of a streamed response,
+     * with its data in the body buffer.
+     */
+    struct Chunk {
+        char Header[20];
+        std::size_t HeaderSize;
+        std::size_t Offset;
+        std::size_t Size;
+    };
+
+    using HeaderList = std::vector<std::pair<std::string_view, std::string_view>,
+                                   ArenaAllocator<std::pair<std::string_view, std::string_view>>>;
+
     void Prepare(Status);
     CachedResponse& GetState() const;
+    MonotonicArena& GetArena();
+    HeaderList& GetHeaders();
 
     template <class T>
     FlushStatus FlushWithHeader(const T& data, std::size_t& maxBytes, std::size_t& consumed);
@@ -179,25 +397,44 @@ private:
     template <class T>
     FlushStatus FlushBody(const T& data, std::size_t& maxBytes, std::size_t& consumed);
 
+    FlushStatus FlushWire(std::size_t& maxBytes, std::size_t& consumed);
     FlushStatus FlushStream(std::size_t& maxBytes, std::size_t& consumed);
+    FlushStatus FlushFile(std::size_t& maxBytes, std::size_t& consumed);
+
+    std::string_view GetHead() const;
+    std::string_view GetBufferedBody() const;
+    void Freeze();
 
-    ReadResult ReadNextChunk();
-    std::vector<std::pair<const void*, std::size_t>> GetChunkVector(std::size_t maxBytes);
-    void UpdateChunkWritePositions(std::size_t bytesWritten);
+    ReadResult ReadChunks(std::size_t maxBytes);
+    void GrowChunkSize();
+    void ShrinkChunkSize();
+    std::size_t GetSendBufferSize();
+    std::vector<std::pair<const void*, std::size_t>> GetChunkVector(std::size_t maxBytes) const;
 
     std::shared_ptr<OutputStream> _stream;
     std::weak_ptr<Signal<>> _readyToWrite;
+    SlabAllocator<CachedResponse> _allocator;
+    MonotonicArena* _arena = nullptr;
+    std::shared_ptr<MonotonicArena> _ownArena;
     bool _prepared = false;
-    std::vector<std::pair<std::string, std::string>> _headers;
+    std::chrono::milliseconds _cacheTtl{0};
+    HeaderList _headers;
     mutable std::shared_ptr<CachedResponse> _response;
+    std::shared_ptr<const std::string> _wire;
+    bool _wireKeepAlive = true;
+    Compression _compression = Compression::None;
+    std::unique_ptr<Compressor> _compressor;
+    std::vector<char> _uncompressedChunk;
     std::size_t _writePosition = 0;
-    std::size_t _chunkWritePosition = 0;
-    std::size_t _chunkSize;
-    std::string _chunkHeader;
-    std::size_t _chunkHeaderWritePosition = 0;
-    std::size_t _chunkTrailWritePosition = 0;
-    bool _needNewChunk = true;
+    std::vector<Chunk> _chunks;
+    std::size_t _chunksWireSize = 0;
+    std::size_t _chunksWritePosition = 0;
     bool _isLastChunk = false;
+    bool _socketKeepingUp = true;
+    std::size_t _chunkBufferSize = DefaultChunkSize;
+    std::size_t _minChunkBufferSize = DefaultChunkSize;
+    std::size_t _maxChunkBufferSize = DefaultChunkSize;
+    std::size_t _sendBufferSize = 0;
 };
 
 } // namespace Chili
@@ -0,0 +1,149 @@
+#pragma once
+
+#include "Clock.h"
+#include "Request.h"
+#include "Response.h"
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace Chili {
+
+/**
+ * A cache of complete responses, shared by all of a server's
+ * channels, so that requests for hot resources are answered
+ * without processing them at all.
+ *
+ * Responses are keyed by the request's method and URI, along
+ * with the values of whichever request headers the response
+ * said it varies on, in its Vary header.
+ *
+ * The cache is split into shards, each with a lock of its own,
+ * and each holding at most its share of the cache's size limit.
+ * Once a shard is full, its least recently used resources are
+ * evicted. With TinyLFU eviction, a new resource is only let in
+ * if it's been requested more often than the resource it would
+ * evict, which keeps one-off requests from flushing hot ones.
+ */
+class ResponseCache {
+public:
+    enum class Eviction {
+        Lru,
+        TinyLfu
+    };
+
+    /**
+     * Creates a cache holding up to the specified number of
+     * bytes of responses (headers and content), split evenly
+     * between the specified number of shards.
+     */
+    ResponseCache(std::size_t maxBytes, Eviction = Eviction::TinyLfu, std::size_t shards = 0x10);
+
+    ResponseCache(const ResponseCache&) = delete;
+    ResponseCache& operator=(const ResponseCache&) = delete;
+
+    /**
+     * Finds a response to the request which hasn't expired yet.
+     * Returns null if there's none.
+     */
+    std::shared_ptr<CachedResponse> Find(const Request&);
+
+    /**
+     * Adds a response to the request, kept for the specified time.
+     * The response must have been cached by Response::Cache().
+     *
+     * @param vary The value of the response's Vary header
+     *
+     * Returns false if the response wasn't let in, due to its
+     * size, its Vary header, or to the eviction policy.
+     */
+    bool Insert(const Request&,
+                std::shared_ptr<CachedResponse>,
+                std::chrono::milliseconds ttl,
+                std::string_view vary = {});
+
+    /**
+     * Removes all responses for the specified method and URI.
+     */
+    void Erase(Method, std::string_view uri);
+
+    /**
+     * Removes all responses.
+     */
+    void Clear();
+
+    /**
+     * Gets the number of bytes of responses being held.
+     */
+    std::size_t GetSize() const;
+
+private:
+    static constexpr std::size_t SketchWidth = 0x400;
+    static constexpr std::size_t SketchDepth = 4;
+
+    /**
+     * A count-min sketch of how often resources are requested,
+     * with 4-bit counters, which are halved every so often so
+     * that past popularity fades away.
+     */
+    class FrequencySketch {
+    public:
+        void Increment(std::size_t hash);
+        unsigned Estimate(std::size_t hash) const;
+        void Clear();
+
+    private:
+        std::size_t GetIndex(std::size_t hash, std::size_t row) const;
+
+        std::array<std::uint8_t, SketchWidth * SketchDepth / 2> _counters{};
+        std::size_t _additions = 0;
+    };
+
+    struct Variant {
+        std::string VaryValues;
+        std::shared_ptr<CachedResponse> Response;
+        Clock::TimePoint Expiry;
+        std::size_t Size;
+    };
+
+    struct Resource {
+        std::string Key;
+        std::size_t Hash;
+        std::vector<std::string> Vary;
+        std::vector<Variant> Variants;
+        std::size_t Size = 0;
+    };
+
+    using ResourceList = std::list<Resource>;
+
+    struct Shard {
+        mutable std::mutex Mutex;
+        ResourceList Resources; // most recently used first
+        std::unordered_map<std::string_view, ResourceList::iterator> Index;
+        FrequencySketch Sketch;
+        std::size_t Size = 0;
+    };
+
+    static std::string MakeKey(Method, std::string_view uri);
+    static std::string GetVaryValues(const Request&, const std::vector<std::string>& vary);
+
+    Shard& GetShard(std::size_t hash);
+    void EraseResource(Shard&, ResourceList::iterator);
+    bool MakeRoom(Shard&, std::size_t size, std::size_t hash, ResourceList::iterator keep);
+
+    const std::size_t _shardCount;
+    const std::size_t _maxShardSize;
+    const Eviction _eviction;
+    std::unique_ptr<Shard[]> _shards;
+};
+
+} // namespace Chili
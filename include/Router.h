@@ -2,11 +2,13 @@
 
 #include "Channel.h"
 #include "ChannelFactory.h"
+#include "MonotonicArena.h"
 #include "Protocol.h"
 
 #include <functional>
 #include <map>
 #include <regex>
+#include <string_view>
 #include <unordered_map>
 
 namespace Chili {
@@ -23,8 +25,21 @@ public:
      *
      * For example, if your route was "/hello/(.+)", then
      * Args[0] will contain whatever was captured in the group.
+     *
+     * The arguments are views into the request's URI, stored
+     * in the channel's arena. They are only valid until the
+     * arena is reset, which happens once the response has been
+     * sent and the channel moves on to its next request. Copy
+     * them, e.g. into std::string, to keep them any longer,
+     * such as in handlers which respond asynchronously and
+     * capture their arguments.
+     *
+     * @note Args used to be a vector of owning std::strings.
+     *       Handlers taking Args by const reference and only
+     *       reading the arguments need no change, but handlers
+     *       that moved them out or kept them must copy them now.
      */
-    using Args = std::vector<std::string>;
+    using Args = std::vector<std::string_view, ArenaAllocator<std::string_view>>;
 
     /**
      * A function that, upon receiving a new request,
@@ -0,0 +1,145 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace Chili {
+
+/**
+ * A cache of fixed-size memory blocks, recycled through
+ * a concurrent memory pool for each power-of-two size class.
+ *
+ * Allocations are rounded up to their size class and
+ * served from its pool, so objects that are repeatedly
+ * created and destroyed (e.g. one per connection) reuse
+ * the same blocks instead of going through the heap.
+ * Pools grow as needed, and only allocations bigger than
+ * the largest size class use the heap.
+ */
+class SlabCache {
+public:
+    static constexpr std::size_t MinBlockSize = 0x40;
+    static constexpr std::size_t MaxBlockSize = 0x4000;
+
+    /**
+     * @param blocksPerClass The number of blocks by which
+     *                       each size class grows at a time.
+     */
+    explicit SlabCache(std::size_t blocksPerClass = 0x80);
+    SlabCache(const SlabCache&) = delete;
+    SlabCache& operator=(const SlabCache&) = delete;
+
+    void* Allocate(std::size_t size);
+    void Deallocate(void*, std::size_t size) noexcept;
+
+    /**
+     * Gets the number of blocks of the size class
+     * of the specified size that are not in use.
+     */
+    std::size_t GetFreeBlocks(std::size_t size) const;
+
+    /**
+     * Gets the number of blocks of the size class of
+     * the specified size, whether in use or not.
+     */
+    std::size_t GetCapacity(std::size_t size) const;
+
+    /**
+     * Releases the memory of whatever blocks are
+     * entirely idle back to the OS. Returns the
+     * number of arenas whose memory was released.
+     */
+    std::size_t ReleaseIdleMemory();
+
+private:
+    struct SizeClass {
+        std::shared_ptr<void> Pool;
+        void* (*Allocate)(void* pool);
+        void (*Deallocate)(void* pool, void* mem);
+        std::size_t (*GetFreeSlots)(const void* pool);
+        std::size_t (*GetCapacity)(const void* pool);
+        std::size_t (*ReleaseIdleArenas)(void* pool);
+    };
+
+    static constexpr std::size_t SizeClasses = 9;
+
+    template <std::size_t... Indices>
+    void CreateSizeClasses(std::size_t blocksPerClass, std::index_sequence<Indices...>);
+
+    template <std::size_t Size>
+    static SizeClass CreateSizeClass(std::size_t blocks);
+
+    static std::size_t GetSizeClassIndex(std::size_t size);
+
+    std::array<SizeClass, SizeClasses> _sizeClasses;
+};
+
+/**
+ * A standard allocator allocating from a slab cache,
+ * so that it can be used with std::allocate_shared()
+ * and standard containers. A default-constructed one
+ * simply allocates from the heap.
+ */
+template <class T>
+class SlabAllocator {
+public:
+    using value_type = T;
+
+    // Moving a container must move its memory along with it,
+    // even if it was allocated from a different cache.
+    using propagate_on_container_copy_assignment = std::true_type;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+
+    SlabAllocator() = default;
+
+    SlabAllocator(std::shared_ptr<SlabCache> cache) :
+        _cache{std::move(cache)} {}
+
+    template <class U>
+    SlabAllocator(const SlabAllocator<U>& other) :
+        _cache{other._cache} {}
+
+    T* allocate(std::size_t n) {
+        static_assert(alignof(T) <= alignof(std::max_align_t), "Over-aligned types are not supported");
+
+        if (_cache)
+            return static_cast<T*>(_cache->Allocate(n * sizeof(T)));
+        else
+            return static_cast<T*>(::operator new(n * sizeof(T)));
+    }
+
+    void deallocate(T* t, std::size_t n) noexcept {
+        if (_cache)
+            _cache->Deallocate(t, n * sizeof(T));
+        else
+            ::operator delete(t);
+    }
+
+    const std::shared_ptr<SlabCache>& GetCache() const {
+        return _cache;
+    }
+
+    template <class U>
+    bool operator==(const SlabAllocator<U>& other) const {
+        return _cache == other._cache;
+    }
+
+    template <class U>
+    bool operator!=(const SlabAllocator<U>& other) const {
+        return _cache != other._cache;
+    }
+
+private:
+    std::shared_ptr<SlabCache> _cache;
+
+    template <class U>
+    friend class SlabAllocator;
+};
+
+} // namespace Chili
+
@@ -1,9 +1,11 @@
 #pragma once
 
 #include "FileStream.h"
+#include "Slab.h"
 
 #include <atomic>
 #include <memory>
+#include <mutex>
 #include <vector>
 
 namespace Chili {
@@ -12,15 +14,47 @@ class SocketStream : public FileStream {
 public:
     SocketStream();
     SocketStream(NativeHandle);
+
+    /**
+     * Creates a stream whose use count, which is shared
+     * with its copies, is allocated with the allocator.
+     */
+    SocketStream(NativeHandle, const SlabAllocator<std::atomic_int>&);
     SocketStream(const SocketStream&);
     SocketStream(SocketStream&&);
 
     SocketStream& operator=(const SocketStream&);
     SocketStream& operator=(SocketStream&&);
 
+    std::size_t Read(void* buffer, std::size_t maxBytes) override;
+    using FileStream::Read;
+
     std::size_t Write(const void* buffer, std::size_t maxBytes) override;
     std::size_t WriteVector(std::vector<std::pair<const void*, std::size_t>>) override;
     std::size_t WriteTo(FileStream&, std::size_t maxBytes) override;
+    using FileStream::WriteTo;
+
+    /**
+     * @internal
+     * Makes the socket's data come only from Deliver(),
+     * for when someone else is receiving it on the socket's
+     * behalf, until EndDelivery() is called.
+     */
+    void BeginDelivery();
+
+    /**
+     * @internal
+     * Hands over data received on the socket's behalf, to be
+     * read next. Returns how much delivered data is unread.
+     */
+    std::size_t Deliver(const void* data, std::size_t size);
+
+    /**
+     * @internal
+     * Makes the socket's data come from the socket itself again,
+     * once all of the data delivered so far has been read.
+     */
+    void EndDelivery();
 
 protected:
     static SocketStream& IncrementUseCount(SocketStream&);
@@ -29,6 +63,14 @@ protected:
     void Shutdown();
 
     std::shared_ptr<std::atomic_int> _useCount;
+
+private:
+    void ConsumeDelivered(std::size_t);
+
+    std::mutex _deliveryMutex;
+    std::vector<char> _delivered;
+    std::size_t _deliveredPosition = 0;
+    bool _delivering = false;
 };
 
 } // namespace Chili
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <string_view>
+#include <strings.h>
+
+namespace Chili {
+
+/**
+ * Returns true for the whitespace allowed
+ * around header values and list elements.
+ */
+inline bool IsWhitespace(char c) {
+    return c == ' ' || c == '\t';
+}
+
+/**
+ * Compares two strings, ignoring the case of ASCII letters,
+ * as is done for header names and most header tokens.
+ */
+inline bool EqualsIgnoreCase(std::string_view a, std::string_view b) {
+    return a.size() == b.size() && !::strncasecmp(a.data(), b.data(), a.size());
+}
+
+/**
+ * Removes leading and trailing whitespace.
+ */
+inline std::string_view Trim(std::string_view s) {
+    while (!s.empty() && IsWhitespace(s.front()))
+        s.remove_prefix(1);
+
+    while (!s.empty() && IsWhitespace(s.back()))
+        s.remove_suffix(1);
+
+    return s;
+}
+
+/**
+ * Returns true if a raw header line, as in "Name: value",
+ * is for the specified header name.
+ */
+inline bool IsHeader(std::string_view line, std::string_view name) {
+    return line.size() > name.size() &&
+           line[name.size()] == ':' &&
+           EqualsIgnoreCase(line.substr(0, name.size()), name);
+}
+
+/**
+ * Removes the first element of a list, such as the comma-separated
+ * values of many headers, and returns it without whitespace.
+ * Elements may be empty, e.g. in "gzip, , deflate".
+ */
+inline std::string_view PopListElement(std::string_view& list, char separator = ',') {
+    auto end = std::min(list.find(separator), list.size());
+    auto element = Trim(list.substr(0, end));
+
+    list.remove_prefix(std::min(end + 1, list.size()));
+
+    return element;
+}
+
+/**
+ * Returns true if a comma-separated list, such as a header
+ * value, has an element equal to the token, ignoring case.
+ */
+inline bool HasToken(std::string_view list, std::string_view token) {
+    while (!list.empty()) {
+        if (EqualsIgnoreCase(PopListElement(list), token))
+            return true;
+    }
+
+    return false;
+}
+
+} // namespace Chili
@@ -2,6 +2,7 @@
 
 #include "Signal.h"
 #include "Acceptor.h"
+#include "Slab.h"
 #include "SocketStream.h"
 #include "TcpConnection.h"
 
@@ -18,7 +19,7 @@ namespace Chili {
  */
 class TcpAcceptor : public Acceptor {
 public:
-    TcpAcceptor(const IPEndpoint&, int listeners);
+    TcpAcceptor(const IPEndpoint&, int listeners, Poller::Backend = Poller::Backend::Epoll);
 
     /**
      * Gets the endpoint that this server
@@ -29,12 +30,13 @@ public:
     Signal<std::shared_ptr<TcpConnection>> OnAccepted;
 
 private:
-    void RelinquishSocket(int fd, IPEndpoint remote) override;
+    void RelinquishSocket(int fd, std::optional<IPEndpoint> remote) override;
     void ResetListenerSocket(SocketStream&) override;
     void* AddressBuffer() override;
     std::size_t* AddressBufferSize() override;
 
     IPEndpoint _endpoint;
+    std::shared_ptr<SlabCache> _slab;
     ::sockaddr_in _addrBuffer;
     std::size_t _addrBufferSize = sizeof(::sockaddr_in);
 };
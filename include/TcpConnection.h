@@ -6,6 +6,8 @@
 #include <array>
 #include <cstdint>
 #include <memory>
+#include <mutex>
+#include <optional>
 #include <string>
 
 namespace Chili {
@@ -15,12 +17,20 @@ public:
     TcpConnection(const IPEndpoint&);
     TcpConnection(SocketStream, const IPEndpoint&);
 
-    const IPEndpoint& Endpoint() const noexcept;
+    /**
+     * Creates a connection whose remote endpoint
+     * is only looked up when first asked for.
+     */
+    explicit TcpConnection(SocketStream);
+
+    const IPEndpoint& Endpoint() const;
     void Cork(bool);
     void Flush();
+    std::size_t GetSendBufferSize() const;
 
 private:
-    IPEndpoint _endpoint;
+    mutable std::once_flag _endpointLookup;
+    mutable std::optional<IPEndpoint> _endpoint;
 };
 
 inline IPEndpoint::IPEndpoint(const std::array<std::uint8_t, 4> address, int port) :
@@ -35,9 +45,5 @@ inline int IPEndpoint::GetPort() const noexcept {
     return _port;
 }
 
-inline const IPEndpoint& TcpConnection::Endpoint() const noexcept {
-    return _endpoint;
-}
-
 } // namespace Chili
 
@@ -0,0 +1,118 @@
+#pragma once
+
+#include "Clock.h"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <vector>
+
+namespace Chili {
+
+/**
+ * A hashed timing wheel.
+ *
+ * Deadlines are hashed into a fixed number of slots,
+ * each covering one tick of time, so that arming and
+ * cancelling a timer are both O(1). Expiring timers
+ * only looks at the slots whose ticks have passed,
+ * regardless of how many timers are armed overall,
+ * and so does finding the next expiry, which is cached.
+ *
+ * The wheel is not synchronized. It is up to its
+ * owner to protect it when it is shared.
+ */
+class TimerWheel {
+public:
+    /**
+     * A timer that can be armed on a wheel.
+     * Timers are intrusive, so arming one never allocates.
+     * A timer must be cancelled before it is destroyed.
+     */
+    class Timer {
+    public:
+        Timer() = default;
+        Timer(const Timer&) = delete;
+        Timer& operator=(const Timer&) = delete;
+
+        bool IsArmed() const;
+        Clock::TimePoint GetDeadline() const;
+
+        /**
+         * Called by TimerWheel::Expire() once the deadline has passed.
+         * The timer is already disarmed when this is called, and it
+         * may be safely re-armed from within the callback.
+         */
+        std::function<void()> OnExpired;
+
+    private:
+        Timer* _prev = nullptr;
+        Timer* _next = nullptr;
+        Clock::TimePoint _deadline;
+        std::size_t _slot = 0;
+        std::size_t _rounds = 0;
+        std::uint64_t _expiry = 0;
+        bool _armed = false;
+
+        friend class TimerWheel;
+    };
+
+    TimerWheel(std::chrono::milliseconds resolution, std::size_t slots);
+    TimerWheel(const TimerWheel&) = delete;
+    TimerWheel& operator=(const TimerWheel&) = delete;
+
+    /**
+     * Arms a timer to expire at the specified deadline.
+     * If the timer is already armed, it is moved.
+     */
+    void Insert(Timer&, Clock::TimePoint deadline);
+
+    /**
+     * Disarms a timer. Does nothing if it isn't armed.
+     */
+    void Cancel(Timer&);
+
+    /**
+     * Expires all timers due by the specified time, and returns
+     * how many expired. Timers never expire before their deadline,
+     * but may expire up to one tick after it.
+     */
+    std::size_t Expire(Clock::TimePoint now);
+
+    /**
+     * Gets the time of the next tick at which at least one
+     * timer might expire. Returns Clock::TimePoint::max()
+     * if no timers are armed.
+     */
+    Clock::TimePoint GetNextExpiry() const;
+
+    /**
+     * Gets the number of armed timers.
+     */
+    std::size_t GetCount() const;
+
+private:
+    void Link(Timer&, std::size_t slot);
+    void Unlink(Timer&);
+    void UpdateNextExpiry() const;
+
+    std::chrono::nanoseconds _resolution;
+    std::vector<Timer*> _slots;
+    std::vector<std::size_t> _due; // Timers with no rounds left, per slot
+    std::size_t _current = 0;
+    std::uint64_t _tick = 0; // Ticks passed, up to _current
+    Clock::TimePoint _currentTick;
+    std::size_t _count = 0;
+
+    // The tick of the next expiry, which is never later
+    // than any armed timer's, but may be earlier once
+    // the timer holding it is gone, in which case it
+    // is stale and looked up again when it's needed.
+    mutable std::uint64_t _nextExpiry = std::numeric_limits<std::uint64_t>::max();
+    mutable bool _nextExpiryStale = false;
+    mutable std::uint64_t _nextWalk = 0;
+};
+
+} // namespace Chili
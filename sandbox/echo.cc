@@ -2,6 +2,7 @@
 #include "HttpServer.h"
 #include "Request.h"
 #include "Response.h"
+#include "ResponseCache.h"
 #include "SystemError.h"
 
 #include <chrono>
@@ -22,7 +23,9 @@ struct ServerConfiguration {
 };
 
 std::unique_ptr<HttpServer> CreateServer(ServerConfiguration config, std::unique_ptr<ChannelFactory> channelFactory) {
-    return std::make_unique<HttpServer>(config._endpoint, std::move(channelFactory));
+    auto server = std::make_unique<HttpServer>(config._endpoint, std::move(channelFactory));
+    server->SetResponseCache(std::make_shared<ResponseCache>(0x100000));
+    return server;
 }
 
 ServerConfiguration CreateConfiguration(std::vector<std::string> argv) {
@@ -102,9 +105,6 @@ void PrintInfo(const Request& request) {
 std::mutex _outputMutex;
 
 std::unique_ptr<ChannelFactory> CreateChannelFactory(const ServerConfiguration& config) {
-    static std::shared_ptr<CachedResponse> cr;
-    static std::atomic_bool crSet{false};
-
     struct CustomChannel : Channel {
         CustomChannel(std::shared_ptr<FileStream> fs, bool verbose) :
             Channel(std::move(fs)),
@@ -121,19 +121,12 @@ std::unique_ptr<ChannelFactory> CreateChannelFactory(const ServerConfiguration&
                 std::cout << "\n";
             }
 
-            if (crSet) {
-                res.UseCached(cr);
-                return SendResponse();
-            }
-
             const char msg[] = "<b><u>Hello world!</u></b>";
             auto data = std::make_shared<std::vector<char>>(std::begin(msg), std::end(msg) - 1);
             res.SetContent(data);
+            res.SetCacheTtl(1s);
             res.SetStatus(Status::Ok);
 
-            cr = res.Cache();
-            crSet = true;
-
             return SendResponse();
         }
 
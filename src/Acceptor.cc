@@ -4,14 +4,42 @@
 #include "SystemError.h"
 
 #include <algorithm>
+#include <linux/io_uring.h>
 #include <sys/socket.h>
 #include <sys/types.h>
 #include <unistd.h>
 
 namespace Chili {
 
-Acceptor::Acceptor(int listeners)
+namespace {
+
+const auto RingAcceptTimeout = std::chrono::milliseconds(100);
+
+/**
+ * Errors after which accepting may go on,
+ * whether they came from accept() or the ring.
+ */
+bool IsRecoverableAcceptError(int error) {
+    auto recoverable = {
+        ECONNABORTED,
+        EMFILE,
+        ENFILE,
+        ENOBUFS,
+        ENOMEM,
+        EPROTO,
+        EPERM,
+        EINTR,
+        EAGAIN
+    };
+
+    return std::find(begin(recoverable), end(recoverable), error) != end(recoverable);
+}
+
+} // unnamed namespace
+
+Acceptor::Acceptor(int listeners, Poller::Backend backend)
     : _listeners(listeners)
+    , _backend(backend)
     , _listenerSockets(listeners)
     , _listenerThreads(listeners) {}
 
@@ -42,6 +70,17 @@ std::future<void> Acceptor::Start() {
 }
 
 void Acceptor::AcceptLoop(int listener) {
+    if (_backend == Poller::Backend::IoUring && IoUring::IsSupported()) {
+        try {
+            if (RingAcceptLoop(listener))
+                return;
+
+            Log::Warning("Multishot accept is not supported; falling back to accept()");
+        } catch (...) {
+            Log::Warning("Multishot accept failed; falling back to accept()");
+        }
+    }
+
     while (!_stop) {
         // block until a new connection is accepted
         int ret = ::accept(_listenerSockets[listener].GetNativeHandle(),
@@ -49,35 +88,14 @@ void Acceptor::AcceptLoop(int listener) {
                            reinterpret_cast<::socklen_t*>(AddressBufferSize()));
 
         if (ret > 0) {
-            std::unique_lock lock(_mutex);
-
-            auto ep = IPEndpoint(*reinterpret_cast<::sockaddr_in*>(AddressBuffer()));
-
-            _acceptedFds.push(std::make_pair(ret, std::move(ep)));
-
-            lock.unlock();
-
-            _semaphore->Increment();
-
-            Profiler::Record<SocketQueued>();
+            Queue(ret, IPEndpoint(*reinterpret_cast<::sockaddr_in*>(AddressBuffer())));
         } else {
             if (_stop) {
                 // OK: we were supposed to stop
                 return;
             } else {
                 // Oops: something bad happened
-
-                auto ignored = {
-                    ECONNABORTED,
-                    EMFILE,
-                    ENFILE,
-                    ENOBUFS,
-                    ENOMEM,
-                    EPROTO,
-                    EPERM
-                };
-
-                if (std::find(begin(ignored), end(ignored), ret) == end(ignored)) {
+                if (!IsRecoverableAcceptError(errno)) {
                     _promiseException = std::make_exception_ptr(SystemError{});
                     _stop = true;
                     Log::Error("Socket server closed due to unrecoverable error");
@@ -90,6 +108,83 @@ void Acceptor::AcceptLoop(int listener) {
     }
 }
 
+// Returns false if the kernel turns out not to support multishot accept
+bool Acceptor::RingAcceptLoop(int listener) {
+    IoUring ring(0x10);
+    auto completions = std::vector<IoUring::Completion>();
+    auto accepted = false;
+
+    SubmitAccept(ring, listener);
+
+    while (!_stop) {
+        if (!ring.Wait(RingAcceptTimeout))
+            continue;
+
+        completions.clear();
+        ring.Reap(completions);
+
+        auto rearm = false;
+
+        for (auto& c : completions) {
+            // The kernel may end the request at
+            // will, so then it has to be resubmitted.
+            if (!(c.Flags & IORING_CQE_F_MORE))
+                rearm = true;
+
+            if (c.Result >= 0) {
+                accepted = true;
+
+                // The ring might have accepted it just as we stopped
+                if (_stop)
+                    ::close(c.Result);
+                else
+                    Queue(c.Result, std::nullopt);
+            } else if (_stop) {
+                // OK: the listener was closed as we stopped
+                return true;
+            } else if (c.Result == -EINVAL && !accepted) {
+                return false;
+            } else if (!IsRecoverableAcceptError(-c.Result)) {
+                errno = -c.Result;
+                _promiseException = std::make_exception_ptr(SystemError{});
+                _stop = true;
+                Log::Error("Socket server closed due to unrecoverable error");
+                return true;
+            }
+        }
+
+        if (rearm && !_stop)
+            SubmitAccept(ring, listener);
+    }
+
+    return true;
+}
+
+void Acceptor::SubmitAccept(IoUring& ring, int listener) {
+    // Each connection's remote address would overwrite the previous
+    // one before it was reaped, so none is asked for; it's looked up
+    // if and when it's needed.
+    auto& sqe = ring.GetSqe();
+    sqe.opcode = IORING_OP_ACCEPT;
+    sqe.fd = _listenerSockets[listener].GetNativeHandle();
+    sqe.accept_flags = SOCK_CLOEXEC;
+    sqe.ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe.user_data = 1;
+
+    ring.Submit();
+}
+
+void Acceptor::Queue(int fd, std::optional<IPEndpoint> remote) {
+    {
+        std::lock_guard lock(_mutex);
+        _acceptedFds.push(std::make_pair(fd, std::move(remote)));
+    }
+
+    _semaphore->Increment();
+
+    Profiler::Record<SocketQueued>();
+}
+
 void Acceptor::DispatchLoop() {
     auto onExit = CreateExitTrap([&] {
         // all work is done. notify future.
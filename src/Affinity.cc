@@ -0,0 +1,38 @@
+#include "Affinity.h"
+#include "SystemError.h"
+
+#include <pthread.h>
+#include <sched.h>
+
+namespace Chili {
+
+std::vector<int> GetAvailableCpus() {
+    ::cpu_set_t set;
+
+    if (-1 == ::sched_getaffinity(0, sizeof(set), &set))
+        throw SystemError{};
+
+    std::vector<int> cpus;
+
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+        if (CPU_ISSET(cpu, &set))
+            cpus.push_back(cpu);
+
+    return cpus;
+}
+
+void SetThreadAffinity(std::thread& thread, int cpu) {
+    if (cpu < 0)
+        return;
+
+    ::cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+
+    if (auto error = ::pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set)) {
+        errno = error;
+        throw SystemError{};
+    }
+}
+
+} // namespace Chili
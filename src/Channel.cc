@@ -97,7 +97,6 @@ void ChannelClosed::Accept(ProfileEventReader& reader) const {
 Channel::Channel(std::shared_ptr<FileStream> stream) :
     _id(nextChannelId++),
     _stream(std::move(stream)),
-    _request(_stream),
     _timeout(Clock::GetCurrentTime()),
     _stage(Stage::WaitReadable) {
     Log::Verbose("Channel {} created", _id);
@@ -105,16 +104,19 @@ Channel::Channel(std::shared_ptr<FileStream> stream) :
 
 void Channel::Initialize(const std::shared_ptr<Orchestrator>& o) {
     _orchestrator = o;
-
-    // shared_from_this() cannot be used during construction
-    // so this makes this initializing function necessary
-    _readyToWrite += [wc=std::weak_ptr<Channel>(shared_from_this())] {
-        if (auto c = wc.lock()) {
-            c->SetStage(Stage::Write);
-
-            if (auto o = c->_orchestrator.lock())
-                o->WakeUp();
-        }
+    _slab = o->_slab;
+    _arena = MonotonicArena(_slab);
+    _chunkSize = o->_chunkSize;
+    _maxChunkSize = o->_maxChunkSize;
+    _responseCache = o->_responseCache;
+    _request = Request(_stream, _slab);
+
+    // Responses only ever raise this signal while holding
+    // on to us, through a pointer aliasing our own, so we
+    // don't need to hold on to ourselves, and the callback
+    // is small enough not to allocate any memory.
+    _readyToWrite += [this] {
+        SetStage(Stage::Write);
     };
 }
 
@@ -144,6 +146,10 @@ Response& Channel::GetResponse() {
     return _response;
 }
 
+MonotonicArena& Channel::GetArena() {
+    return _arena;
+}
+
 void Channel::FetchContent(std::function<void()> callback) {
     _fetchContentCallback = std::move(callback);
 
@@ -159,54 +165,63 @@ void Channel::FetchContent(std::function<void()> callback) {
     // they would normally want to server to
     // formally agree to it by issuing a "you
     // may continue" intermediate response.
-    std::string value;
+    std::string_view value;
 
-    if (_request.GetHeader("Expect", &value)) {
+    if (_request.GetHeader(Header::Expect, &value)) {
         // Ok, look, it does want us to send
         // it our confirmation. Let's do it.
         if (value == "100-continue") {
             ResetResponse();
             _response.SetStatus(Status::Continue);
-            _stage = Stage::Write;
+            SetStage(Stage::Write);
         }
     } else {
         // It doesn't need our confirmation!
         // Ok, just go straight to reading.
-        _stage = Stage::Read;
+        SetStage(Stage::Read);
     }
+}
+
+void Channel::StreamContent(std::function<void(std::string_view)> onData, std::function<void()> callback) {
+    _request.SetContentSink(std::move(onData));
+    FetchContent(std::move(callback));
+}
 
-    if (auto o = _orchestrator.lock())
-        o->WakeUp();
+void Channel::SpliceContent(std::shared_ptr<FileStream> file,
+                            std::function<void()> callback,
+                            std::function<void(std::size_t)> onProgress) {
+    _request.SetContentFile(std::move(file));
+    _contentProgressCallback = std::move(onProgress);
+    FetchContent(std::move(callback));
 }
 
 void Channel::RejectContent() {
-    std::string value;
+    std::string_view value;
 
-    if (_request.GetHeader("Expect", &value)) {
+    if (_request.GetHeader(Header::Expect, &value)) {
         // Tough luck client, your request
         // body has been rejected.
         if (value == "100-continue") {
             ResetResponse();
             _response.CloseConnection();
             _response.SetStatus(Status::ExpectationFailed);
-            _stage = Stage::Write;
+            SetStage(Stage::Write);
         }
     } else {
         Close();
-    }
 
-    if (auto o = _orchestrator.lock())
-        o->WakeUp();
+        // Nothing left to do but be garbage-collected
+        _readyToAdvance();
+    }
 }
 
 void Channel::SendResponse() {
     if (!_response.IsPrepared())
         throw std::logic_error("Response has not been fully prepared");
 
-    _stage = Stage::Write;
-
-    if (auto o = _orchestrator.lock())
-        o->WakeUp();
+    CacheResponse();
+    AnswerConditionalRequest();
+    SetStage(Stage::Write);
 }
 
 bool Channel::IsReadThrottled() const {
@@ -260,16 +275,20 @@ Channel::Stage Channel::GetDefiniteStage() const {
 }
 
 void Channel::SetStage(Stage s) {
-    std::lock_guard lock(_setStageMutex);
+    {
+        std::lock_guard lock(_setStageMutex);
+
+        auto previous = _stage.exchange(s);
 
-    auto previous = _stage.exchange(s);
+        if (previous == Stage::Closed)
+            _stage = Stage::Closed;
+    }
 
-    if (previous == Stage::Closed)
-        _stage = Stage::Closed;
+    _readyToAdvance();
 }
 
 Clock::TimePoint Channel::GetRequestedTimeout() const {
-    return _timeout.GetCopy();
+    return _timeout.load();
 }
 
 bool Channel::IsReady() const {
@@ -314,16 +333,26 @@ void Channel::OnRead() {
         Log::Verbose("Channel {} throttled. Waiting for read quota to fill.", _id);
         RecordReadTimeoutEvent(throttlingInfo.fillTime);
         _stage = Stage::ReadTimeout;
-        _timeout.Set(throttlingInfo.fillTime);
+        _timeout = throttlingInfo.fillTime;
         return;
     }
 
     bool doneReading;
+    auto readingHeader = !_fetchingContent;
 
     if (_fetchingContent) {
         // We're fetching more content from the request
-        if ((doneReading = FetchData(&Request::ConsumeContent, throttlingInfo.currentQuota)))
+        auto consumedContentLength = _request.GetConsumedContentLength();
+
+        doneReading = FetchData(&Request::ConsumeContent, throttlingInfo.currentQuota);
+
+        if (_contentProgressCallback && _request.GetConsumedContentLength() != consumedContentLength)
+            _contentProgressCallback(_request.GetConsumedContentLength());
+
+        if (doneReading) {
             _fetchingContent = false;
+            _contentProgressCallback = {};
+        }
     } else {
         // We're fetching the request's header
         if ((doneReading = FetchData(&Request::ConsumeHeader, throttlingInfo.currentQuota))) {
@@ -341,6 +370,11 @@ void Channel::OnRead() {
         if (!_request.KeepAlive())
             _response.CloseConnection();
 
+        if (readingHeader && UseCachedResponse()) {
+            _stage = Stage::Write;
+            return;
+        }
+
         // Ready to process
         OnProcess();
     }
@@ -381,17 +415,168 @@ bool Channel::FetchData(bool(Request::*func)(std::size_t, std::size_t&), std::si
             auto fillTime = GetThrottlingInfo(_throttlers.Read).fillTime;
             RecordReadTimeoutEvent(fillTime);
             _stage = Stage::ReadTimeout;
-            _timeout.Set(fillTime);
+            _timeout = fillTime;
         }
     }
 
     return done;
 }
 
+bool Channel::CanQueueResponse() const {
+    return !_forceClose &&
+           !_fetchingContent &&
+           _queuedResponses.size() < MaxQueuedResponses &&
+           _response.GetKeepAlive() &&
+           _response.IsBuffered() &&
+           _request.HasPipelinedHeader();
+}
+
+void Channel::QueueResponse() {
+    Log::Verbose("Channel {} queued response to pipelined request", _id);
+
+    // The arena isn't reset, as the queued
+    // response still keeps its header there.
+    _queuedResponses.push_back(std::move(_response));
+    ResetResponse();
+    _request.Reset();
+    _stage = Stage::Read;
+}
+
+bool Channel::FlushQueuedResponses(std::size_t maxWrite) {
+    std::size_t bytesFlushed = 0;
+
+    auto alwaysConsume = CreateExitTrap([&] {
+        _throttlers.Write.Dedicated.Consume(bytesFlushed);
+        _throttlers.Write.Master->Consume(bytesFlushed);
+    });
+
+    // Send the queued responses, along with
+    // the current one if possible, all at once.
+    auto vec = std::vector<std::pair<const void*, std::size_t>>();
+    auto quota = maxWrite;
+
+    vec.reserve(2 * (_queuedResponses.size() + 1));
+
+    for (auto& r : _queuedResponses)
+        quota -= r.GatherData(vec, quota);
+
+    auto includesCurrent = _response.IsBuffered();
+
+    if (includesCurrent)
+        quota -= _response.GatherData(vec, quota);
+
+    auto bytesAttempted = maxWrite - quota;
+
+    bytesFlushed = _stream->WriteVector(std::move(vec));
+
+    auto bytesRemaining = bytesFlushed;
+
+    while (!_queuedResponses.empty()) {
+        bytesRemaining -= _queuedResponses.front().ConsumeData(bytesRemaining);
+
+        if (!_queuedResponses.front().IsFlushed())
+            break;
+
+        _queuedResponses.pop_front();
+    }
+
+    if (_queuedResponses.empty()) {
+        if (!includesCurrent) {
+            // The current response is streamed, so it
+            // has to be sent separately from now on.
+            _stage = Stage::Write;
+            return false;
+        }
+
+        _response.ConsumeData(bytesRemaining);
+
+        if (_response.IsFlushed())
+            return true;
+    }
+
+    if (bytesFlushed < bytesAttempted) {
+        Log::Verbose("Channel {} socket buffer full. Waiting for writability.", _id);
+        RecordProfileEvent<ChannelWaitWritable>();
+        _stage = Stage::WaitWritable;
+    } else {
+        Log::Verbose("Channel {} throttled. Waiting for write quota to fill.", _id);
+        auto fillTime = GetThrottlingInfo(_throttlers.Write).fillTime;
+        RecordWriteTimeoutEvent(fillTime);
+        _stage = Stage::WriteTimeout;
+        _timeout = fillTime;
+    }
+
+    return false;
+}
+
+bool Channel::IsCacheable() const {
+    auto method = _request.GetMethod();
+
+    return _responseCache &&
+           (method == Method::Get || method == Method::Head) &&
+           !_request.HasContent();
+}
+
+bool Channel::UseCachedResponse() {
+    if (!IsCacheable())
+        return false;
+
+    auto cached = _responseCache->Find(_request);
+
+    if (!cached)
+        return false;
+
+    Log::Verbose("Channel {} answered from response cache", _id);
+
+    // Cached content is compressed once per coding,
+    // and then sent to whoever accepts that coding.
+    std::string_view acceptEncoding;
+
+    if (_request.GetHeader(Header::AcceptEncoding, &acceptEncoding))
+        _response.SetCompression(Compressor::Negotiate(acceptEncoding));
+
+    _response.UseCached(std::move(cached));
+    AnswerConditionalRequest();
+
+    return true;
+}
+
+void Channel::CacheResponse() {
+    if (!IsCacheable() ||
+        _response.GetCacheTtl().count() <= 0 ||
+        !_response.IsBuffered())
+        return;
+
+    std::string_view vary;
+    _response.GetHeader("Vary", &vary);
+
+    _responseCache->Insert(_request, _response.Cache(), _response.GetCacheTtl(), vary);
+}
+
+void Channel::AnswerConditionalRequest() {
+    auto method = _request.GetMethod();
+
+    if ((method != Method::Get && method != Method::Head) ||
+        _response.GetStatus() != Status::Ok)
+        return;
+
+    std::string_view ifNoneMatch;
+    std::string_view ifModifiedSince;
+
+    auto isConditional = _request.GetHeader(Header::IfNoneMatch, &ifNoneMatch);
+    isConditional = _request.GetHeader(Header::IfModifiedSince, &ifModifiedSince) || isConditional;
+
+    if (isConditional && _response.IsNotModified(ifNoneMatch, ifModifiedSince)) {
+        Log::Verbose("Channel {} response not modified", _id);
+        _response.SetNotModified();
+    }
+}
+
 void Channel::ResetResponse() {
     auto signal = std::shared_ptr<Signal<>>(shared_from_this(), &_readyToWrite);
     auto weak = std::weak_ptr<Signal<>>(signal);
-    _response = Response(_stream, weak);
+    _response = Response(_stream, weak, _slab, &_arena);
+    _response.SetChunkSize(_chunkSize, _maxChunkSize);
 }
 
 void Channel::OnProcess() {
@@ -401,13 +586,6 @@ void Channel::OnProcess() {
         if (_autoFetchContent && _request.HasContent() && !_request.IsContentAvailable()) {
             // Channel was configured so that we'll automatically get all of
             // the content for it before asking it to process anything.
-
-            { // FIXME: For now we don't support chunked requests
-                if (_request.HasHeader("Transfer-Encoding"))
-                    if (_request.GetHeader("Transfer-Encoding").find("chunked") != std::string::npos)
-                        return SendInternalError();
-            }
-
             // So let's get the content
             FetchContent(nullptr);
         } else {
@@ -449,11 +627,23 @@ void Channel::OnWrite() {
         Log::Verbose("Channel {} throttled. Waiting for write quota to fill.", _id);
         RecordWriteTimeoutEvent(throttlingInfo.fillTime);
         _stage = Stage::WriteTimeout;
-        _timeout.Set(throttlingInfo.fillTime);
+        _timeout = throttlingInfo.fillTime;
+        return;
+    }
+
+    // If the client has already sent the header of its
+    // next request, hold on to this response, and go on to
+    // process that one, so that the responses are all sent
+    // together. A partial header might only be completed
+    // once the client gets this response, so it's sent now.
+    if (CanQueueResponse()) {
+        QueueResponse();
         return;
     }
 
-    bool doneFlushing = FlushData(throttlingInfo.currentQuota);
+    bool doneFlushing = _queuedResponses.empty()
+        ? FlushData(throttlingInfo.currentQuota)
+        : FlushQueuedResponses(throttlingInfo.currentQuota);
 
     if (!doneFlushing)
         return;
@@ -470,7 +660,9 @@ void Channel::OnWrite() {
         _stage = Stage::Read;
     } else if (_response.GetKeepAlive()) {
         Log::Verbose("Channel {} sent response and keeps alive", _id);
-        _request = Request(_stream);
+        ResetResponse();
+        _arena.Reset();
+        _request.Reset();
         _fetchingContent = false; // Will be reading a new request header
         _stage = Stage::Read;
     } else {
@@ -499,7 +691,7 @@ bool Channel::FlushData(std::size_t maxWrite) {
             auto fillTime = GetThrottlingInfo(_throttlers.Write).fillTime;
             RecordWriteTimeoutEvent(fillTime);
             _stage = Stage::WriteTimeout;
-            _timeout.Set(fillTime);
+            _timeout = fillTime;
             return false;
         };
 
@@ -533,9 +725,10 @@ void Channel::Close() {
 
     Log::Verbose("Channel {} closed", _id);
 
-    _timeout.Set(Clock::GetCurrentTime());
+    _timeout = Clock::GetCurrentTime();
     _request = Request();
     _response = Response();
+    _queuedResponses.clear();
     _stream.reset();
     RecordProfileEvent<ChannelClosed>();
     _stage = Stage::Closed;
@@ -5,33 +5,43 @@ namespace Chili {
 std::shared_ptr<ChannelFactory> ChannelFactory::Create(ChannelProcessCallback process) {
     class CustomChannel : public Channel {
     public:
-        CustomChannel(std::shared_ptr<FileStream> fs, ChannelProcessCallback process)
+        CustomChannel(std::shared_ptr<FileStream> fs, std::shared_ptr<const ChannelProcessCallback> process)
             : Channel(std::move(fs))
             , _process(std::move(process)) {}
 
         void Process() override {
-            _process(*this);
+            (*_process)(*this);
         }
 
     private:
-        ChannelProcessCallback _process;
+        // Shared rather than copied, since copying
+        // the callback may well allocate memory.
+        std::shared_ptr<const ChannelProcessCallback> _process;
     };
 
     class CustomFactory : public ChannelFactory {
     public:
         CustomFactory(ChannelProcessCallback process)
-            : _process(std::move(process)) {}
+            : _process(std::make_shared<const ChannelProcessCallback>(std::move(process))) {}
 
         std::shared_ptr<Channel> CreateChannel(std::shared_ptr<FileStream> fs) override {
             return std::make_shared<CustomChannel>(std::move(fs), _process);
         }
 
+        std::shared_ptr<Channel> CreateChannel(std::shared_ptr<FileStream> fs, const SlabAllocator<Channel>& allocator) override {
+            return std::allocate_shared<CustomChannel>(SlabAllocator<CustomChannel>(allocator), std::move(fs), _process);
+        }
+
     private:
-        ChannelProcessCallback _process;
+        std::shared_ptr<const ChannelProcessCallback> _process;
     };
 
     return std::make_shared<CustomFactory>(std::move(process));
 }
 
+std::shared_ptr<Channel> ChannelFactory::CreateChannel(std::shared_ptr<FileStream> fs, const SlabAllocator<Channel>&) {
+    return CreateChannel(std::move(fs));
+}
+
 } // namespace Chili
 
@@ -0,0 +1,167 @@
+#include "ChunkedDecoder.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace Chili {
+
+namespace {
+
+constexpr std::size_t MaxExtensionLength = 0x400;
+constexpr std::size_t MaxTrailerLength = 0x2000;
+
+int GetHexValue(char c) {
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    else if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    else if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    else
+        return -1;
+}
+
+void Expect(char c, char expected) {
+    if (c != expected)
+        throw std::runtime_error("Invalid chunk framing");
+}
+
+} // unnamed namespace
+
+std::size_t ChunkedDecoder::Decode(const char* data, std::size_t size, std::string_view& chunkData) {
+    chunkData = {};
+
+    auto p = data;
+    auto end = data + size;
+
+    while (p != end && _state != State::Done) {
+        if (_state == State::Data) {
+            auto length = std::min<std::uint64_t>(_chunkSize, end - p);
+
+            chunkData = std::string_view(p, length);
+            SkipData(length);
+
+            return p + length - data;
+        }
+
+        auto c = *p++;
+
+        switch (_state) {
+            case State::Size: {
+                if (auto value = GetHexValue(c); value >= 0) {
+                    if (_chunkSize >> 60)
+                        throw std::runtime_error("Chunk too big");
+
+                    _chunkSize = (_chunkSize << 4) | value;
+                    ++_sizeDigits;
+                } else {
+                    if (!_sizeDigits)
+                        throw std::runtime_error("Invalid chunk size");
+
+                    if (c == '\r')
+                        _state = State::SizeLf;
+                    else if (c == ';' || c == ' ' || c == '\t')
+                        _state = State::Extension;
+                    else
+                        throw std::runtime_error("Invalid chunk size");
+                }
+
+                break;
+            }
+
+            case State::Extension: {
+                if (c == '\r')
+                    _state = State::SizeLf;
+                else if (++_lineLength > MaxExtensionLength)
+                    throw std::runtime_error("Chunk extension too long");
+
+                break;
+            }
+
+            case State::SizeLf: {
+                Expect(c, '\n');
+                _sizeDigits = 0;
+                _lineLength = 0;
+                _state = _chunkSize ? State::Data : State::Trailer;
+                break;
+            }
+
+            case State::DataCr: {
+                Expect(c, '\r');
+                _state = State::DataLf;
+                break;
+            }
+
+            case State::DataLf: {
+                Expect(c, '\n');
+                _state = State::Size;
+                break;
+            }
+
+            case State::Trailer: {
+                if (c == '\r') {
+                    _state = State::FinalLf;
+                    break;
+                }
+
+                _state = State::TrailerLine;
+                [[fallthrough]];
+            }
+
+            case State::TrailerLine: {
+                if (++_trailerLength > MaxTrailerLength)
+                    throw std::runtime_error("Chunked trailer too long");
+
+                if (c == '\r')
+                    _state = State::TrailerLf;
+
+                break;
+            }
+
+            case State::TrailerLf: {
+                Expect(c, '\n');
+                _state = State::Trailer;
+                break;
+            }
+
+            case State::FinalLf: {
+                Expect(c, '\n');
+                _state = State::Done;
+                break;
+            }
+
+            default:
+                break;
+        }
+    }
+
+    return p - data;
+}
+
+std::uint64_t ChunkedDecoder::GetDataRemaining() const {
+    return _state == State::Data ? _chunkSize : 0;
+}
+
+void ChunkedDecoder::SkipData(std::uint64_t size) {
+    if (!size)
+        return;
+
+    if (size > GetDataRemaining())
+        throw std::logic_error("Skipped past end of chunk data");
+
+    _chunkSize -= size;
+
+    if (!_chunkSize)
+        _state = State::DataCr;
+}
+
+bool ChunkedDecoder::IsDone() const {
+    return _state == State::Done;
+}
+
+void ChunkedDecoder::Reset() {
+    *this = {};
+}
+
+} // namespace Chili
+
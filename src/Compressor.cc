@@ -0,0 +1,150 @@
+#include "Compressor.h"
+#include "StringUtils.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <zlib.h>
+
+namespace Chili {
+
+namespace {
+
+/**
+ * Parses a quality value, as in "q=0.5",
+ * into thousandths, from 0 to 1000.
+ */
+int ParseQuality(std::string_view value) {
+    if (value.empty() || (value[0] != '0' && value[0] != '1'))
+        return 0;
+
+    auto quality = (value[0] - '0') * 1000;
+    auto scale = 100;
+
+    if (value.size() > 1 && value[1] == '.') {
+        for (std::size_t i = 2; i < value.size() && i < 5; ++i) {
+            if (value[i] < '0' || value[i] > '9')
+                break;
+
+            quality += (value[i] - '0') * scale;
+            scale /= 10;
+        }
+    }
+
+    return std::min(quality, 1000);
+}
+
+} // unnamed namespace
+
+Compressor::Compressor(Compression compression) :
+    _stream(std::make_unique<z_stream_s>()) {
+    int windowBits;
+
+    switch (compression) {
+        case Compression::Deflate:
+            windowBits = MAX_WBITS;
+            break;
+
+        case Compression::Gzip:
+            windowBits = MAX_WBITS + 16;
+            break;
+
+        default:
+            throw std::logic_error("Invalid compression");
+    }
+
+    if (::deflateInit2(_stream.get(), Z_DEFAULT_COMPRESSION, Z_DEFLATED, windowBits, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+        throw std::runtime_error("deflateInit2() failed");
+}
+
+Compressor::~Compressor() {
+    ::deflateEnd(_stream.get());
+}
+
+void Compressor::Compress(std::string_view input, std::vector<char>& output, bool finish) {
+    // Flushing nothing would only produce an empty block
+    if (input.empty() && !finish)
+        return;
+
+    auto& stream = *_stream;
+    auto flush = finish ? Z_FINISH : Z_SYNC_FLUSH;
+
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input.data()));
+    stream.avail_in = static_cast<uInt>(input.size());
+
+    for (;;) {
+        auto position = output.size();
+        auto space = ::deflateBound(&stream, stream.avail_in) + 0x10;
+
+        output.resize(position + space);
+        stream.next_out = reinterpret_cast<Bytef*>(output.data() + position);
+        stream.avail_out = static_cast<uInt>(space);
+
+        auto result = ::deflate(&stream, flush);
+
+        output.resize(output.size() - stream.avail_out);
+
+        if (result != Z_OK && result != Z_STREAM_END && result != Z_BUF_ERROR)
+            throw std::runtime_error("deflate() failed");
+
+        // Flushing is only done once zlib had room to spare
+        if (finish ? result == Z_STREAM_END : stream.avail_out > 0)
+            break;
+    }
+}
+
+Compression Compressor::Negotiate(std::string_view acceptEncoding) {
+    auto gzip = -1;
+    auto deflate = -1;
+    auto any = -1;
+
+    while (!acceptEncoding.empty()) {
+        auto element = PopListElement(acceptEncoding);
+        auto coding = PopListElement(element, ';');
+        auto quality = 1000;
+
+        // Look for the quality among the parameters
+        while (!element.empty()) {
+            auto parameter = PopListElement(element, ';');
+
+            if (parameter.size() > 2 && (parameter[0] == 'q' || parameter[0] == 'Q') && parameter[1] == '=')
+                quality = ParseQuality(parameter.substr(2));
+        }
+
+        if (EqualsIgnoreCase(coding, "gzip") || EqualsIgnoreCase(coding, "x-gzip"))
+            gzip = quality;
+        else if (EqualsIgnoreCase(coding, "deflate"))
+            deflate = quality;
+        else if (coding == "*")
+            any = quality;
+
+    }
+
+    // Codings that aren't listed are as good as "*"
+    if (gzip < 0)
+        gzip = any;
+
+    if (deflate < 0)
+        deflate = any;
+
+    if (gzip > 0 && gzip >= deflate)
+        return Compression::Gzip;
+    else if (deflate > 0)
+        return Compression::Deflate;
+    else
+        return Compression::None;
+}
+
+std::string_view Compressor::GetName(Compression compression) {
+    switch (compression) {
+        case Compression::Deflate:
+            return "deflate";
+
+        case Compression::Gzip:
+            return "gzip";
+
+        default:
+            return "identity";
+    }
+}
+
+} // namespace Chili
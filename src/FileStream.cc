@@ -4,6 +4,7 @@
 #include "Timeout.h"
 
 #include <fcntl.h>
+#include <stdexcept>
 #include <poll.h>
 #include <sys/sendfile.h>
 #include <sys/stat.h>
@@ -145,6 +146,19 @@ std::size_t FileStream::Read(void* buffer, std::size_t maxBytes) {
     return result;
 }
 
+std::size_t FileStream::ReadAt(void* buffer, std::size_t maxBytes, std::uint64_t offset) {
+    auto result = ::pread(_nativeHandle, buffer, maxBytes, offset);
+
+    if (result == -1) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK)
+            return 0;
+        else
+            throw SystemError{};
+    }
+
+    return result;
+}
+
 std::size_t FileStream::Read(void* buffer, std::size_t maxBytes, std::chrono::milliseconds timeout) {
     struct pollfd pfd;
     pfd.fd = _nativeHandle;
@@ -202,6 +216,48 @@ std::size_t FileStream::WriteTo(FileStream& fs, std::size_t maxBytes) {
     return result;
 }
 
+std::size_t FileStream::WriteTo(FileStream& fs, std::size_t maxBytes, std::uint64_t& offset) {
+    ::off_t position = offset;
+    ::ssize_t result = ::sendfile(fs._nativeHandle,
+                                  _nativeHandle,
+                                  &position,
+                                  maxBytes);
+
+    if (result == -1) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK)
+            return 0;
+        else
+            throw SystemError{};
+    }
+
+    // Nothing left to send means the file got
+    // shorter than we were told it would be.
+    if (result == 0 && maxBytes > 0)
+        throw std::runtime_error("File ended before all of its content was sent");
+
+    offset = position;
+
+    return result;
+}
+
+std::uint64_t FileStream::GetSize() const {
+    struct ::stat st;
+
+    if (-1 == ::fstat(_nativeHandle, &st))
+        throw SystemError{};
+
+    return st.st_size;
+}
+
+std::time_t FileStream::GetModificationTime() const {
+    struct ::stat st;
+
+    if (-1 == ::fstat(_nativeHandle, &st))
+        throw SystemError{};
+
+    return st.st_mtime;
+}
+
 void FileStream::Close() {
     if (_nativeHandle != InvalidHandle)
         if (-1 == ::close(_nativeHandle))
@@ -0,0 +1,179 @@
+#include "HeaderIndex.h"
+#include "StringUtils.h"
+
+namespace Chili {
+
+namespace {
+
+// Indices must correspond to the Header enum
+constexpr std::string_view knownHeaderNames[] = {
+    "Accept",
+    "Accept-Charset",
+    "Accept-Encoding",
+    "Accept-Language",
+    "Authorization",
+    "Cache-Control",
+    "Connection",
+    "Content-Encoding",
+    "Content-Length",
+    "Content-Type",
+    "Cookie",
+    "Date",
+    "Expect",
+    "Host",
+    "If-Match",
+    "If-Modified-Since",
+    "If-None-Match",
+    "If-Range",
+    "If-Unmodified-Since",
+    "Origin",
+    "Pragma",
+    "Range",
+    "Referer",
+    "Transfer-Encoding",
+    "Upgrade",
+    "User-Agent"
+};
+
+static_assert(std::size(knownHeaderNames) == static_cast<std::size_t>(Header::Unknown));
+
+constexpr std::size_t PerfectHashSlots = 0x40;
+
+constexpr unsigned char ToLower(char c) {
+    return (c >= 'A' && c <= 'Z') ? c - 'A' + 'a' : c;
+}
+
+/**
+ * The coefficients were picked so that no two known headers
+ * share a slot. If you add a header and the static assertion
+ * below fails, pick others.
+ */
+constexpr std::size_t PerfectHash(std::string_view name) {
+    return (ToLower(name.front()) + ToLower(name.back()) * 10 + name.size() * 23) % PerfectHashSlots;
+}
+
+constexpr auto MakePerfectHashTable() {
+    // Headers are kept off by one, so that 0 means none
+    std::array<std::uint8_t, PerfectHashSlots> table{};
+
+    for (std::size_t i = 0; i < std::size(knownHeaderNames); ++i)
+        table[PerfectHash(knownHeaderNames[i])] = i + 1;
+
+    return table;
+}
+
+constexpr bool IsPerfect(const std::array<std::uint8_t, PerfectHashSlots>& table) {
+    std::size_t used = 0;
+
+    for (auto slot : table)
+        if (slot)
+            ++used;
+
+    return used == std::size(knownHeaderNames);
+}
+
+constexpr auto perfectHashTable = MakePerfectHashTable();
+
+static_assert(IsPerfect(perfectHashTable), "Known header names collide");
+
+std::size_t CaseInsensitiveHash(std::string_view name) {
+    std::size_t hash = 0xcbf29ce484222325;
+
+    for (auto c : name)
+        hash = (hash ^ ToLower(c)) * 0x100000001b3;
+
+    return hash;
+}
+
+} // unnamed namespace
+
+Header HeaderIndex::GetKnownHeader(std::string_view name) {
+    if (name.empty())
+        return Header::Unknown;
+
+    auto slot = perfectHashTable[PerfectHash(name)];
+
+    if (slot && EqualsIgnoreCase(name, knownHeaderNames[slot - 1]))
+        return static_cast<Header>(slot - 1);
+
+    return Header::Unknown;
+}
+
+std::string_view HeaderIndex::GetName(Header h) {
+    return knownHeaderNames[static_cast<std::size_t>(h)];
+}
+
+void HeaderIndex::Clear() {
+    _known.fill(0);
+
+    if (_unknownCount)
+        _unknown.fill(0);
+
+    _unknownCount = 0;
+    _overflow = false;
+}
+
+void HeaderIndex::Add(std::string_view name, std::size_t position) {
+    auto known = GetKnownHeader(name);
+
+    if (known != Header::Unknown) {
+        auto& slot = _known[static_cast<std::size_t>(known)];
+
+        if (!slot)
+            slot = position + 1;
+
+        return;
+    }
+
+    if (_unknownCount == MaxUnknownHeaders) {
+        // Way too many headers, so from
+        // now on, just look for them.
+        _overflow = true;
+        return;
+    }
+
+    // Fields of the same name end up along the same
+    // probing sequence, in the order they were added,
+    // so the first one is always found first.
+    auto i = CaseInsensitiveHash(name) % UnknownSlots;
+
+    while (_unknown[i])
+        i = (i + 1) % UnknownSlots;
+
+    _unknown[i] = position + 1;
+    ++_unknownCount;
+}
+
+std::size_t HeaderIndex::Find(Header h) const {
+    if (h == Header::Unknown)
+        return npos;
+
+    return static_cast<std::size_t>(_known[static_cast<std::size_t>(h)]) - 1;
+}
+
+std::size_t HeaderIndex::Find(std::string_view name, const HeaderParser::FieldList& fields) const {
+    auto known = GetKnownHeader(name);
+
+    if (known != Header::Unknown)
+        return Find(known);
+
+    if (_overflow) {
+        for (std::size_t i = 0; i < fields.size(); ++i)
+            if (EqualsIgnoreCase(fields[i].first, name))
+                return i;
+
+        return npos;
+    }
+
+    for (auto i = CaseInsensitiveHash(name) % UnknownSlots; _unknown[i]; i = (i + 1) % UnknownSlots) {
+        auto position = _unknown[i] - 1u;
+
+        if (EqualsIgnoreCase(fields[position].first, name))
+            return position;
+    }
+
+    return npos;
+}
+
+} // namespace Chili
+
@@ -0,0 +1,399 @@
+#include "HeaderParser.h"
+#include "StringUtils.h"
+
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CHILI_HEADER_PARSER_X86
+#include <immintrin.h>
+#endif
+
+namespace Chili {
+
+struct HeaderParser::Scanner {
+    const char* (*FindEnd)(const char* begin, const char* end);
+    const char* (*FindNameEnd)(const char* begin, const char* end);
+    const char* (*FindUriEnd)(const char* begin, const char* end);
+    const char* (*FindValueEnd)(const char* begin, const char* end);
+};
+
+namespace {
+
+#ifdef CHILI_HEADER_PARSER_X86
+__attribute__((target("avx2")))
+inline __m256i Load(const char* p) {
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+}
+
+__attribute__((target("avx2")))
+inline __m256i LessOrEqual(__m256i v, char c) {
+    return _mm256_cmpeq_epi8(_mm256_min_epu8(v, _mm256_set1_epi8(c)), v);
+}
+
+__attribute__((target("avx2")))
+inline __m256i GreaterOrEqual(__m256i v, char c) {
+    return _mm256_cmpeq_epi8(_mm256_max_epu8(v, _mm256_set1_epi8(c)), v);
+}
+
+__attribute__((target("avx2")))
+inline __m256i Equal(__m256i v, char c) {
+    return _mm256_cmpeq_epi8(v, _mm256_set1_epi8(c));
+}
+#endif
+
+// Each set of delimiters is described once per instruction
+// set: as a predicate, as SSE4.2 character ranges, and as
+// an AVX2 comparison producing a mask of matching bytes.
+
+// Anything that may not be part of a token (roughly),
+// which is also how the method and field names end.
+struct NameDelimiters {
+    static constexpr char Ranges[16] = "\x00\x20::\x7f\xff";
+    static constexpr int RangesSize = 6;
+
+    static bool Contains(unsigned char c) {
+        return c <= 0x20 || c == ':' || c >= 0x7f;
+    }
+
+#ifdef CHILI_HEADER_PARSER_X86
+    __attribute__((target("avx2")))
+    static unsigned Match(const char* p) {
+        auto v = Load(p);
+        auto m = _mm256_or_si256(_mm256_or_si256(LessOrEqual(v, 0x20), Equal(v, ':')),
+                                 GreaterOrEqual(v, 0x7f));
+        return _mm256_movemask_epi8(m);
+    }
+#endif
+};
+
+struct UriDelimiters {
+    static constexpr char Ranges[16] = "\x00\x20\x7f\x7f";
+    static constexpr int RangesSize = 4;
+
+    static bool Contains(unsigned char c) {
+        return c <= 0x20 || c == 0x7f;
+    }
+
+#ifdef CHILI_HEADER_PARSER_X86
+    __attribute__((target("avx2")))
+    static unsigned Match(const char* p) {
+        auto v = Load(p);
+        auto m = _mm256_or_si256(LessOrEqual(v, 0x20), Equal(v, 0x7f));
+        return _mm256_movemask_epi8(m);
+    }
+#endif
+};
+
+// Control characters, except for horizontal tabs.
+// This includes the CR which ends the value.
+struct ValueDelimiters {
+    static constexpr char Ranges[16] = "\x00\x08\x0a\x1f\x7f\x7f";
+    static constexpr int RangesSize = 6;
+
+    static bool Contains(unsigned char c) {
+        return (c < 0x20 && c != '\t') || c == 0x7f;
+    }
+
+#ifdef CHILI_HEADER_PARSER_X86
+    __attribute__((target("avx2")))
+    static unsigned Match(const char* p) {
+        auto v = Load(p);
+        auto m = _mm256_or_si256(_mm256_andnot_si256(Equal(v, '\t'), LessOrEqual(v, 0x1f)),
+                                 Equal(v, 0x7f));
+        return _mm256_movemask_epi8(m);
+    }
+#endif
+};
+
+template <class Delimiters>
+const char* FindGeneric(const char* p, const char* end) {
+    while (p != end && !Delimiters::Contains(*p))
+        ++p;
+
+    return p;
+}
+
+const char* FindEndGeneric(const char* p, const char* end) {
+    while (end - p >= 4) {
+        auto cr = static_cast<const char*>(std::memchr(p, '\r', end - p - 3));
+
+        if (!cr)
+            return nullptr;
+
+        if (!std::memcmp(cr, "\r\n\r\n", 4))
+            return cr + 4;
+
+        p = cr + 1;
+    }
+
+    return nullptr;
+}
+
+#ifdef CHILI_HEADER_PARSER_X86
+template <class Delimiters>
+__attribute__((target("sse4.2")))
+const char* FindSse42(const char* p, const char* end) {
+    auto ranges = _mm_loadu_si128(reinterpret_cast<const __m128i*>(Delimiters::Ranges));
+
+    while (end - p >= 16) {
+        auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        auto i = _mm_cmpestri(ranges, Delimiters::RangesSize, v, 16,
+                              _SIDD_UBYTE_OPS | _SIDD_CMP_RANGES | _SIDD_LEAST_SIGNIFICANT);
+
+        if (i != 16)
+            return p + i;
+
+        p += 16;
+    }
+
+    return FindGeneric<Delimiters>(p, end);
+}
+
+__attribute__((target("sse4.2")))
+const char* FindEndSse42(const char* p, const char* end) {
+    auto needle = _mm_setr_epi8('\r', '\n', '\r', '\n', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+
+    while (end - p >= 16) {
+        auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        auto i = _mm_cmpestri(needle, 4, v, 16,
+                              _SIDD_UBYTE_OPS | _SIDD_CMP_EQUAL_ORDERED | _SIDD_LEAST_SIGNIFICANT);
+
+        if (i <= 12)
+            return p + i + 4;
+
+        // Either there's no match at all, or there's
+        // a partial one at the end of the block.
+        p += i;
+    }
+
+    return FindEndGeneric(p, end);
+}
+
+template <class Delimiters>
+__attribute__((target("avx2")))
+const char* FindAvx2(const char* p, const char* end) {
+    while (end - p >= 32) {
+        if (auto mask = Delimiters::Match(p))
+            return p + __builtin_ctz(mask);
+
+        p += 32;
+    }
+
+    return FindGeneric<Delimiters>(p, end);
+}
+
+__attribute__((target("avx2")))
+const char* FindEndAvx2(const char* p, const char* end) {
+    auto cr = _mm256_set1_epi8('\r');
+    auto lf = _mm256_set1_epi8('\n');
+
+    // Compare each position along with the 3 that follow it
+    while (end - p >= 35) {
+        auto m = _mm256_and_si256(
+            _mm256_and_si256(_mm256_cmpeq_epi8(Load(p), cr), _mm256_cmpeq_epi8(Load(p + 1), lf)),
+            _mm256_and_si256(_mm256_cmpeq_epi8(Load(p + 2), cr), _mm256_cmpeq_epi8(Load(p + 3), lf)));
+
+        if (auto mask = static_cast<unsigned>(_mm256_movemask_epi8(m)))
+            return p + __builtin_ctz(mask) + 4;
+
+        p += 32;
+    }
+
+    return FindEndGeneric(p, end);
+}
+#endif
+
+bool IsDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+// Chunked must be the final transfer coding, as
+// otherwise there's no telling where the body ends.
+bool IsChunked(std::string_view codings) {
+    auto comma = codings.rfind(',');
+    auto last = codings.substr(comma == std::string_view::npos ? 0 : comma + 1);
+
+    if (!HasToken(last, "chunked"))
+        throw std::runtime_error("Unsupported transfer coding");
+
+    return true;
+}
+
+std::uint64_t ParseContentLength(std::string_view value) {
+    if (value.empty())
+        throw std::runtime_error("Invalid Content-Length header");
+
+    std::uint64_t result = 0;
+
+    for (auto c : value) {
+        if (!IsDigit(c) || result > (UINT64_MAX - 9) / 10)
+            throw std::runtime_error("Invalid Content-Length header");
+
+        result = result * 10 + (c - '0');
+    }
+
+    return result;
+}
+
+} // unnamed namespace
+
+HeaderParser::InstructionSet HeaderParser::GetSupportedInstructionSet() {
+    static const auto supported = [] {
+#ifdef CHILI_HEADER_PARSER_X86
+        __builtin_cpu_init();
+
+        if (__builtin_cpu_supports("avx2"))
+            return InstructionSet::Avx2;
+
+        if (__builtin_cpu_supports("sse4.2"))
+            return InstructionSet::Sse42;
+#endif
+
+        return InstructionSet::Generic;
+    }();
+
+    return supported;
+}
+
+const HeaderParser::Scanner* HeaderParser::GetScanner(InstructionSet is) {
+    static const Scanner generic = {
+        FindEndGeneric,
+        FindGeneric<NameDelimiters>,
+        FindGeneric<UriDelimiters>,
+        FindGeneric<ValueDelimiters>
+    };
+
+#ifdef CHILI_HEADER_PARSER_X86
+    static const Scanner sse42 = {
+        FindEndSse42,
+        FindSse42<NameDelimiters>,
+        FindSse42<UriDelimiters>,
+        FindSse42<ValueDelimiters>
+    };
+
+    static const Scanner avx2 = {
+        FindEndAvx2,
+        FindAvx2<NameDelimiters>,
+        FindAvx2<UriDelimiters>,
+        FindAvx2<ValueDelimiters>
+    };
+
+    if (is == InstructionSet::Avx2)
+        return &avx2;
+
+    if (is == InstructionSet::Sse42)
+        return &sse42;
+#endif
+
+    return &generic;
+}
+
+HeaderParser::HeaderParser(InstructionSet is) :
+    _instructionSet(is),
+    _scanner(GetScanner(is)) {
+    if (is > GetSupportedInstructionSet())
+        throw std::logic_error("Instruction set not supported by CPU");
+}
+
+HeaderParser::InstructionSet HeaderParser::GetInstructionSet() const {
+    return _instructionSet;
+}
+
+const char* HeaderParser::FindEnd(const char* begin, const char* end) const {
+    return _scanner->FindEnd(begin, end);
+}
+
+HeaderParser::Result HeaderParser::Parse(std::string_view header, FieldList& fields) const {
+    auto p = header.data();
+    auto end = p + header.size();
+    Result result;
+
+    auto e = _scanner->FindNameEnd(p, end);
+
+    if (e == p || e == end || *e != ' ')
+        throw std::runtime_error("Invalid HTTP method");
+
+    result.Method = std::string_view(p, e - p);
+    p = e + 1;
+
+    e = _scanner->FindUriEnd(p, end);
+
+    if (e == p || e == end || *e != ' ')
+        throw std::runtime_error("Invalid request URI");
+
+    result.Uri = std::string_view(p, e - p);
+    p = e + 1;
+
+    if (end - p < 10 ||
+        std::memcmp(p, "HTTP/", 5) ||
+        !IsDigit(p[5]) || p[6] != '.' || !IsDigit(p[7]) ||
+        p[8] != '\r' || p[9] != '\n')
+        throw std::runtime_error("Invalid HTTP version");
+
+    result.VersionMajor = p[5] - '0';
+    result.VersionMinor = p[7] - '0';
+    result.KeepAlive = result.VersionMajor > 1 || (result.VersionMajor == 1 && result.VersionMinor > 0);
+    p += 10;
+
+    bool hasContentLength = false;
+
+    while (end - p >= 2 && !(p[0] == '\r' && p[1] == '\n')) {
+        e = _scanner->FindNameEnd(p, end);
+
+        if (e == p || e == end || *e != ':')
+            throw std::runtime_error("Invalid header field name");
+
+        auto name = std::string_view(p, e - p);
+
+        for (p = e + 1; p != end && IsWhitespace(*p); ++p)
+            ;
+
+        e = _scanner->FindValueEnd(p, end);
+
+        if (end - e < 2 || e[0] != '\r' || e[1] != '\n')
+            throw std::runtime_error("Invalid header field value");
+
+        auto valueEnd = e;
+
+        while (valueEnd != p && IsWhitespace(valueEnd[-1]))
+            --valueEnd;
+
+        auto value = std::string_view(p, valueEnd - p);
+
+        p = e + 2;
+
+        if (p != end && IsWhitespace(*p))
+            throw std::runtime_error("Folded header field values are not supported");
+
+        if (EqualsIgnoreCase(name, "Content-Length")) {
+            auto length = ParseContentLength(value);
+
+            if (hasContentLength && length != result.ContentLength)
+                throw std::runtime_error("Conflicting Content-Length headers");
+
+            result.ContentLength = length;
+            hasContentLength = true;
+        } else if (EqualsIgnoreCase(name, "Transfer-Encoding")) {
+            result.Chunked = IsChunked(value);
+        } else if (EqualsIgnoreCase(name, "Connection")) {
+            if (HasToken(value, "close"))
+                result.KeepAlive = false;
+            else if (HasToken(value, "keep-alive"))
+                result.KeepAlive = true;
+        }
+
+        fields.emplace_back(name, value);
+    }
+
+    if (end - p != 2)
+        throw std::runtime_error("Invalid end of header");
+
+    if (result.Chunked && hasContentLength)
+        throw std::runtime_error("Conflicting Content-Length and Transfer-Encoding headers");
+
+    return result;
+}
+
+} // namespace Chili
+
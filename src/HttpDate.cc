@@ -0,0 +1,178 @@
+#include "HttpDate.h"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <time.h>
+
+namespace Chili {
+
+namespace {
+
+const char dayNames[][4] = {"Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat"};
+const char monthNames[][4] = {"Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"};
+
+bool ReadDigits(const char* p, int digits, int& value) {
+    value = 0;
+
+    for (auto i = 0; i < digits; ++i) {
+        if (p[i] < '0' || p[i] > '9')
+            return false;
+
+        value = value * 10 + (p[i] - '0');
+    }
+
+    return true;
+}
+
+void WriteDigits(char* p, int value, int digits) {
+    for (auto i = digits - 1; i >= 0; --i) {
+        p[i] = '0' + value % 10;
+        value /= 10;
+    }
+}
+
+class DateBuffer {
+public:
+    DateBuffer() {
+        Update(::time(nullptr));
+    }
+
+    std::time_t Get(char* buffer) {
+        auto now = ::time(nullptr);
+
+        if (now != _time.load(std::memory_order_relaxed))
+            TryUpdate(now);
+
+        return Read(buffer);
+    }
+
+private:
+    static constexpr std::size_t Words = (HttpDate::Length + 7) / 8;
+
+    void TryUpdate(std::time_t now) {
+        // Only one thread needs to do it; the
+        // others can make do with the old date.
+        if (_updating.test_and_set(std::memory_order_acquire))
+            return;
+
+        if (now != _time.load(std::memory_order_relaxed))
+            Update(now);
+
+        _updating.clear(std::memory_order_release);
+    }
+
+    void Update(std::time_t now) {
+        std::array<std::uint64_t, Words> words{};
+        HttpDate::Format(now, reinterpret_cast<char*>(words.data()));
+
+        auto sequence = _sequence.load(std::memory_order_relaxed);
+        _sequence.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        for (std::size_t i = 0; i < Words; ++i)
+            _words[i].store(words[i], std::memory_order_relaxed);
+
+        _time.store(now, std::memory_order_relaxed);
+        _sequence.store(sequence + 2, std::memory_order_release);
+    }
+
+    std::time_t Read(char* buffer) const {
+        std::array<std::uint64_t, Words> words;
+        std::time_t time;
+
+        for (;;) {
+            auto sequence = _sequence.load(std::memory_order_acquire);
+
+            if (sequence & 1)
+                continue;
+
+            for (std::size_t i = 0; i < Words; ++i)
+                words[i] = _words[i].load(std::memory_order_relaxed);
+
+            time = _time.load(std::memory_order_relaxed);
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+
+            if (_sequence.load(std::memory_order_relaxed) == sequence)
+                break;
+        }
+
+        std::memcpy(buffer, words.data(), HttpDate::Length);
+
+        return time;
+    }
+
+    std::atomic<std::uint32_t> _sequence{0};
+    std::atomic<std::time_t> _time{0};
+    std::array<std::atomic<std::uint64_t>, Words> _words{};
+    std::atomic_flag _updating = ATOMIC_FLAG_INIT;
+};
+
+} // unnamed namespace
+
+std::time_t HttpDate::Get(char* buffer) {
+    static DateBuffer date;
+    return date.Get(buffer);
+}
+
+void HttpDate::Format(std::time_t t, char* buffer) {
+    struct tm tm;
+
+    if (!::gmtime_r(&t, &tm))
+        throw std::runtime_error("gmtime() failed");
+
+    // Not strftime(), which depends on the locale
+    std::memcpy(buffer, dayNames[tm.tm_wday], 3);
+    std::memcpy(buffer + 3, ", ", 2);
+    WriteDigits(buffer + 5, tm.tm_mday, 2);
+    buffer[7] = ' ';
+    std::memcpy(buffer + 8, monthNames[tm.tm_mon], 3);
+    buffer[11] = ' ';
+    WriteDigits(buffer + 12, tm.tm_year + 1900, 4);
+    buffer[16] = ' ';
+    WriteDigits(buffer + 17, tm.tm_hour, 2);
+    buffer[19] = ':';
+    WriteDigits(buffer + 20, tm.tm_min, 2);
+    buffer[22] = ':';
+    WriteDigits(buffer + 23, tm.tm_sec, 2);
+    std::memcpy(buffer + 25, " GMT", 4);
+}
+
+bool HttpDate::Parse(std::string_view date, std::time_t& result) {
+    if (date.size() != Length ||
+        date.substr(3, 2) != ", " ||
+        date[7] != ' ' ||
+        date[11] != ' ' ||
+        date[16] != ' ' ||
+        date[19] != ':' ||
+        date[22] != ':' ||
+        date.substr(25) != " GMT")
+        return false;
+
+    struct tm tm{};
+
+    tm.tm_mon = -1;
+
+    for (auto i = 0; i < 12; ++i) {
+        if (date.substr(8, 3) == monthNames[i])
+            tm.tm_mon = i;
+    }
+
+    if (tm.tm_mon < 0 ||
+        !ReadDigits(date.data() + 5, 2, tm.tm_mday) ||
+        !ReadDigits(date.data() + 12, 4, tm.tm_year) ||
+        !ReadDigits(date.data() + 17, 2, tm.tm_hour) ||
+        !ReadDigits(date.data() + 20, 2, tm.tm_min) ||
+        !ReadDigits(date.data() + 23, 2, tm.tm_sec))
+        return false;
+
+    tm.tm_year -= 1900;
+    result = ::timegm(&tm);
+
+    return result != -1;
+}
+
+} // namespace Chili
@@ -1,17 +1,47 @@
 #include "HttpServer.h"
+#include "Affinity.h"
+
+#include <algorithm>
 
 namespace Chili {
 
 HttpServer::HttpServer(const IPEndpoint& ep, std::shared_ptr<ChannelFactory> factory, int listeners) :
-    _tcpAcceptor(ep, listeners),
-    _orchestrator(Orchestrator::Create(std::move(factory), 8)) {
+    HttpServer(ep, std::move(factory), listeners, 1) {}
+
+HttpServer::HttpServer(const IPEndpoint& ep, std::shared_ptr<ChannelFactory> factory, int listeners, int shards, int threads, Poller::Backend backend) :
+    _tcpAcceptor(ep, listeners, backend) {
+    if (shards < 0)
+        throw std::logic_error("HttpServer shard count cannot be negative");
+
+    auto cpus = GetAvailableCpus();
+
+    if (shards == 0)
+        shards = static_cast<int>(cpus.size());
+
+    for (int i = 0; i < shards; ++i) {
+        auto shard = Orchestrator::Create(factory, threads, backend);
+
+        // Throttling applies to the server as a whole,
+        // no matter which shard is handling the channel.
+        if (!_shards.empty())
+            shard->ShareThrottlers(*_shards.front());
+
+        // A lone shard is free to use every CPU
+        if (shards > 1)
+            shard->SetAffinity(cpus[i % cpus.size()]);
+
+        _shards.push_back(std::move(shard));
+    }
+
     _tcpAcceptor.OnAccepted += [this](auto conn) {
         conn->SetBlocking(false);
-        _orchestrator->Add(std::move(conn));
+        PickShard().Add(std::move(conn));
     };
 
-    _orchestrator->OnStop += [this] { Stop(); };
-    _orchestrator->Start();
+    for (auto& shard : _shards) {
+        shard->OnStop += [this] { Stop(); };
+        shard->Start();
+    }
 }
 
 std::future<void> HttpServer::Start() {
@@ -23,16 +53,55 @@ void HttpServer::Stop() {
 }
 
 void HttpServer::ThrottleRead(Throttler t) {
-    _orchestrator->ThrottleRead(std::move(t));
+    // Throttlers are shared by all shards
+    _shards.front()->ThrottleRead(std::move(t));
 }
 
 void HttpServer::ThrottleWrite(Throttler t) {
-    _orchestrator->ThrottleWrite(std::move(t));
+    _shards.front()->ThrottleWrite(std::move(t));
 }
 
 void HttpServer::SetInactivityTimeout(std::chrono::milliseconds ms) {
-    _orchestrator->SetInactivityTimeout(std::move(ms));
+    for (auto& shard : _shards)
+        shard->SetInactivityTimeout(ms);
 }
 
-} // namespace Chili
+void HttpServer::SetChunkSize(std::size_t size, std::size_t maxSize) {
+    for (auto& shard : _shards)
+        shard->SetChunkSize(size, maxSize);
+}
 
+void HttpServer::SetResponseCache(std::shared_ptr<ResponseCache> cache) {
+    for (auto& shard : _shards)
+        shard->SetResponseCache(cache);
+}
+
+void HttpServer::SetInlineActivation(bool b) {
+    for (auto& shard : _shards)
+        shard->SetInlineActivation(b);
+}
+
+void HttpServer::SetShardingPolicy(ShardingPolicy policy) {
+    _shardingPolicy = policy;
+}
+
+Orchestrator& HttpServer::PickShard() {
+    if (_shards.size() == 1)
+        return *_shards.front();
+
+    switch (_shardingPolicy.load()) {
+        case ShardingPolicy::LeastLoaded: {
+            auto shard = std::min_element(begin(_shards), end(_shards), [](auto& a, auto& b) {
+                return a->GetChannelCount() < b->GetChannelCount();
+            });
+
+            return **shard;
+        }
+
+        case ShardingPolicy::RoundRobin:
+        default:
+            return *_shards[_nextShard++ % _shards.size()];
+    }
+}
+
+} // namespace Chili
@@ -0,0 +1,310 @@
+#include "IoUring.h"
+#include "ExitTrap.h"
+#include "SystemError.h"
+
+#include <linux/io_uring.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace Chili {
+
+namespace {
+
+int Setup(unsigned entries, ::io_uring_params* params) {
+    return static_cast<int>(::syscall(__NR_io_uring_setup, entries, params));
+}
+
+template <class T>
+T* Offset(void* base, std::uint32_t offset) {
+    return reinterpret_cast<T*>(static_cast<char*>(base) + offset);
+}
+
+unsigned LoadAcquire(const unsigned* p) {
+    return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+}
+
+void StoreRelease(unsigned* p, unsigned value) {
+    __atomic_store_n(p, value, __ATOMIC_RELEASE);
+}
+
+/**
+ * Waiting with a timeout needs IORING_FEAT_EXT_ARG (Linux 5.11),
+ * which the ring checks for itself, but multishot polls came later
+ * (Linux 5.13), and aren't advertised by any feature flag. Older
+ * kernels reject them, so one is tried out on a readable eventfd.
+ */
+bool ProbeMultishotPoll() {
+    try {
+        IoUring ring(2);
+
+        auto fd = ::eventfd(1, EFD_CLOEXEC);
+
+        if (fd == -1)
+            return false;
+
+        auto onExit = CreateExitTrap([&] { ::close(fd); });
+
+        auto& sqe = ring.GetSqe();
+        sqe.opcode = IORING_OP_POLL_ADD;
+        sqe.fd = fd;
+        sqe.poll32_events = POLLIN;
+        sqe.len = IORING_POLL_ADD_MULTI;
+        sqe.user_data = 1;
+
+        ring.Submit();
+
+        auto completions = std::vector<IoUring::Completion>();
+
+        if (!ring.Wait(std::chrono::seconds(1)) || !ring.Reap(completions))
+            return false;
+
+        auto& c = completions.front();
+
+        return c.Result > 0 && (c.Flags & IORING_CQE_F_MORE);
+    } catch (...) {
+        return false;
+    }
+}
+
+} // unnamed namespace
+
+bool IoUring::IsSupported() {
+    static const bool supported = ProbeMultishotPoll();
+    return supported;
+}
+
+IoUring::IoUring(unsigned entries) {
+    ::io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+
+    if (-1 == (_fd = Setup(entries, &params)))
+        throw SystemError{};
+
+    if (!(params.features & IORING_FEAT_EXT_ARG)) {
+        ::close(_fd);
+        throw std::runtime_error("io_uring is missing required kernel features");
+    }
+
+    _sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    _cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(::io_uring_cqe);
+
+    bool singleMap = params.features & IORING_FEAT_SINGLE_MMAP;
+
+    if (singleMap)
+        _sqRingSize = _cqRingSize = std::max(_sqRingSize, _cqRingSize);
+
+    _sqRing = ::mmap(nullptr, _sqRingSize, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_POPULATE, _fd, IORING_OFF_SQ_RING);
+
+    if (_sqRing == MAP_FAILED) {
+        ::close(_fd);
+        throw SystemError{};
+    }
+
+    if (singleMap) {
+        _cqRing = _sqRing;
+    } else {
+        _cqRing = ::mmap(nullptr, _cqRingSize, PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_POPULATE, _fd, IORING_OFF_CQ_RING);
+
+        if (_cqRing == MAP_FAILED) {
+            ::munmap(_sqRing, _sqRingSize);
+            ::close(_fd);
+            throw SystemError{};
+        }
+    }
+
+    _sqesSize = params.sq_entries * sizeof(::io_uring_sqe);
+
+    auto sqes = ::mmap(nullptr, _sqesSize, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE, _fd, IORING_OFF_SQES);
+
+    if (sqes == MAP_FAILED) {
+        if (!singleMap)
+            ::munmap(_cqRing, _cqRingSize);
+
+        ::munmap(_sqRing, _sqRingSize);
+        ::close(_fd);
+        throw SystemError{};
+    }
+
+    _sqes = static_cast<::io_uring_sqe*>(sqes);
+
+    _sqHead = Offset<unsigned>(_sqRing, params.sq_off.head);
+    _sqTail = Offset<unsigned>(_sqRing, params.sq_off.tail);
+    _sqMask = Offset<unsigned>(_sqRing, params.sq_off.ring_mask);
+    _sqArray = Offset<unsigned>(_sqRing, params.sq_off.array);
+    _sqEntries = params.sq_entries;
+
+    _cqHead = Offset<unsigned>(_cqRing, params.cq_off.head);
+    _cqTail = Offset<unsigned>(_cqRing, params.cq_off.tail);
+    _cqMask = Offset<unsigned>(_cqRing, params.cq_off.ring_mask);
+    _cqes = Offset<::io_uring_cqe>(_cqRing, params.cq_off.cqes);
+}
+
+IoUring::~IoUring() {
+    ::munmap(_sqes, _sqesSize);
+
+    if (_cqRing != _sqRing)
+        ::munmap(_cqRing, _cqRingSize);
+
+    ::munmap(_sqRing, _sqRingSize);
+    ::close(_fd);
+
+    if (_bufferRing)
+        ::munmap(_bufferRing, _bufferRingSize);
+}
+
+::io_uring_sqe& IoUring::GetSqe() {
+    auto tail = *_sqTail;
+
+    if (tail - LoadAcquire(_sqHead) == _sqEntries) {
+        Submit();
+        tail = *_sqTail;
+    }
+
+    auto index = tail & *_sqMask;
+    auto& sqe = _sqes[index];
+
+    std::memset(&sqe, 0, sizeof(sqe));
+    _sqArray[index] = index;
+
+    StoreRelease(_sqTail, tail + 1);
+    ++_sqPending;
+
+    return sqe;
+}
+
+void IoUring::Submit() {
+    while (_sqPending) {
+        auto submitted = Enter(_sqPending, 0, 0, nullptr, 0);
+
+        if (submitted == -1) {
+            if (errno == EINTR || errno == EAGAIN || errno == EBUSY)
+                continue;
+
+            throw SystemError{};
+        }
+
+        _sqPending -= submitted;
+    }
+}
+
+bool IoUring::Wait(std::chrono::milliseconds timeout) {
+    if (LoadAcquire(_cqTail) != *_cqHead)
+        return true;
+
+    ::__kernel_timespec ts;
+    ts.tv_sec = timeout.count() / 1000;
+    ts.tv_nsec = (timeout.count() % 1000) * 1000000;
+
+    ::io_uring_getevents_arg arg;
+    std::memset(&arg, 0, sizeof(arg));
+    arg.sigmask_sz = _NSIG / 8;
+    arg.ts = reinterpret_cast<std::uint64_t>(&ts);
+
+    auto flags = IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG;
+
+    if (-1 == Enter(0, 1, flags, &arg, sizeof(arg))) {
+        if (errno == ETIME || errno == EINTR)
+            return false;
+
+        throw SystemError{};
+    }
+
+    return LoadAcquire(_cqTail) != *_cqHead;
+}
+
+std::size_t IoUring::Reap(std::vector<Completion>& completions) {
+    auto head = *_cqHead;
+    auto tail = LoadAcquire(_cqTail);
+    auto cqes = static_cast<::io_uring_cqe*>(_cqes);
+
+    for (auto i = head; i != tail; ++i) {
+        auto& cqe = cqes[i & *_cqMask];
+        completions.push_back({cqe.user_data, cqe.res, cqe.flags});
+    }
+
+    StoreRelease(_cqHead, tail);
+
+    return tail - head;
+}
+
+bool IoUring::RegisterBuffers(std::uint16_t group, unsigned count, std::size_t size) {
+    if (_bufferRing)
+        throw std::logic_error("io_uring buffers already registered");
+
+    if (!count || (count & (count - 1)) || count > 0x8000)
+        throw std::logic_error("Invalid io_uring buffer count");
+
+    // The ring itself has to be page-aligned
+    auto ringSize = count * sizeof(::io_uring_buf);
+    auto ring = ::mmap(nullptr, ringSize, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if (ring == MAP_FAILED)
+        throw SystemError{};
+
+    ::io_uring_buf_reg reg;
+    std::memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = reinterpret_cast<std::uint64_t>(ring);
+    reg.ring_entries = count;
+    reg.bgid = group;
+
+    if (-1 == ::syscall(__NR_io_uring_register, _fd, IORING_REGISTER_PBUF_RING, &reg, 1)) {
+        auto error = errno;
+        ::munmap(ring, ringSize);
+
+        // Buffer rings came in Linux 5.19
+        if (error == EINVAL)
+            return false;
+
+        errno = error;
+        throw SystemError{};
+    }
+
+    _bufferRing = ring;
+    _bufferRingSize = ringSize;
+    _buffers.resize(count * size);
+    _bufferSize = size;
+    _bufferCount = count;
+
+    for (unsigned id = 0; id < count; ++id)
+        RecycleBuffer(id);
+
+    return true;
+}
+
+const char* IoUring::GetBuffer(unsigned id) const {
+    return _buffers.data() + id * _bufferSize;
+}
+
+void IoUring::RecycleBuffer(unsigned id) {
+    // The kernel's io_uring_buf_ring declares its buffers as a
+    // flexible array behind an empty struct, which takes up room
+    // in C++, so the ring is addressed as an array of buffers.
+    // The tail shares its place with the first buffer's reserved
+    // field, which isn't touched when filling in a buffer.
+    auto buffers = static_cast<::io_uring_buf*>(_bufferRing);
+    auto& buffer = buffers[_bufferTail & (_bufferCount - 1)];
+
+    buffer.addr = reinterpret_cast<std::uint64_t>(_buffers.data() + id * _bufferSize);
+    buffer.len = static_cast<std::uint32_t>(_bufferSize);
+    buffer.bid = static_cast<std::uint16_t>(id);
+
+    __atomic_store_n(&buffers[0].resv, ++_bufferTail, __ATOMIC_RELEASE);
+}
+
+int IoUring::Enter(unsigned toSubmit, unsigned minComplete, unsigned flags, void* arg, std::size_t argSize) {
+    return static_cast<int>(::syscall(__NR_io_uring_enter, _fd, toSubmit, minComplete, flags, arg, argSize));
+}
+
+} // namespace Chili
@@ -0,0 +1,123 @@
+#include "MonotonicArena.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+
+namespace Chili {
+
+MonotonicArena::MonotonicArena(SlabAllocator<char> allocator, std::size_t blockSize) :
+    _allocator(std::move(allocator)),
+    _blockSize(std::max(blockSize, sizeof(Block) + alignof(std::max_align_t))) {}
+
+MonotonicArena::MonotonicArena(MonotonicArena&& other) noexcept :
+    _blockSize(other._blockSize) {
+    *this = std::move(other);
+}
+
+MonotonicArena& MonotonicArena::operator=(MonotonicArena&& other) noexcept {
+    FreeBlocks(_blocks);
+
+    _allocator = std::move(other._allocator);
+    _blockSize = other._blockSize;
+    _blocks = std::exchange(other._blocks, nullptr);
+    _cursor = std::exchange(other._cursor, nullptr);
+    _end = std::exchange(other._end, nullptr);
+    _bytesUsed = std::exchange(other._bytesUsed, 0);
+
+    return *this;
+}
+
+MonotonicArena::~MonotonicArena() {
+    FreeBlocks(_blocks);
+}
+
+void* MonotonicArena::Allocate(std::size_t size, std::size_t alignment) {
+    auto address = reinterpret_cast<std::uintptr_t>(_cursor);
+    auto padding = -address & (alignment - 1);
+
+    if (!_cursor || padding + size > static_cast<std::size_t>(_end - _cursor)) {
+        AddBlock(size + alignment);
+        address = reinterpret_cast<std::uintptr_t>(_cursor);
+        padding = -address & (alignment - 1);
+    }
+
+    auto result = _cursor + padding;
+
+    _cursor = result + size;
+    _bytesUsed += size;
+
+    return result;
+}
+
+std::string_view MonotonicArena::Store(std::string_view s) {
+    if (s.empty())
+        return {};
+
+    auto data = static_cast<char*>(Allocate(s.size(), 1));
+    std::memcpy(data, s.data(), s.size());
+
+    return {data, s.size()};
+}
+
+void MonotonicArena::Reset() {
+    if (!_blocks)
+        return;
+
+    // Keep only the first block, which is the
+    // last one in the list, as it's the one of
+    // the default size, and the one to reuse.
+    auto first = _blocks;
+
+    while (first->Next)
+        first = first->Next;
+
+    if (first != _blocks) {
+        auto b = _blocks;
+
+        while (b->Next != first)
+            b = b->Next;
+
+        b->Next = nullptr;
+        FreeBlocks(_blocks);
+        _blocks = first;
+    }
+
+    _cursor = GetBlockData(first);
+    _end = reinterpret_cast<char*>(first) + first->Size;
+    _bytesUsed = 0;
+}
+
+std::size_t MonotonicArena::GetBytesUsed() const {
+    return _bytesUsed;
+}
+
+void MonotonicArena::AddBlock(std::size_t minSize) {
+    auto size = std::max(_blockSize, minSize + sizeof(Block) + alignof(std::max_align_t));
+    auto block = reinterpret_cast<Block*>(_allocator.allocate(size));
+
+    block->Next = _blocks;
+    block->Size = size;
+
+    _blocks = block;
+    _cursor = GetBlockData(block);
+    _end = reinterpret_cast<char*>(block) + size;
+}
+
+void MonotonicArena::FreeBlocks(Block* b) {
+    while (b) {
+        auto next = b->Next;
+        _allocator.deallocate(reinterpret_cast<char*>(b), b->Size);
+        b = next;
+    }
+}
+
+char* MonotonicArena::GetBlockData(Block* b) const {
+    auto data = reinterpret_cast<char*>(b) + sizeof(Block);
+    auto padding = -reinterpret_cast<std::uintptr_t>(data) & (alignof(std::max_align_t) - 1);
+    return data + padding;
+}
+
+} // namespace Chili
+
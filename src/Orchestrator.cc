@@ -1,23 +1,45 @@
 #include "Orchestrator.h"
+#include "Affinity.h"
 #include "ExitTrap.h"
 #include "Log.h"
 
 #include <algorithm>
 #include <chrono>
 #include <iterator>
+#include <stdexcept>
 
 using namespace std::literals;
 
 namespace Chili {
 
-void Orchestrator::Task::MarkHandlingInProcess(bool b) {
-    _inProcess = b;
-}
+namespace {
+
+/**
+ * The most stages a channel may advance through in
+ * one activation before others get their turn.
+ */
+const int MaxAdvancesPerActivation = 8;
+
+/**
+ * How often, at most, idle slab memory
+ * is released while there's nothing to do.
+ */
+const auto MemoryReleaseInterval = 10s;
+
+} // unnamed namespace
 
 bool Orchestrator::Task::IsHandlingInProcess() const {
     return _inProcess;
 }
 
+bool Orchestrator::Task::TryMarkHandlingInProcess() {
+    return !_inProcess.exchange(true);
+}
+
+bool Orchestrator::Task::MarkQueued(bool b) {
+    return _queued.exchange(b);
+}
+
 void Orchestrator::Task::Activate() {
     _orchestrator->RecordChannelEvent<ChannelActivating>(*_channel);
 
@@ -25,65 +47,148 @@ void Orchestrator::Task::Activate() {
         _orchestrator->RecordChannelEvent<ChannelActivated>(*_channel);
     });
 
-    if (ReachedInactivityTimeout()) {
-        Log::Info("Channel {} reached inactivity timeout", _channel->GetId());
-
-        // If it happened while it was in the poller, then remove
-        // it from there as well. Otherwise, this call should be
-        // okay with us trying to remove a non-existent channel.
-        _orchestrator->_poller.Remove(_channel->GetStream());
+    if (_completed || ReachedInactivityTimeout()) {
+        if (_completed)
+            Log::Verbose("Channel {} completed", _channel->GetId());
+        else
+            Log::Info("Channel {} reached inactivity timeout", _channel->GetId());
 
         _channel->Close();
         _inProcess = false;
-        _orchestrator->WakeUp();
+
+        // Requeue it so that it gets garbage-collected
+        _orchestrator->Schedule(shared_from_this());
         return;
     }
 
-    // Money line
-    _channel->Advance();
+    // Both the main thread and the poller (when activating
+    // inline) may have decided to activate us at the same
+    // time; whoever comes in second has nothing left to do.
+    if (!_channel->IsReady() || _channel->GetDefiniteStage() == Channel::Stage::Closed) {
+        _inProcess = false;
 
-    _lastActive.Set(Clock::GetCurrentTime());
+        // Requeue it in case it needs to be garbage-collected
+        if (_channel->GetDefiniteStage() == Channel::Stage::Closed)
+            _orchestrator->Schedule(shared_from_this());
 
-    // In case we're sending it off to the poller,
-    // we don't need to notify our main thread,
-    // because the task won't be ready until it
-    // comes back from the poller with an event.
-    bool notify = false;
+        return;
+    }
 
-    switch (_channel->GetDefiniteStage()) {
-        case Channel::Stage::WaitReadable: {
-            _orchestrator->_poller.Poll(_channel->GetStream(),
-                                        Poller::Events::Completion | Poller::Events::Readable);
-        } break;
+    // Money line. Keep advancing for as long as the channel is
+    // able to (e.g. reading a request, processing it, and writing
+    // the response) instead of bouncing it off the main thread
+    // between every stage, but within limits, to be fair to others.
+    for (int i = 0; i < MaxAdvancesPerActivation; ++i) {
+        ClearReadiness();
 
-        case Channel::Stage::WaitWritable: {
-            _orchestrator->_poller.Poll(_channel->GetStream(),
-                                        Poller::Events::Completion | Poller::Events::Writable);
-        } break;
+        _channel->Advance();
 
-        default:
-            // Ok, it's not going to the poller.
-            // It's ready for its next stage already.
-            // Therefore, wake up our main thread
-            // so that it could schedule its next
-            // stage whenever it sees fit.
-            //
-            // If we got a throttling timeout, then
-            // we will still wake up the main thread
-            // in order to recalculate the new timeout.
-            notify = true;
+        if (_channel->GetDefiniteStage() == Channel::Stage::Closed)
+            break;
+
+        // The stream may have become readable or
+        // writable again while we were busy with it.
+        ResumeIfReady();
+
+        if (!_channel->IsReady())
             break;
     }
 
+    _lastActive = Clock::GetCurrentTime();
+
     // Now it makes sense to be rescheduled again,
     // either immediately, or when we come back
     // from the poller with an event.
     _inProcess = false;
 
-    if (notify) {
-        // Wake up our main thread so that our
-        // next stage can be scheduled.
-        _orchestrator->WakeUp();
+    // Anything that tried to schedule us while we were
+    // still in process has been turned away, so we have
+    // to check for ourselves whether our next stage can
+    // already run. If it can't, then whoever makes it
+    // runnable (the poller, a response sent asynchronously,
+    // etc.) will be the one to schedule it.
+    switch (_channel->GetDefiniteStage()) {
+        case Channel::Stage::ReadTimeout:
+        case Channel::Stage::WriteTimeout:
+            // We got a throttling timeout, so wait for it
+            _orchestrator->ScheduleAt(shared_from_this(), _channel->GetRequestedTimeout());
+            break;
+
+        default:
+            // The client may have gone away while we were busy
+            if (_completed || _channel->IsReady())
+                _orchestrator->Schedule(shared_from_this());
+            break;
+    }
+}
+
+void Orchestrator::Task::MarkCompleted() {
+    _completed = true;
+}
+
+bool Orchestrator::Task::IsCompleted() const {
+    return _completed;
+}
+
+void Orchestrator::Task::MarkCollected() {
+    _collected = true;
+}
+
+bool Orchestrator::Task::IsCollected() const {
+    return _collected;
+}
+
+void Orchestrator::Task::SetReadiness(int events) {
+    if (events & Poller::Events::Readable)
+        _readable = true;
+
+    if (events & Poller::Events::Writable)
+        _writable = true;
+}
+
+void Orchestrator::Task::ClearReadiness() {
+    // Edge-triggered readiness is only reported once per
+    // change, so it's forgotten right before the channel
+    // tries to use it up. Any more readiness from here on
+    // is going to be reported all over again.
+    switch (_channel->GetDefiniteStage()) {
+        case Channel::Stage::Read:
+        case Channel::Stage::ReadTimeout:
+            _readable = false;
+            break;
+
+        case Channel::Stage::Write:
+        case Channel::Stage::WriteTimeout:
+            _writable = false;
+            break;
+
+        default:
+            break;
+    }
+}
+
+bool Orchestrator::Task::ResumeIfReady() {
+    switch (_channel->GetDefiniteStage()) {
+        case Channel::Stage::WaitReadable: {
+            if (!_readable)
+                return false;
+
+            _orchestrator->RecordChannelEvent<ChannelReadable>(*_channel);
+            Log::Verbose("Channel {} became readable", _channel->GetId());
+            _channel->SetStage(Channel::Stage::Read);
+        } return true;
+
+        case Channel::Stage::WaitWritable: {
+            if (!_writable)
+                return false;
+
+            _orchestrator->RecordChannelEvent<ChannelWritable>(*_channel);
+            Log::Verbose("Channel {} became writable", _channel->GetId());
+            _channel->SetStage(Channel::Stage::Write);
+        } return true;
+
+        default:
+            return false;
     }
 }
 
@@ -94,28 +199,48 @@ bool Orchestrator::Task::ReachedInactivityTimeout() const {
         return false;
     }
 
-    auto diff = Clock::GetCurrentTime() - _lastActive.GetCopy();
-    return diff >= _orchestrator->_inactivityTimeout.load();
+    return GetInactivityDeadline() <= Clock::GetCurrentTime();
+}
+
+Clock::TimePoint Orchestrator::Task::GetInactivityDeadline() const {
+    return _lastActive.load() + _orchestrator->_inactivityTimeout.load();
 }
 
 Channel& Orchestrator::Task::GetChannel() {
     return *_channel;
 }
 
+const std::shared_ptr<FileStream>& Orchestrator::Task::GetStream() const {
+    return _stream;
+}
+
+TimerWheel::Timer& Orchestrator::Task::GetThrottleTimer() {
+    return _throttleTimer;
+}
+
+TimerWheel::Timer& Orchestrator::Task::GetInactivityTimer() {
+    return _inactivityTimer;
+}
+
 std::mutex& Orchestrator::Task::GetMutex() {
     return _mutex;
 }
 
-std::shared_ptr<Orchestrator> Orchestrator::Create(std::shared_ptr<ChannelFactory> f, int threads) {
-    return std::shared_ptr<Orchestrator>(new Orchestrator(std::move(f), threads));
+std::shared_ptr<Orchestrator> Orchestrator::Create(std::shared_ptr<ChannelFactory> f, int threads, Poller::Backend backend) {
+    return std::shared_ptr<Orchestrator>(new Orchestrator(std::move(f), threads, backend));
 }
 
-Orchestrator::Orchestrator(std::shared_ptr<ChannelFactory> channelFactory, int threads) :
+Orchestrator::Orchestrator(std::shared_ptr<ChannelFactory> channelFactory, int threads, Poller::Backend backend) :
     _channelFactory(std::move(channelFactory)),
-    _poller(8),
+    _slab(std::make_shared<SlabCache>()),
+    _poller(8, Poller::Mode::EdgeTriggered, backend),
     _activationThreadPool(threads),
     _masterReadThrottler(std::make_shared<Throttler>()),
-    _masterWriteThrottler(std::make_shared<Throttler>()) {
+    _masterWriteThrottler(std::make_shared<Throttler>()),
+    _timerWheel(1ms, 0x1000) {
+    // Channels then read their requests without system calls
+    _poller.SetRingReceive(true);
+
     _poller.OnStop += [this] {
         _stop = true;
         WakeUp();
@@ -141,8 +266,10 @@ std::future<void> Orchestrator::Start() {
         }
     });
 
-    _pollerTask = _poller.Start([this](std::shared_ptr<FileStream> fs, int events) {
-        return OnEvent(std::move(fs), events);
+    SetThreadAffinity(_thread, _cpu);
+
+    _pollerTask = _poller.Start([this](std::shared_ptr<FileStream>, const std::shared_ptr<void>& context, int events) {
+        return OnEvent(std::static_pointer_cast<Task>(context), events);
     });
 
     return _threadPromise.get_future();
@@ -186,22 +313,78 @@ void Orchestrator::Stop() {
 }
 
 void Orchestrator::Add(std::shared_ptr<FileStream> stream) {
-    auto task = std::make_shared<Task>();
+    // Tasks and channels come and go with connections,
+    // so they're recycled through the shard's own slab.
+    auto task = std::allocate_shared<Task>(SlabAllocator<Task>(_slab));
 
     task->_orchestrator = this;
-    task->_channel = _channelFactory->CreateChannel(std::move(stream));
+    task->_channel = _channelFactory->CreateChannel(std::move(stream), _slab);
     task->_channel->Initialize(shared_from_this());
     task->_channel->_throttlers.Read.Master = _masterReadThrottler;
     task->_channel->_throttlers.Write.Master = _masterWriteThrottler;
-    task->_lastActive.Set(Clock::GetCurrentTime());
+    task->_lastActive = Clock::GetCurrentTime();
+    task->_stream = task->GetChannel().GetStream();
+
+    // Timer callbacks are called with the timer wheel locked.
+    // A task's timers are always cancelled before it's collected,
+    // so they can't outlive it, and we can refer to it directly.
+    task->_throttleTimer.OnExpired = [this, t = task.get()] {
+        Schedule(t->shared_from_this());
+    };
+
+    task->_inactivityTimer.OnExpired = [this, t = task.get()] {
+        auto now = Clock::GetCurrentTime();
+        auto deadline = t->GetInactivityDeadline();
+
+        if (t->ReachedInactivityTimeout()) {
+            // Let it close itself
+            Schedule(t->shared_from_this());
+        }
+
+        // Don't bother keeping track of activity as it
+        // happens; just check on it once the deadline
+        // we knew about has passed, and if the task
+        // turns out to have been active since then,
+        // push the deadline further away.
+        if (deadline <= now)
+            deadline = now + _inactivityTimeout.load();
+
+        _timerWheel.Insert(t->_inactivityTimer, deadline);
+    };
+
+    // Whenever the channel's stage changes in a way
+    // that may allow it to advance, it gets queued.
+    task->_channel->_readyToAdvance += [wo=std::weak_ptr<Orchestrator>(shared_from_this()),
+                                        wt=std::weak_ptr<Task>(task)] {
+        auto o = wo.lock();
+        auto t = wt.lock();
+
+        // If it's being processed right now, then whoever
+        // is processing it will check on it when done.
+        if (o && t && !t->IsHandlingInProcess())
+            o->Schedule(std::move(t));
+    };
 
     {
         std::lock_guard lock(_mutex);
-        _tasks.push_back(task);
-        _taskFastLookup[task->GetChannel().GetStream().get()] = task;
+        _tasks.insert(task);
+        ++_channelCount;
     }
 
-    _poller.Poll(task->GetChannel().GetStream(), Poller::Events::Completion | Poller::Events::Readable);
+    {
+        std::lock_guard lock(_timerWheelMutex);
+        _timerWheel.Insert(task->_inactivityTimer, task->GetInactivityDeadline());
+    }
+
+    // The stream stays in the poller until the task is
+    // collected, so that it never needs to be re-armed.
+    // Its events come back with the task attached, so
+    // there's no need to look it up when they arrive.
+    _poller.Poll(task->_stream,
+                 Poller::Events::Completion |
+                 Poller::Events::Readable |
+                 Poller::Events::Writable,
+                 task);
 }
 
 void Orchestrator::ThrottleRead(Throttler t) {
@@ -214,6 +397,52 @@ void Orchestrator::ThrottleWrite(Throttler t) {
 
 void Orchestrator::SetInactivityTimeout(std::chrono::milliseconds ms) {
     _inactivityTimeout = ms;
+
+    {
+        // Deadlines already in the wheel were computed with the
+        // old timeout, so they're moved according to the new one.
+        // Timers that aren't armed belong to tasks being collected.
+        std::lock_guard lock(_mutex);
+        std::lock_guard timerWheelLock(_timerWheelMutex);
+
+        for (auto& task : _tasks)
+            if (task->GetInactivityTimer().IsArmed())
+                _timerWheel.Insert(task->GetInactivityTimer(), task->GetInactivityDeadline());
+    }
+
+    // Our main thread might need to wake up
+    // earlier than it was planning to.
+    WakeUp();
+}
+
+void Orchestrator::SetChunkSize(std::size_t size, std::size_t maxSize) {
+    if (!size)
+        throw std::logic_error("Chunk size must not be 0");
+
+    _chunkSize = size;
+    _maxChunkSize = maxSize;
+}
+
+void Orchestrator::SetResponseCache(std::shared_ptr<ResponseCache> cache) {
+    _responseCache = std::move(cache);
+}
+
+void Orchestrator::SetInlineActivation(bool b) {
+    _inlineActivation = b;
+}
+
+void Orchestrator::SetAffinity(int cpu) {
+    _cpu = cpu;
+    _poller.SetAffinity(cpu);
+}
+
+void Orchestrator::ShareThrottlers(const Orchestrator& other) {
+    _masterReadThrottler = other._masterReadThrottler;
+    _masterWriteThrottler = other._masterWriteThrottler;
+}
+
+std::size_t Orchestrator::GetChannelCount() const {
+    return _channelCount;
 }
 
 void Orchestrator::WakeUp() {
@@ -221,84 +450,87 @@ void Orchestrator::WakeUp() {
     Profiler::Record<OrchestratorSignalled>();
 }
 
-void Orchestrator::OnEvent(std::shared_ptr<FileStream> fs, int events) {
-    // Lock the shared task list state, because we're
-    // going to try to find the relevant task for the
-    // triggered file stream in it.
-    std::unique_lock<std::mutex> lock(_mutex);
+void Orchestrator::Schedule(std::shared_ptr<Task> task) {
+    // A task only needs to be in the queue once,
+    // no matter how many times it was scheduled.
+    if (task->MarkQueued(true))
+        return;
 
-    auto it = _taskFastLookup.find(fs.get());
+    {
+        std::lock_guard lock(_readyTasksMutex);
+        _readyTasks.push_back(std::move(task));
+    }
 
-    if (it == end(_taskFastLookup))
-        return;
+    WakeUp();
+}
 
-    auto task = it->second.lock();
+void Orchestrator::ScheduleAt(std::shared_ptr<Task> task, Clock::TimePoint tp) {
+    {
+        std::lock_guard lock(_timerWheelMutex);
 
-    // Got our task. We can release the lock.
-    lock.unlock();
+        // It may have been closed by another activation and
+        // collected in the meantime, and then it must not be
+        // armed again, as nothing would ever cancel it.
+        if (task->IsCollected())
+            return;
+
+        _timerWheel.Insert(task->GetThrottleTimer(), tp);
+    }
 
+    // Our main thread might need to wake up
+    // earlier than it was planning to.
+    WakeUp();
+}
+
+void Orchestrator::OnEvent(std::shared_ptr<Task> task, int events) {
     auto& channel = task->GetChannel();
 
+    task->SetReadiness(events);
+
     if (events & Poller::Events::Completion) {
         // No use talking to a wall. Even if we had other events,
         // no one's going to be listening to our replies.
+        // The channel may be in the middle of being advanced, so
+        // it's left for whoever activates it next to close it.
         RecordChannelEvent<ChannelCompleted>(channel);
         Log::Verbose("Channel {} received completion event", channel.GetId());
-        channel.Close();
+        task->MarkCompleted();
     } else {
         std::lock_guard taskLock(task->GetMutex());
-        HandleChannelEvent(channel, events);
+
+        // Readiness that comes in while the channel isn't
+        // waiting for it is kept until the channel needs it.
+        if (!HandleChannelEvent(*task))
+            return;
+
+        // Rather than handing it over to the main thread, and then
+        // over to an activation thread, we can try to run it right
+        // here and now, as far as it goes, saving a couple of hops.
+        if (_inlineActivation && IsTaskReady(*task) && task->TryMarkHandlingInProcess()) {
+            task->Activate();
+            return;
+        }
     }
 
     // Either way, we need to react to what just happened,
     // either by garbage-collection or by advancing the
-    // relevant task's state-machine. So we need to wake
-    // our main thread up to do the work.
-    WakeUp();
+    // relevant task's state-machine. So we need to queue
+    // it up for our main thread to do the work.
+    Schedule(std::move(task));
 }
 
-void Orchestrator::HandleChannelEvent(Channel& channel, int events) {
-    switch (channel.GetDefiniteStage()) {
-        case Channel::Stage::WaitReadable: {
-            if (events & Poller::Events::Readable) {
-                RecordChannelEvent<ChannelReadable>(channel);
-                Log::Verbose("Channel {} became readable", channel.GetId());
-                channel.SetStage(Channel::Stage::Read);
-            } else {
-                Log::Error("Channel {} was waiting for readbility but got different "
-                                      "event. Check poll logic!", channel.GetId());
-            }
-        } break;
+bool Orchestrator::HandleChannelEvent(Task& task) {
+    auto& channel = task.GetChannel();
 
-        case Channel::Stage::WaitWritable: {
-            if (events & Poller::Events::Writable) {
-                RecordChannelEvent<ChannelWritable>(channel);
-                Log::Verbose("Channel {} became writable", channel.GetId());
-                channel.SetStage(Channel::Stage::Write);
-            } else {
-                Log::Error("Channel {} was waiting for writability but got different "
-                                      "event. Check poll logic!", channel.GetId());
-            }
-        } break;
-
-        case Channel::Stage::Closed: {
-            // One reason this can happen is if the channel has reached an
-            // inactivity timeout after the event was dispatched but
-            // before it was processed.
-            Log::Verbose("Ignoring event on already closed channel {}", channel.GetId());
-            return;
-         }
-
-        default: {
-            // The client is not supposed to be in the poller
-            // if it wasn't waiting for anything... This must
-            // be caused by a programming error.
-            Log::Error("Channel {} was not in a waiting stage but received an event. "
-                                  "Check poll logic!", channel.GetId());
-            channel.Close();
-            return;
-         }
+    if (channel.GetDefiniteStage() == Channel::Stage::Closed) {
+        // One reason this can happen is if the channel has reached an
+        // inactivity timeout after the event was dispatched but
+        // before it was processed.
+        Log::Verbose("Ignoring event on already closed channel {}", channel.GetId());
+        return false;
     }
+
+    return task.ResumeIfReady();
 }
 
 void Orchestrator::IterateOnce() {
@@ -311,8 +543,11 @@ void Orchestrator::IterateOnce() {
         // Mark it ias being handled right here so that we
         // don't need to wait for the thread to get to it.
         // This way, the next call of CaptureTasks()
-        // will filter this task out for us.
-        task->MarkHandlingInProcess(true);
+        // will filter this task out for us. If it's
+        // already being handled (inline by the poller)
+        // then it'll be rescheduled when it's done.
+        if (!task->TryMarkHandlingInProcess())
+            continue;
 
         _activationThreadPool.Post([=] {
             std::lock_guard lock(task->GetMutex());
@@ -322,50 +557,53 @@ void Orchestrator::IterateOnce() {
 }
 
 std::vector<std::shared_ptr<Orchestrator::Task>> Orchestrator::CaptureTasks() {
-    // We capture ready tasks into a new vector so that
-    // the original vector would be released, in terms
-    // of locks and mutexes, and new tasks could be
-    // added to it even while we're processing tasks
-    // that are already ready to be processed.
-    // This way, we don't take the lock for too long.
-    std::unique_lock<std::mutex> lock(_mutex);
-
-    Clock::TimePoint timeout;
+    // Tasks are only ever looked at when something has
+    // actually happened to them (they were queued by an
+    // event, or their timer expired), so the amount of
+    // work here depends on the number of ready tasks
+    // rather than on the number of open connections.
+    auto queued = std::vector<std::shared_ptr<Task>>();
 
     Profiler::Record<OrchestratorCapturingTasks>();
 
-    while ((timeout = GetLatestAllowedWakeup()) > Clock::GetCurrentTime()) {
-        lock.unlock();
-        Profiler::Record<OrchestratorWaiting>();
-        _newEvent.WaitUntilAndReset(timeout);
-        lock.lock();
-        Profiler::Record<OrchestratorWokeUp>();
+    for (;;) {
+        ScheduleExpiredTimers();
+
+        {
+            std::lock_guard lock(_readyTasksMutex);
+            queued.swap(_readyTasks);
+        }
 
         // Should the server stop?
-        if (_stop || AtLeastOneTaskIsReady())
+        if (_stop || !queued.empty())
             break;
-    }
 
-    CollectGarbage();
+        ReleaseIdleMemory();
 
-    return FilterReadyTasks();
+        Profiler::Record<OrchestratorWaiting>();
+        _newEvent.WaitUntilAndReset(GetLatestAllowedWakeup());
+        Profiler::Record<OrchestratorWokeUp>();
+    }
+
+    return FilterReadyTasks(std::move(queued));
 }
 
-std::vector<std::shared_ptr<Orchestrator::Task>> Orchestrator::FilterReadyTasks() {
+std::vector<std::shared_ptr<Orchestrator::Task>> Orchestrator::FilterReadyTasks(std::vector<std::shared_ptr<Task>> queued) {
     auto snapshot = std::vector<std::shared_ptr<Orchestrator::Task>>();
-    snapshot.reserve(_tasks.size());
+    snapshot.reserve(queued.size());
 
-    std::copy_if(begin(_tasks), end(_tasks), back_inserter(snapshot), [this](auto& t) {
-        return this->IsTaskReady(*t);
-    });
+    for (auto& t : queued) {
+        // It's out of the queue now, so from here on
+        // it should be allowed to be queued again.
+        t->MarkQueued(false);
 
-    return snapshot;
-}
+        if (t->GetChannel().GetTentativeStage() == Channel::Stage::Closed)
+            CollectGarbage(t);
+        else if (IsTaskReady(*t))
+            snapshot.push_back(std::move(t));
+    }
 
-bool Orchestrator::AtLeastOneTaskIsReady() {
-    return end(_tasks) != std::find_if(begin(_tasks), end(_tasks), [this](auto& t) {
-        return this->IsTaskReady(*t);
-    });
+    return snapshot;
 }
 
 bool Orchestrator::IsTaskReady(Task& t) {
@@ -377,9 +615,10 @@ bool Orchestrator::IsTaskReady(Task& t) {
     if (t.IsHandlingInProcess())
         return false;
 
-    // If the task has reached its inactivity
-    // timeout, it has to close itself, by itself.
-    if (t.ReachedInactivityTimeout())
+    // If the client is gone, or the task has
+    // reached its inactivity timeout, it has
+    // to close itself, by itself.
+    if (t.IsCompleted() || t.ReachedInactivityTimeout())
         return true;
 
     // Finally, is it ready for some
@@ -390,37 +629,54 @@ bool Orchestrator::IsTaskReady(Task& t) {
 Clock::TimePoint Orchestrator::GetLatestAllowedWakeup() {
     // Our latest possible timeout (i.e. default)
     // if nothing else is requested, is in fact
-    // our inactivity timeout, when we check
-    // if any channels have remained inactive
-    // for too long, in which case we close them.
+    // our inactivity timeout, though by then some
+    // timer is normally going to be due anyway.
+    auto timeout = Clock::GetCurrentTime() + _inactivityTimeout.load();
+
+    std::lock_guard lock(_timerWheelMutex);
+
+    // Sleep until the next tick in which any of the
+    // timers (throttling or inactivity) might expire.
+    return std::min(timeout, _timerWheel.GetNextExpiry());
+}
+
+void Orchestrator::ScheduleExpiredTimers() {
+    std::lock_guard lock(_timerWheelMutex);
+    _timerWheel.Expire(Clock::GetCurrentTime());
+}
+
+void Orchestrator::ReleaseIdleMemory() {
+    // With nothing to do for now, now and then hand
+    // the memory of connections that are long gone
+    // back to the OS. Not every time, since it's
+    // likely to be needed again soon after.
     auto now = Clock::GetCurrentTime();
-    auto timeout = now + _inactivityTimeout.load();
-
-    for (auto& t : _tasks) {
-        auto& channel = t->GetChannel();
-        auto&& requestedTimeout = channel.GetRequestedTimeout();
-
-        if ((requestedTimeout >= now) && (requestedTimeout < timeout)) {
-            // This client has requested an earlier timeout than
-            // the one we were going to use. In order that we can
-            // respond to its event as quickly as possible, we'll
-            // take its request.
-            timeout = requestedTimeout;
-        }
-    }
 
-    return timeout;
+    if (now < _nextMemoryRelease)
+        return;
+
+    _nextMemoryRelease = now + MemoryReleaseInterval;
+
+    if (auto released = _slab->ReleaseIdleMemory())
+        Log::Verbose("Released {} idle slab arenas", released);
 }
 
-void Orchestrator::CollectGarbage() {
-    auto garbageIterator = std::stable_partition(begin(_tasks), end(_tasks), [](auto& t) {
-        return t->GetChannel().GetTentativeStage() != Channel::Stage::Closed;
-    });
+void Orchestrator::CollectGarbage(const std::shared_ptr<Task>& t) {
+    {
+        // Make sure no timer refers to it anymore,
+        // and that none is going to from now on.
+        std::lock_guard lock(_timerWheelMutex);
+        t->MarkCollected();
+        _timerWheel.Cancel(t->GetThrottleTimer());
+        _timerWheel.Cancel(t->GetInactivityTimer());
+    }
 
-    for (auto i = garbageIterator, e = end(_tasks); i != e; ++i)
-        _taskFastLookup.erase((*i)->GetChannel().GetStream().get());
+    std::lock_guard lock(_mutex);
 
-    _tasks.erase(garbageIterator, end(_tasks));
+    if (_tasks.erase(t)) {
+        _poller.Remove(t->GetStream());
+        --_channelCount;
+    }
 }
 
 std::string OrchestratorEvent::GetSource() const {
@@ -1,22 +1,60 @@
 #include "Poller.h"
+#include "Affinity.h"
 #include "Log.h"
 #include "SystemError.h"
 
+#include <cerrno>
+#include <cstring>
+#include <linux/io_uring.h>
 #include <sys/epoll.h>
 #include <unistd.h>
 
 namespace Chili {
 
-Poller::Poller(int threads) :
+namespace {
+
+const unsigned RingEntries = 0x1000;
+const auto PollTimeout = std::chrono::milliseconds(100);
+
+/**
+ * The buffers sockets are received into by the ring.
+ * Their data is copied out of them as soon as it's
+ * reaped, so they're only ever briefly in use.
+ */
+const std::uint16_t ReceiveBufferGroup = 0;
+const unsigned ReceiveBufferCount = 0x200;
+const std::size_t ReceiveBufferSize = 0x1000;
+
+/**
+ * How much delivered data a socket may have unread before
+ * it's left to pile up in the socket's own buffer instead.
+ */
+const std::size_t MaxUnreadDelivered = 0x10000;
+
+} // unnamed namespace
+
+Poller::Poller(int threads, Mode mode, Backend backend) :
     _threadPool{std::make_shared<ThreadPool>(threads)},
+    _mode{mode},
     _stop{true} {
+    if (backend == Backend::IoUring) {
+        if (IoUring::IsSupported()) {
+            _ring = std::make_unique<IoUring>(RingEntries);
+            return;
+        }
+
+        Log::Warning("io_uring is not supported; falling back to epoll");
+    }
+
     if (-1 == (_fd = ::epoll_create1(EPOLL_CLOEXEC)))
         throw SystemError{};
 }
 
 Poller::~Poller() {
     Stop();
-    ::close(_fd);
+
+    if (_fd != -1)
+        ::close(_fd);
 }
 
 std::size_t Poller::GetWatchedCount() {
@@ -24,46 +62,80 @@ std::size_t Poller::GetWatchedCount() {
     return _files.size();
 }
 
-void Poller::Poll(std::shared_ptr<FileStream> fs, int events) {
-    InsertOrIncrementRefCount(fs, events);
+Poller::Backend Poller::GetBackend() const {
+    return _ring ? Backend::IoUring : Backend::Epoll;
+}
+
+void Poller::Poll(std::shared_ptr<FileStream> fs, int events, std::shared_ptr<void> context) {
+    if (_mode == Mode::EdgeTriggered)
+        Register(fs, events, std::move(context));
+    else
+        InsertOrIncrementRefCount(fs, events, std::move(context));
 }
 
 void Poller::Remove(const std::shared_ptr<FileStream>& fs) {
     DecrementRefCount(*fs);
 }
 
+// Edge-triggered files are registered only once, and from
+// then on they're only ever watched by a single reference,
+// which is removed when the file is explicitly removed.
+void Poller::Register(std::shared_ptr<FileStream>& fs, int events, std::shared_ptr<void> context) {
+    std::lock_guard lock{_filesMutex};
+
+    if (_files.count(fs.get()))
+        return;
+
+    auto& slot = AllocateSlot(fs, events, std::move(context));
+
+    if (!Watch(slot, false)) {
+        ReleaseSlot(slot);
+        throw SystemError{};
+    }
+
+    if (slot.Receiving)
+        Receive(slot);
+
+    if (_ring)
+        _ring->Submit();
+}
+
 // Handling ref counts makes it possible to re-register
 // from within a handler, even though straight after
 // it the dispatcher will decrement the ref count.
-void Poller::InsertOrIncrementRefCount(std::shared_ptr<FileStream>& fs, int events) {
-    struct epoll_event ev;
-
-    ev.events = EPOLLONESHOT | ConvertToNative(events);
-    ev.data.ptr = fs.get();
-
+void Poller::InsertOrIncrementRefCount(std::shared_ptr<FileStream>& fs, int events, std::shared_ptr<void> context) {
     std::lock_guard lock{_filesMutex};
 
     auto it = _files.find(fs.get());
 
     if (it == end(_files)) {
-        _files[fs.get()] = std::make_pair(1, fs);
+        auto& slot = AllocateSlot(fs, events, std::move(context));
 
-        if (-1 == ::epoll_ctl(_fd, EPOLL_CTL_ADD, fs->GetNativeHandle(), &ev)) {
-            _files.erase(fs.get());
+        if (!Watch(slot, false)) {
+            ReleaseSlot(slot);
             throw SystemError{};
         }
     } else {
-        ++_files[fs.get()].first;
+        auto& slot = *it->second;
+
+        {
+            std::lock_guard slotLock{slot.Mutex};
+            ++slot.RefCount;
+            slot.Events = events;
 
-        if (-1 == ::epoll_ctl(_fd, EPOLL_CTL_MOD, fs->GetNativeHandle(), &ev)) {
-            if (-1 == ::epoll_ctl(_fd, EPOLL_CTL_DEL, fs->GetNativeHandle(), nullptr))
-                Log::Error("Failed to delete {} from epoll after modification failed", _fd);
+            if (context)
+                slot.Context = std::move(context);
+        }
 
-            _files.erase(fs.get());
+        if (!Watch(slot, true)) {
+            Unwatch(slot);
+            ReleaseSlot(slot);
             throw SystemError{};
         }
     }
 
+    if (_ring)
+        _ring->Submit();
 }
 
 void Poller::DecrementRefCount(const FileStream& fs) {
@@ -72,28 +144,170 @@ void Poller::DecrementRefCount(const FileStream& fs) {
     auto it = _files.find(&fs);
 
     if (it != _files.end()) {
-        auto streamFd = fs.GetNativeHandle();
+        auto& slot = *it->second;
 
-        if (it->second.first == 1) {
-            _files.erase(it);
-        } else {
-            --it->second.first;
-            return;
+        {
+            std::lock_guard slotLock{slot.Mutex};
+
+            if (--slot.RefCount)
+                return;
+        }
+
+        Unwatch(slot);
+        ReleaseSlot(slot);
+    }
+}
+
+// Must be called with the files mutex locked
+Poller::Slot& Poller::AllocateSlot(std::shared_ptr<FileStream>& fs, int events, std::shared_ptr<void> context) {
+    Slot* slot;
+
+    if (_freeSlots.empty()) {
+        _slots.push_back(std::make_unique<Slot>());
+        slot = _slots.back().get();
+
+        if (reinterpret_cast<std::uintptr_t>(slot) >> GenerationShift)
+            throw std::logic_error("Poller slot address cannot be tagged");
+    } else {
+        slot = _freeSlots.back();
+        _freeSlots.pop_back();
+    }
+
+    {
+        std::lock_guard slotLock{slot->Mutex};
+        slot->RefCount = 1;
+        slot->Events = events;
+        slot->Stream = fs;
+        slot->Context = std::move(context);
+    }
+
+    if (_ringReceive) {
+        if (auto socket = dynamic_cast<SocketStream*>(fs.get())) {
+            socket->BeginDelivery();
+            slot->Receiving = true;
         }
+    }
+
+    _files[fs.get()] = slot;
+
+    return *slot;
+}
+
+// Must be called with the files mutex locked
+void Poller::ReleaseSlot(Slot& slot) {
+    std::shared_ptr<FileStream> stream;
+    std::shared_ptr<void> context;
+
+    {
+        std::lock_guard slotLock{slot.Mutex};
+
+        // Any event still carrying the old
+        // tag will be recognized as stale.
+        ++slot.Generation;
+        slot.RefCount = 0;
+        stream = std::move(slot.Stream);
+        context = std::move(slot.Context);
+    }
+
+    slot.Receiving = false;
+    slot.StoppingReceive = false;
+
+    _files.erase(stream.get());
+    _freeSlots.push_back(&slot);
+}
+
+std::uint64_t Poller::GetTag(const Slot& slot) {
+    return reinterpret_cast<std::uintptr_t>(&slot) |
+           (static_cast<std::uint64_t>(slot.Generation) << GenerationShift);
+}
+
+Poller::Slot& Poller::GetSlot(std::uint64_t tag) {
+    return *reinterpret_cast<Slot*>(tag & ((std::uint64_t(1) << GenerationShift) - 1) & ~ReceiveTag);
+}
+
+// Must be called with the files mutex locked,
+// which also serializes submissions to the ring.
+// Ring requests are only queued, so that the
+// caller can submit several of them at once.
+bool Poller::Watch(Slot& slot, bool rearm) {
+    auto native = ConvertToNative(slot.Events);
+    auto tag = GetTag(slot);
+    auto fd = slot.Stream->GetNativeHandle();
 
-        if (::epoll_ctl(_fd, EPOLL_CTL_DEL, streamFd, nullptr))
-            Log::Error("Failed to delete {} from epoll after ref count reset", _fd);
+    if (!_ring) {
+        struct epoll_event ev;
 
+        ev.events = native | (_mode == Mode::EdgeTriggered ? EPOLLET : EPOLLONESHOT);
+        ev.data.u64 = tag;
+
+        auto op = rearm ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+
+        return -1 != ::epoll_ctl(_fd, op, fd, &ev);
     }
+
+    if (rearm) {
+        // Replace the previous poll request if it's still
+        // pending. If it isn't, then the removal simply fails.
+        auto& remove = _ring->GetSqe();
+        remove.opcode = IORING_OP_POLL_REMOVE;
+        remove.addr = tag;
+    }
+
+    // Epoll and poll event bits have the same values.
+    // The data of sockets received from by the ring
+    // comes along with its own completions.
+    auto& add = _ring->GetSqe();
+    add.opcode = IORING_OP_POLL_ADD;
+    add.fd = fd;
+    add.poll32_events = slot.Receiving ? native & ~EPOLLIN : native;
+    add.user_data = tag;
+
+    if (_mode == Mode::EdgeTriggered)
+        add.len = IORING_POLL_ADD_MULTI;
+
+    return true;
+}
+
+// Must be called with the files mutex locked
+void Poller::Unwatch(Slot& slot) {
+    if (!_ring) {
+        auto fd = slot.Stream->GetNativeHandle();
+
+        if (::epoll_ctl(_fd, EPOLL_CTL_DEL, fd, nullptr))
+            Log::Error("Failed to delete {} from epoll", fd);
+
+        return;
+    }
+
+    // The ring holds on to the file for as
+    // long as the poll request is pending.
+    auto& remove = _ring->GetSqe();
+    remove.opcode = IORING_OP_POLL_REMOVE;
+    remove.addr = GetTag(slot);
+
+    if (slot.Receiving) {
+        auto& cancel = _ring->GetSqe();
+        cancel.opcode = IORING_OP_ASYNC_CANCEL;
+        cancel.addr = GetTag(slot) | ReceiveTag;
+    }
+
+    _ring->Submit();
 }
 
 std::future<void> Poller::Start(EventHandler handler) {
+    return Start([handler = std::move(handler)](std::shared_ptr<FileStream> fs, const std::shared_ptr<void>&, int events) {
+        handler(std::move(fs), events);
+    });
+}
+
+std::future<void> Poller::Start(ContextEventHandler handler) {
     if (!_stop || _thread.joinable())
         throw std::logic_error("Poller started while already running");
 
     _promise = std::promise<void>{};
     _stop = false;
     _thread = std::thread([=] { PollLoop(handler); });
+    SetThreadAffinity(_thread, _cpu);
 
     return _promise.get_future();
 }
@@ -105,25 +319,52 @@ void Poller::Stop() {
         _thread.join();
 }
 
-void Poller::PollLoop(const Poller::EventHandler& handler) {
-    constexpr int maxEvents = 100;
-    struct epoll_event events[maxEvents];
+void Poller::SetAffinity(int cpu) {
+    _cpu = cpu;
+}
+
+void Poller::SetRingReceive(bool b) {
+    std::lock_guard lock{_filesMutex};
+
+    if (!_ring || _mode != Mode::EdgeTriggered)
+        return;
+
+    if (b && !_buffersRegistered) {
+        _buffersRegistered = _ring->RegisterBuffers(ReceiveBufferGroup, ReceiveBufferCount, ReceiveBufferSize);
+
+        if (!_buffersRegistered)
+            Log::Warning("io_uring buffer rings are not supported; reading sockets directly");
+    }
+
+    _ringReceive = b && _buffersRegistered;
+}
+
+void Poller::PollLoop(const Poller::ContextEventHandler& handler) {
+    auto events = std::vector<std::pair<std::uint64_t, int>>();
 
     while (!_stop) {
+        events.clear();
+
         Profiler::Record<PollerWaiting>();
 
-        auto n = ::epoll_wait(_fd, events, maxEvents, 100);
+        bool ok;
+
+        try {
+            ok = _ring ? WaitForRingEvents(events) : WaitForEpollEvents(events);
+        } catch (...) {
+            ok = false;
+        }
 
         Profiler::Record<PollerWokeUp>();
 
-        if (n == -1) {
+        if (!ok) {
             _threadPool->Stop();
             _promise.set_exception(std::make_exception_ptr(SystemError{}));
             OnStop();
             return;
         }
 
-        DispatchEvents(events, n, handler);
+        DispatchEvents(events, handler);
     }
 
     _threadPool->Stop();
@@ -131,48 +372,245 @@ void Poller::PollLoop(const Poller::EventHandler& handler) {
     OnStop();
 }
 
-void Poller::DispatchEvents(void* eventsPtr, std::size_t n, const Poller::EventHandler& handler) {
-    auto events = static_cast<struct epoll_event*>(eventsPtr);
+bool Poller::WaitForEpollEvents(std::vector<std::pair<std::uint64_t, int>>& result) {
+    constexpr int maxEvents = 100;
+    struct epoll_event events[maxEvents];
+
+    auto n = ::epoll_wait(_fd, events, maxEvents, PollTimeout.count());
+
+    if (n == -1)
+        return false;
+
+    for (int i = 0; i < n; ++i)
+        result.emplace_back(static_cast<std::uint64_t>(events[i].data.u64), static_cast<int>(events[i].events));
+
+    return true;
+}
+
+bool Poller::WaitForRingEvents(std::vector<std::pair<std::uint64_t, int>>& result) {
+    if (!_ring->Wait(PollTimeout))
+        return true;
+
+    _completions.clear();
+    _ring->Reap(_completions);
+
+    auto resubmit = false;
+
+    for (auto& c : _completions) {
+        // Removals aren't tagged, and however they
+        // went, the file is no longer watched.
+        if (!c.UserData)
+            continue;
+
+        if (c.UserData & ReceiveTag) {
+            if (HandleReceive(c, result))
+                resubmit = true;
+
+            continue;
+        }
+
+        // A multishot poll stays armed for as long as the
+        // kernel says there's more to come, but the kernel
+        // may end it at will, so then it has to be resubmitted.
+        // A failed poll is over, whatever its mode.
+        auto ended = c.Result < 0 || (_mode == Mode::EdgeTriggered && !(c.Flags & IORING_CQE_F_MORE));
+
+        if (ended) {
+            resubmit = true;
+
+            if (!HandleEndedPoll(c))
+                continue;
+        }
+
+        result.emplace_back(c.UserData, c.Result < 0 ? static_cast<int>(EPOLLERR) : c.Result);
+    }
+
+    // Whatever had to be resubmitted goes in one go
+    if (resubmit) {
+        std::lock_guard lock{_filesMutex};
+        _ring->Submit();
+    }
+
+    return true;
+}
+
+// Returns whether the poll's result should be dispatched
+bool Poller::HandleEndedPoll(const IoUring::Completion& c) {
+    std::lock_guard lock{_filesMutex};
+
+    auto& slot = GetSlot(c.UserData);
+
+    // Requests cancelled along with their files are stale
+    if (GetTag(slot) != c.UserData || !slot.Stream)
+        return false;
+
+    // A multishot poll the kernel ended by itself
+    if (c.Result >= 0) {
+        Watch(slot, false);
+        return true;
+    }
+
+    switch (c.Result) {
+        case -ECANCELED:
+            // Watching a one-shot file again replaces
+            // its pending request, with the same tag.
+            if (_mode == Mode::OneShot)
+                return false;
+
+            [[fallthrough]];
+
+        case -ENOMEM:
+        case -EAGAIN:
+        case -EINTR:
+            Log::Verbose("Poll on {} ended early; resubmitting", slot.Stream->GetNativeHandle());
+            Watch(slot, false);
+            return false;
+
+        default:
+            // Let the handler know, so that it closes the file
+            Log::Error("Poll on {} failed: {}", slot.Stream->GetNativeHandle(), std::strerror(-c.Result));
+            return true;
+    }
+}
+
+// Must be called with the files mutex locked
+void Poller::Receive(Slot& slot) {
+    auto& sqe = _ring->GetSqe();
+    sqe.opcode = IORING_OP_RECV;
+    sqe.fd = slot.Stream->GetNativeHandle();
+    sqe.ioprio = IORING_RECV_MULTISHOT;
+    sqe.flags = IOSQE_BUFFER_SELECT;
+    sqe.buf_group = ReceiveBufferGroup;
+    sqe.user_data = GetTag(slot) | ReceiveTag;
+}
+
+// Returns whether any requests were queued
+bool Poller::HandleReceive(const IoUring::Completion& c, std::vector<std::pair<std::uint64_t, int>>& result) {
+    auto tag = c.UserData & ~ReceiveTag;
+    auto& slot = GetSlot(tag);
+    std::shared_ptr<FileStream> fs;
+
+    {
+        std::lock_guard slotLock{slot.Mutex};
+
+        if (GetTag(slot) == tag)
+            fs = slot.Stream;
+    }
+
+    // Only sockets are ever received from
+    auto socket = static_cast<SocketStream*>(fs.get());
+    std::size_t unread = 0;
+
+    // The data goes to the socket, unless it's gone by now,
+    // and either way, the buffer goes straight back.
+    if (c.Flags & IORING_CQE_F_BUFFER) {
+        auto id = c.Flags >> IORING_CQE_BUFFER_SHIFT;
 
-    auto files = std::vector<std::shared_ptr<FileStream>>();
+        if (socket && c.Result > 0)
+            unread = socket->Deliver(_ring->GetBuffer(id), c.Result);
 
-    files.reserve(n);
+        _ring->RecycleBuffer(id);
+    }
+
+    if (!socket)
+        return false;
+
+    if (c.Result > 0)
+        result.emplace_back(tag, EPOLLIN);
+
+    std::lock_guard lock{_filesMutex};
 
-    std::unique_lock lock{_filesMutex};
+    if (GetTag(slot) != tag || !slot.Receiving)
+        return false;
 
-    for (std::size_t i = 0; i < n; ++i) {
-        files.push_back(GetFileStreamFromPtr(events[i].data.ptr));
+    auto pilingUp = unread > MaxUnreadDelivered;
+
+    if (c.Result > 0 && (c.Flags & IORING_CQE_F_MORE)) {
+        if (!pilingUp || slot.StoppingReceive)
+            return false;
+
+        // The client sends more than is being read, so
+        // its data is left in the socket's buffer, as
+        // it would be if the socket were read directly.
+        auto& cancel = _ring->GetSqe();
+        cancel.opcode = IORING_OP_ASYNC_CANCEL;
+        cancel.addr = c.UserData;
+        slot.StoppingReceive = true;
+        return true;
     }
 
-    lock.unlock();
+    // A request the kernel ended by itself, or which
+    // ran out of buffers before they were recycled.
+    if ((c.Result > 0 || c.Result == -ENOBUFS) && !pilingUp && !slot.StoppingReceive) {
+        Receive(slot);
+        return true;
+    }
+
+    if (c.Result == -EINVAL) {
+        Log::Warning("Multishot receive is not supported; reading sockets directly");
+        _ringReceive = false;
+    }
 
-    for (std::size_t i = 0; i < n; ++i) {
-        auto eventMask = events[i].events;
-        auto& fs = files[i];
+    // Anything else, such as the end of the stream, an error,
+    // or having been cancelled, ends receiving for good. The
+    // socket itself then reports whatever happened to it.
+    StopReceiving(slot, *socket);
+    result.emplace_back(tag, EPOLLIN);
+
+    return true;
+}
+
+// Must be called with the files mutex locked
+void Poller::StopReceiving(Slot& slot, SocketStream& socket) {
+    slot.Receiving = false;
+    slot.StoppingReceive = false;
+    socket.EndDelivery();
+
+    // Readability has to be polled for from now on
+    auto& update = _ring->GetSqe();
+    update.opcode = IORING_OP_POLL_REMOVE;
+    update.addr = GetTag(slot);
+    update.len = IORING_POLL_UPDATE_EVENTS | IORING_POLL_ADD_MULTI;
+    update.poll32_events = ConvertToNative(slot.Events);
+}
+
+void Poller::DispatchEvents(const std::vector<std::pair<std::uint64_t, int>>& events, const Poller::ContextEventHandler& handler) {
+    for (auto& [tag, eventMask] : events) {
+        std::shared_ptr<FileStream> fs;
+        std::shared_ptr<void> context;
+
+        // Slots are never freed, only recycled, so the tag's
+        // address is always valid, but it may have been reused
+        // for another file since the event was generated.
+        {
+            auto& slot = GetSlot(tag);
+            std::lock_guard slotLock{slot.Mutex};
+
+            if (GetTag(slot) == tag) {
+                fs = slot.Stream;
+                context = slot.Context;
+            }
+        }
 
         if (!fs) {
             Log::Verbose("File stream was closed in between iterations");
             continue;
         }
 
-        _threadPool->Post([=] {
+        _threadPool->Post([=, eventMask = eventMask] {
             try {
-                handler(fs, ConvertFromNative(eventMask));
+                handler(fs, context, ConvertFromNative(eventMask));
             } catch (...) {
             }
 
-            DecrementRefCount(*fs);
+            if (_mode == Mode::OneShot)
+                DecrementRefCount(*fs);
         });
 
         Profiler::Record<PollerEventDispatched>();
     }
 }
 
-std::shared_ptr<FileStream> Poller::GetFileStreamFromPtr(void* ptr) {
-    auto it = _files.find(ptr);
-    return it == _files.end() ? nullptr : it->second.second;
-}
-
 int Poller::ConvertFromNative(int m) {
     int result = 0;
 
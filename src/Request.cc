@@ -4,12 +4,14 @@
 #include <algorithm>
 #include <chrono>
 #include <cstring>
+#include <climits>
 #include <http-parser/http_parser.h>
-#include <strings.h>
 
 namespace Chili {
 
 constexpr std::size_t BufferSize = 0x2000;
+constexpr std::size_t FramingBufferSize = 0x400;
+constexpr std::uint64_t MaxContentLength = 0x100000000;
 
 class HttpParserStringBuilder {
 public:
@@ -45,7 +47,7 @@ public:
 
             sb.Feed(length);
 
-            r._uri = std::string_view(sb.Data, sb.Length);
+            r._header.Uri = std::string_view(sb.Data, sb.Length);
 
             return 0;
         };
@@ -90,7 +92,21 @@ public:
         };
 
         _settings.on_headers_complete = [](auto parser) {
-            GetRequest(parser)._parsedHeader = true;
+            auto& r = GetRequest(parser);
+            auto& header = r._header;
+
+            header.Method = ::http_method_str(static_cast<::http_method>(parser->method));
+            header.VersionMajor = parser->http_major;
+            header.VersionMinor = parser->http_minor;
+            header.KeepAlive = ::http_should_keep_alive(parser);
+
+            if (parser->content_length != ULLONG_MAX)
+                header.ContentLength = parser->content_length;
+
+            header.Chunked = parser->flags & F_CHUNKED;
+
+            r._parsedHeader = true;
+
             return 2; // don't parse body for us
         };
     }
@@ -112,32 +128,91 @@ struct PrivateData {
     HttpParserStringBuilder StringBuilder;
 };
 
-static ::http_parser* GetParser(void* ptr) {
-    return &static_cast<PrivateData*>(ptr)->Parser;
+static ::http_parser* GetParser(const std::shared_ptr<void>& ptr) {
+    return &static_cast<PrivateData*>(ptr.get())->Parser;
 }
 
+// The SIMD parser is only worth it if the CPU actually
+// supports SIMD; otherwise, http_parser will do better.
+static const HeaderParser* GetSimdHeaderParser() {
+    static const auto parser = HeaderParser();
+
+    if (parser.GetInstructionSet() == HeaderParser::InstructionSet::Generic)
+        return nullptr;
+
+    return &parser;
+}
+
+Request::Request(std::shared_ptr<InputStream> input, SlabAllocator<char> allocator) :
+    _buffer(BufferSize, allocator),
+    _input{std::move(input)},
+    _headers(allocator) {
+    if (!GetSimdHeaderParser()) {
+        auto privateData = std::allocate_shared<PrivateData>(SlabAllocator<PrivateData>(allocator));
+        ::http_parser_init(&privateData->Parser, HTTP_REQUEST);
+        privateData->Parser.data = this;
+        _privateData = std::move(privateData);
+    }
 
-Request::Request(std::shared_ptr<InputStream> input) :
-    _buffer(BufferSize),
-    _input{std::move(input)} {
-    auto privateData = new PrivateData();
-    ::http_parser_init(&privateData->Parser, HTTP_REQUEST);
-    privateData->Parser.data = this;
-    _privateData = privateData;
     _headers.reserve(8);
 }
 
-Request::~Request() {
-    delete static_cast<PrivateData*>(_privateData);
+Request::Request(Request&& other) noexcept {
+    *this = std::move(other);
 }
 
+Request& Request::operator=(Request&& other) noexcept {
+    _buffer = std::move(other._buffer);
+    _bufferPosition = other._bufferPosition;
+    _leftoverBytes = other._leftoverBytes;
+    _input = std::move(other._input);
+    _privateData = std::move(other._privateData);
+    _headerBytesParsed = other._headerBytesParsed;
+    _parsedHeader = other._parsedHeader;
+    _onlySentHeaderFirst = other._onlySentHeaderFirst;
+    _header = other._header;
+    _headers = std::move(other._headers);
+    _index = other._index;
+    _content = std::move(other._content);
+    _contentPosition = other._contentPosition;
+    _chunkedDecoder = other._chunkedDecoder;
+    _chunkedBodyPosition = other._chunkedBodyPosition;
+    _framingBuffer = std::move(other._framingBuffer);
+    _framingPosition = other._framingPosition;
+    _framingEnd = other._framingEnd;
+    _contentSink = std::move(other._contentSink);
+    _contentFile = std::move(other._contentFile);
+    _contentPipe = std::move(other._contentPipe);
+
+    // The parser calls back into its owning request
+    if (_privateData)
+        GetParser(_privateData)->data = this;
+
+    return *this;
+}
+
+Request::~Request() = default;
+
 HttpParserStringBuilder& Request::GetStringBuilder() {
-    return static_cast<PrivateData*>(_privateData)->StringBuilder;
+    return static_cast<PrivateData*>(_privateData.get())->StringBuilder;
 }
 
 bool Request::ConsumeHeader(std::size_t maxBytes, std::size_t& bytesRead) {
-    if (_bufferPosition == 0)
-        std::memset(_buffer.data(), 0, BufferSize);
+    bytesRead = 0;
+
+    // Parse whatever was left over from the previous
+    // request first. It wasn't read now, so it isn't
+    // counted as such. If it isn't a complete header,
+    // then go on to read the rest of it.
+    if (auto leftoverBytes = std::exchange(_leftoverBytes, 0)) {
+        if (_privateData)
+            ParseWithHttpParser(leftoverBytes);
+        else
+            ParseWithHeaderParser(*GetSimdHeaderParser(), leftoverBytes);
+
+        if (_parsedHeader)
+            return FinishHeader();
+    }
 
     auto quota = std::min(maxBytes, BufferSize - _bufferPosition);
 
@@ -146,6 +221,31 @@ bool Request::ConsumeHeader(std::size_t maxBytes, std::size_t& bytesRead) {
     if (!bytesRead)
         return false;
 
+    if (_privateData)
+        ParseWithHttpParser(bytesRead);
+    else
+        ParseWithHeaderParser(*GetSimdHeaderParser(), bytesRead);
+
+    if (!_parsedHeader) {
+        if (_bufferPosition == BufferSize)
+            throw std::runtime_error("No end-of-header found in request header");
+        else
+            return false;
+    }
+
+    return FinishHeader();
+}
+
+bool Request::FinishHeader() {
+    for (std::size_t i = 0; i < _headers.size(); ++i)
+        _index.Add(_headers[i].first, i);
+
+    _chunkedBodyPosition = _headerBytesParsed;
+    _onlySentHeaderFirst = (_bufferPosition == _headerBytesParsed);
+    return true;
+}
+
+void Request::ParseWithHttpParser(std::size_t bytesRead) {
     auto parser = GetParser(_privateData);
 
     auto bytesParsed = ::http_parser_execute(parser,
@@ -156,23 +256,29 @@ bool Request::ConsumeHeader(std::size_t maxBytes, std::size_t& bytesRead) {
     _bufferPosition += bytesRead;
     _headerBytesParsed += bytesParsed;
 
-    if (!_parsedHeader) {
-        if (bytesParsed != bytesRead)
-            throw std::runtime_error(::http_errno_name(static_cast<::http_errno>(parser->http_errno)));
-        else if (_bufferPosition == BufferSize)
-            throw std::runtime_error("No end-of-header found in request header");
-        else
-            return false;
-    }
+    if (!_parsedHeader && bytesParsed != bytesRead)
+        throw std::runtime_error(::http_errno_name(static_cast<::http_errno>(parser->http_errno)));
+}
 
-    _onlySentHeaderFirst = (_bufferPosition == _headerBytesParsed);
+void Request::ParseWithHeaderParser(const HeaderParser& parser, std::size_t bytesRead) {
+    // The end of the header might have
+    // started in the previous read.
+    auto scanPosition = _bufferPosition > 3 ? _bufferPosition - 3 : 0;
 
-    return true;
+    _bufferPosition += bytesRead;
+
+    auto data = _buffer.data();
+    auto end = parser.FindEnd(data + scanPosition, data + _bufferPosition);
+
+    if (!end)
+        return;
+
+    _headerBytesParsed = end - data;
+    _header = parser.Parse({data, _headerBytesParsed}, _headers);
+    _parsedHeader = true;
 }
 
 Method Request::GetMethod() const {
-    auto method = ::http_method_str(static_cast<::http_method>(GetParser(_privateData)->method));
-
     // indices must correspond to Method enum
     auto methods = {
         "OPTIONS",
@@ -188,7 +294,7 @@ Method Request::GetMethod() const {
     int i = 0;
 
     for (auto& m : methods) {
-        if (!::strcmp(method, m))
+        if (_header.Method == m)
             return static_cast<Method>(i);
 
         ++i;
@@ -198,18 +304,16 @@ Method Request::GetMethod() const {
 }
 
 std::string_view Request::GetUri() const {
-    return _uri;
+    return _header.Uri;
 }
 
 Version Request::GetVersion() const {
-    auto parser = GetParser(_privateData);
-
-    if (parser->http_major != 1)
+    if (_header.VersionMajor != 1)
         throw std::runtime_error("Unsupported HTTP method");
 
-    if (parser->http_minor == 0)
+    if (_header.VersionMinor == 0)
         return Version::Http10;
-    else if (parser->http_minor == 1)
+    else if (_header.VersionMinor == 1)
         return Version::Http11;
     else
         throw std::runtime_error("Unsupported HTTP method");
@@ -227,44 +331,92 @@ std::vector<std::string_view> Request::GetHeaderNames() const {
 }
 
 bool Request::HasHeader(const std::string_view& name) const {
-    return GetHeader(name, nullptr);
+    return _index.Find(name, _headers) != HeaderIndex::npos;
+}
+
+bool Request::HasHeader(Header h) const {
+    return _index.Find(h) != HeaderIndex::npos;
 }
 
 bool Request::GetHeader(const std::string_view& name, std::string* value) const {
-    for (auto& [headerName, headerValue] : _headers) {
-        if (!::strncasecmp(headerName.data(), name.data(), name.size())) {
-            if (value)
-                *value = std::string(headerValue.data(), headerValue.size());
+    std::string_view view;
 
-            return true;
-        }
-    }
+    if (!GetHeader(name, &view))
+        return false;
+
+    if (value)
+        *value = std::string(view.data(), view.size());
+
+    return true;
+}
+
+bool Request::GetHeader(const std::string_view& name, std::string_view* value) const {
+    auto position = _index.Find(name, _headers);
+
+    if (position == HeaderIndex::npos)
+        return false;
+
+    if (value)
+        *value = _headers[position].second;
 
-    return false;
+    return true;
 }
 
 std::string_view Request::GetHeader(const std::string_view& name) const {
-    for (auto& [headerName, headerValue] : _headers)
-        if (!::strncasecmp(headerName.data(), name.data(), name.size()))
-                return headerValue;
+    std::string_view value;
+
+    if (!GetHeader(name, &value))
+        throw std::runtime_error("Specified header does not exist");
 
-    throw std::runtime_error("Specified header does not exist");
+    return value;
+}
+
+bool Request::GetHeader(Header h, std::string_view* value) const {
+    auto position = _index.Find(h);
+
+    if (position == HeaderIndex::npos)
+        return false;
+
+    if (value)
+        *value = _headers[position].second;
+
+    return true;
+}
+
+std::string_view Request::GetHeader(Header h) const {
+    std::string_view value;
+
+    if (!GetHeader(h, &value))
+        throw std::runtime_error("Specified header does not exist");
+
+    return value;
 }
 
 bool Request::HasContent() const {
-    return GetContentLength() != 0;
+    return GetContentLength() != 0 || IsChunked();
+}
+
+bool Request::IsChunked() const {
+    return _header.Chunked;
 }
 
 bool Request::IsContentAvailable() const {
-    return GetContentLength() == _content.size();
+    if (IsChunked())
+        return _chunkedDecoder.IsDone();
+
+    return GetContentLength() == _contentPosition;
 }
 
 std::size_t Request::GetContentLength() const {
-    return GetParser(_privateData)->content_length;
+    return _header.ContentLength;
+}
+
+std::size_t Request::GetConsumedContentLength() const {
+    return _contentPosition;
 }
 
 bool Request::KeepAlive() const {
-    return ::http_should_keep_alive(GetParser(_privateData));
+    return _header.KeepAlive;
 }
 
 bool Request::ConsumeContent(std::size_t maxBytes, std::size_t& totalBytesRead) {
@@ -281,9 +433,18 @@ bool Request::ConsumeContent(std::size_t maxBytes, std::size_t& totalBytesRead)
      * only sent the header first and waited for body
      * retrievals to be done in subsequent ones.
      */
+    if (IsChunked())
+        return ConsumeChunkedContent(maxBytes, totalBytesRead);
+
+    if (_contentPipe)
+        return SpliceContent(maxBytes, totalBytesRead);
+
+    if (_contentSink)
+        return StreamContent(maxBytes, totalBytesRead);
+
     auto contentLength = GetContentLength();
 
-    if (contentLength > 0x100000000)
+    if (contentLength > MaxContentLength)
         throw std::runtime_error("Request body too big; rejected!");
 
     if (_contentPosition == 0) {
@@ -317,6 +478,274 @@ bool Request::ConsumeContent(std::size_t maxBytes, std::size_t& totalBytesRead)
     return _contentPosition == contentLength;
 }
 
+bool Request::ConsumeChunkedContent(std::size_t maxBytes, std::size_t& totalBytesRead) {
+    // Whatever was read along with the header comes first,
+    // and it isn't counted, just like with regular content.
+    DecodeBufferedChunks();
+
+    while (!_chunkedDecoder.IsDone() && totalBytesRead < maxBytes) {
+        auto quota = maxBytes - totalBytesRead;
+        std::size_t readLength;
+        std::size_t bytesRead;
+
+        auto remaining = _chunkedDecoder.GetDataRemaining();
+
+        if (remaining && !_contentSink) {
+            // In the middle of chunk data, so there's
+            // no framing to strip; read it right into
+            // place in the content.
+            readLength = std::min<std::uint64_t>(quota, remaining);
+            auto data = ExtendContent(readLength);
+            bytesRead = _input->Read(data, readLength);
+            _content.resize(_content.size() - (readLength - bytesRead));
+            _contentPosition += bytesRead;
+            _chunkedDecoder.SkipData(bytesRead);
+        } else {
+            // Chunk framing, or data to be streamed, which is
+            // read past the header and decoded from there. All
+            // buffered data was consumed, so its space can be
+            // reused. A header that left little room past it
+            // can't be moved, since it's referred to in place,
+            // so a small buffer of its own is used instead.
+            // Anything read past the end of the body is left
+            // for the next request, as with pipelining.
+            _bufferPosition = _chunkedBodyPosition = _headerBytesParsed;
+            _framingPosition = _framingEnd = 0;
+
+            if (BufferSize - _bufferPosition >= FramingBufferSize) {
+                readLength = std::min(quota, BufferSize - _bufferPosition);
+                bytesRead = _input->Read(_buffer.data() + _bufferPosition, readLength);
+                _bufferPosition += bytesRead;
+            } else {
+                _framingBuffer.resize(FramingBufferSize);
+                readLength = std::min(quota, FramingBufferSize);
+                bytesRead = _input->Read(_framingBuffer.data(), readLength);
+                _framingEnd = bytesRead;
+            }
+
+            DecodeBufferedChunks();
+        }
+
+        totalBytesRead += bytesRead;
+
+        if (bytesRead < readLength)
+            break; // Nothing more to read for now
+    }
+
+    return _chunkedDecoder.IsDone();
+}
+
+void Request::DecodeBufferedChunks() {
+    auto decode = [this](const char* buffer, std::size_t& position, std::size_t end) {
+        while (position < end && !_chunkedDecoder.IsDone()) {
+            std::string_view data;
+
+            position += _chunkedDecoder.Decode(buffer + position, end - position, data);
+
+            WriteContent(data.data(), data.size());
+        }
+    };
+
+    decode(_buffer.data(), _chunkedBodyPosition, _bufferPosition);
+    decode(_framingBuffer.data(), _framingPosition, _framingEnd);
+}
+
+bool Request::StreamContent(std::size_t maxBytes, std::size_t& totalBytesRead) {
+    auto contentLength = GetContentLength();
+
+    // Whatever was read along with the header comes first
+    if (_contentPosition == 0) {
+        auto contentInBuffer = std::min<std::size_t>(_bufferPosition - _headerBytesParsed, contentLength);
+        WriteContent(_buffer.data() + _headerBytesParsed, contentInBuffer);
+    }
+
+    while (_contentPosition < contentLength && totalBytesRead < maxBytes) {
+        // All buffered content was handed over,
+        // so its space can be reused. Nothing is
+        // read past the end of the content.
+        _bufferPosition = _headerBytesParsed;
+
+        auto readLength = std::min({maxBytes - totalBytesRead,
+                                    contentLength - _contentPosition,
+                                    BufferSize - _bufferPosition});
+
+        if (!readLength)
+            throw std::runtime_error("No room left in request buffer for content");
+
+        auto bytesRead = _input->Read(_buffer.data() + _bufferPosition, readLength);
+
+        _bufferPosition += bytesRead;
+        totalBytesRead += bytesRead;
+
+        WriteContent(_buffer.data() + _headerBytesParsed, bytesRead);
+
+        if (bytesRead < readLength)
+            break; // Nothing more to read for now
+    }
+
+    return _contentPosition == contentLength;
+}
+
+bool Request::SpliceContent(std::size_t maxBytes, std::size_t& totalBytesRead) {
+    auto contentLength = GetContentLength();
+
+    // Whatever was read along with the header was
+    // already copied, so it's just written normally.
+    if (_contentPosition == 0) {
+        auto contentInBuffer = std::min<std::size_t>(_bufferPosition - _headerBytesParsed, contentLength);
+        WriteContent(_buffer.data() + _headerBytesParsed, contentInBuffer);
+    }
+
+    auto& input = static_cast<FileStream&>(*_input);
+    while (_contentPosition < contentLength && totalBytesRead < maxBytes) {
+        // The pipe is always emptied, so this never blocks
+        auto readLength = std::min({maxBytes - totalBytesRead,
+                                    contentLength - _contentPosition,
+                                    _contentPipe->Capacity});
+
+        auto bytesRead = input.WriteTo(*_contentPipe->Write, readLength);
+
+        for (std::size_t written = 0; written < bytesRead; ) {
+            auto result = _contentPipe->Read->WriteTo(*_contentFile, bytesRead - written);
+
+            // The file can't take any more, and
+            // retrying would only spin forever.
+            if (!result)
+                throw std::runtime_error("Failed to write request content to file");
+
+            written += result;
+        }
+
+        _contentPosition += bytesRead;
+        totalBytesRead += bytesRead;
+
+        if (bytesRead < readLength)
+            break; // Nothing more to read for now
+    }
+
+    return _contentPosition == contentLength;
+}
+
+void Request::WriteContent(const char* data, std::size_t size) {
+    if (!size)
+        return;
+
+    if (_contentSink)
+        _contentSink({data, size});
+    else
+        std::memcpy(ExtendContent(size), data, size);
+
+    _contentPosition += size;
+}
+
+void Request::SetContentSink(ContentSink sink) {
+    _contentSink = std::move(sink);
+}
+
+void Request::SetContentFile(std::shared_ptr<FileStream> file) {
+    // Chunk framing has to be stripped, and content
+    // read along with the header is already in memory,
+    // so either way it's just written normally.
+    _contentSink = [file](std::string_view data) {
+        for (std::size_t written = 0; written < data.size(); ) {
+            auto result = file->Write(data.data() + written, data.size() - written);
+
+            if (!result)
+                throw std::runtime_error("Failed to write request content to file");
+
+            written += result;
+        }
+    };
+
+    if (!IsChunked() && std::dynamic_pointer_cast<FileStream>(_input)) {
+        _contentFile = std::move(file);
+        _contentPipe = Pipe::Create();
+    }
+}
+
+char* Request::ExtendContent(std::size_t size) {
+    auto position = _content.size();
+
+    if (position + size > MaxContentLength)
+        throw std::runtime_error("Request body too big; rejected!");
+
+    _content.resize(position + size);
+
+    return _content.data() + position;
+}
+
+void Request::Reset() {
+    auto requestEnd = GetEndPosition();
+
+    _leftoverBytes = _bufferPosition - requestEnd;
+
+    if (_leftoverBytes)
+        std::memmove(_buffer.data(), _buffer.data() + requestEnd, _leftoverBytes);
+
+    // The framing buffer is only read into once the
+    // request buffer is used up, so what's left in
+    // it goes after anything left in the latter.
+    if (auto framedBytes = _framingEnd - _framingPosition) {
+        std::memcpy(_buffer.data() + _leftoverBytes, _framingBuffer.data() + _framingPosition, framedBytes);
+        _leftoverBytes += framedBytes;
+    }
+
+    _bufferPosition = 0;
+    _headerBytesParsed = 0;
+    _parsedHeader = false;
+    _onlySentHeaderFirst = false;
+    _header = {};
+    _headers.clear();
+    _index.Clear();
+    _content.clear();
+    _contentPosition = 0;
+    _chunkedDecoder.Reset();
+    _chunkedBodyPosition = 0;
+    _framingPosition = 0;
+    _framingEnd = 0;
+    _contentSink = {};
+    _contentFile.reset();
+    _contentPipe.reset();
+
+    if (_privateData) {
+        ::http_parser_init(GetParser(_privateData), HTTP_REQUEST);
+        GetStringBuilder() = {};
+    }
+}
+
+bool Request::HasPipelinedData() const {
+    return _parsedHeader && (_bufferPosition > GetEndPosition() || _framingPosition < _framingEnd);
+}
+
+bool Request::HasPipelinedHeader() const {
+    if (!HasPipelinedData())
+        return false;
+
+    auto requestEnd = GetEndPosition();
+    auto buffered = std::string_view(_buffer.data() + requestEnd, _bufferPosition - requestEnd);
+    auto framed = std::string_view(_framingBuffer.data() + _framingPosition, _framingEnd - _framingPosition);
+
+    // The framing buffer follows the request buffer, so the
+    // header is complete if its end is in either of them.
+    // An end split between the two is missed, which only
+    // means that the next response isn't batched.
+    return buffered.find("\r\n\r\n") != std::string_view::npos ||
+           framed.find("\r\n\r\n") != std::string_view::npos;
+}
+
+std::size_t Request::GetEndPosition() const {
+    if (!_parsedHeader)
+        return 0;
+
+    // Chunked bodies end wherever decoding ended
+    if (IsChunked())
+        return _chunkedBodyPosition;
+
+    auto contentInBuffer = std::min<std::size_t>(_bufferPosition - _headerBytesParsed, GetContentLength());
+
+    return _headerBytesParsed + contentInBuffer;
+}
+
 const std::vector<char>& Request::GetContent() const {
     return _content;
 }
@@ -1,10 +1,13 @@
 #include "Response.h"
+#include "HttpDate.h"
 #include "Log.h"
+#include "StringUtils.h"
+#include "TcpConnection.h"
 
 #include <algorithm>
 #include <array>
+#include <charconv>
 #include <cstring>
-#include <fmt/format.h>
 #include <limits>
 #include <stdexcept>
 #include <string>
@@ -66,6 +69,131 @@ const char* ToString(Status s) {
     return reinterpret_cast<const char*>(pair.at(1));
 }
 
+std::string_view Join(MonotonicArena& arena, std::initializer_list<std::string_view> parts) {
+    std::size_t size = 0;
+
+    for (auto& p : parts)
+        size += p.size();
+
+    auto data = static_cast<char*>(arena.Allocate(size, 1));
+    auto cursor = data;
+
+    for (auto& p : parts) {
+        std::memcpy(cursor, p.data(), p.size());
+        cursor += p.size();
+    }
+
+    return {data, size};
+}
+
+// Smaller content isn't worth compressing
+constexpr std::size_t MinCompressedSize = 0x100;
+
+/**
+ * Copies part of a file to an output that it can't be
+ * sent to directly, through memory. Returns the number
+ * of bytes written, which falls short of the quota if
+ * the output can't take any more data for now.
+ */
+std::size_t CopyFile(FileStream& file, OutputStream& output, std::uint64_t quota, std::uint64_t offset) {
+    char buffer[0x1000];
+    std::size_t bytesWritten = 0;
+
+    while (bytesWritten < quota) {
+        auto length = std::min<std::uint64_t>(quota - bytesWritten, sizeof(buffer));
+        auto bytesRead = file.ReadAt(buffer, length, offset + bytesWritten);
+
+        if (bytesRead == 0)
+            throw std::runtime_error("File ended before all of its content was sent");
+
+        auto written = output.Write(buffer, bytesRead);
+        bytesWritten += written;
+
+        if (written < bytesRead)
+            break;
+    }
+
+    return bytesWritten;
+}
+
+/**
+ * Gets the value of a header line, which ends with CRLF.
+ */
+std::string_view GetHeaderValue(std::string_view line) {
+    auto value = line.substr(line.find(':') + 1);
+    return Trim(value.substr(0, value.size() - 2));
+}
+
+/**
+ * Returns true for the headers that are
+ * sent along with 304 Not Modified.
+ */
+bool IsNotModifiedHeader(std::string_view name) {
+    for (auto header : {"Cache-Control", "Content-Location", "Date", "ETag", "Expires", "Last-Modified", "Vary"}) {
+        if (EqualsIgnoreCase(name, header))
+            return true;
+    }
+
+    return false;
+}
+
+/**
+ * Makes an entity tag out of the specified numbers, e.g.
+ * "5e0f3a1b-1c4", with the last one padded to the
+ * specified width.
+ */
+std::string MakeETag(std::initializer_list<std::uint64_t> parts, std::size_t lastWidth = 0) {
+    char buffer[64];
+    auto cursor = buffer;
+    auto count = std::size_t(0);
+
+    *cursor++ = '"';
+
+    for (auto part : parts) {
+        if (count++)
+            *cursor++ = '-';
+
+        auto end = std::to_chars(cursor, buffer + sizeof(buffer) - 1, part, 16).ptr;
+        auto width = static_cast<std::size_t>(end - cursor);
+
+        if (count == parts.size() && width < lastWidth) {
+            std::memmove(cursor + lastWidth - width, cursor, width);
+            std::memset(cursor, '0', lastWidth - width);
+            end = cursor + lastWidth;
+        }
+
+        cursor = end;
+    }
+
+    *cursor++ = '"';
+
+    return {buffer, static_cast<std::size_t>(cursor - buffer)};
+}
+
+/**
+ * Returns true if the list of entity tags, as in If-None-Match,
+ * includes the specified one, ignoring whether either is weak.
+ */
+bool MatchesETag(std::string_view list, std::string_view etag) {
+    auto removeWeak = [](std::string_view tag) {
+        if (tag.substr(0, 2) == "W/")
+            tag.remove_prefix(2);
+
+        return tag;
+    };
+
+    etag = removeWeak(etag);
+
+    while (!list.empty()) {
+        auto tag = PopListElement(list);
+
+        if (tag == "*" || removeWeak(tag) == etag)
+            return true;
+    }
+
+    return false;
+}
+
 std::string CookieDate(const std::time_t& t) {
     char buffer[] = "Wdy, DD Mon YYYY HH:MM:SS GMT";
     struct tm tm;
@@ -82,14 +210,332 @@ std::string CookieDate(const std::time_t& t) {
 } // unnamed namespace
 
 Response::Response(std::shared_ptr<OutputStream> stream,
-                   std::weak_ptr<Signal<>> readyToWrite)
+                   std::weak_ptr<Signal<>> readyToWrite,
+                   SlabAllocator<CachedResponse> allocator,
+                   MonotonicArena* arena)
     : _stream(std::move(stream))
-    , _readyToWrite(std::move(readyToWrite)) {}
+    , _readyToWrite(std::move(readyToWrite))
+    , _allocator(std::move(allocator))
+    , _arena(arena)
+    , _headers(arena) {}
+
+std::size_t CachedResponse::GetSize() const {
+    std::size_t size = 0;
+
+    // The images might be getting refreshed
+    if (auto wire = std::atomic_load(&_wire))
+        size += wire->size() + std::atomic_load(&_closeWire)->size();
+
+    if (_strBody)
+        size += _strBody->size();
+    else if (_body)
+        size += _body->size();
+
+    return size;
+}
+
+std::shared_ptr<const std::string> CachedResponse::GetWire(bool keepAlive) {
+    auto& image = keepAlive ? _wire : _closeWire;
+    auto wire = std::atomic_load(&image);
+    auto date = _date.load(std::memory_order_relaxed);
+
+    if (!wire || !_dateOffset || date == ::time(nullptr))
+        return wire;
+
+    // The images are shared by all channels, so they're
+    // never patched in place. Whoever gets to refresh them
+    // publishes new copies, while the others keep sending
+    // the old ones in the meantime.
+    char buffer[HttpDate::Length];
+    auto now = HttpDate::Get(buffer);
+
+    if (now != date && _date.compare_exchange_strong(date, now)) {
+        for (auto wire : {&_wire, &_closeWire}) {
+            auto refreshed = std::make_shared<std::string>(*std::atomic_load(wire));
+            refreshed->replace(_dateOffset, HttpDate::Length, buffer, HttpDate::Length);
+            std::atomic_store(wire, std::shared_ptr<const std::string>(std::move(refreshed)));
+        }
+    }
+
+    return std::atomic_load(&image);
+}
+
+std::shared_ptr<CachedResponse> CachedResponse::GetCompressed(Compression compression) {
+    auto& variant = _compressed[static_cast<std::size_t>(compression) - 1];
+    std::call_once(variant.Once, [&] { variant.Response = Compress(compression); });
+    return variant.Response;
+}
+
+std::shared_ptr<CachedResponse> CachedResponse::Compress(Compression compression) {
+    auto wire = std::atomic_load(&_wire);
+
+    if (!wire || _file)
+        return nullptr;
+
+    auto head = std::string_view(*wire).substr(0, wire->size() - _bodySize);
+    auto body = std::string_view(*wire).substr(head.size());
+
+    if (body.size() < MinCompressedSize)
+        return nullptr;
+
+    auto compressed = std::vector<char>();
+    Compressor(compression).Compress(body, compressed, true);
+
+    if (compressed.size() >= body.size())
+        return nullptr;
+
+    // Same headers, in the same order, so that
+    // the Date header stays where it was.
+    auto newHead = std::string();
+    auto hasVary = false;
+    auto lines = head.substr(0, head.size() - 2);
+
+    newHead.reserve(head.size() + 0x40);
+
+    for (std::size_t position = 0; position < lines.size();) {
+        auto end = lines.find("\r\n", position) + 2;
+        auto line = lines.substr(position, end - position);
+
+        position = end;
+
+        if (IsHeader(line, "Content-Encoding"))
+            return nullptr; // already encoded
+        else if (IsHeader(line, "Content-Length"))
+            continue;
+
+        // The compressed content is a different
+        // representation, so it needs its own tag.
+        if (auto etag = GetHeaderValue(line); IsHeader(line, "ETag") && etag.size() > 1 && etag.back() == '"') {
+            newHead += "ETag: ";
+            newHead += etag.substr(0, etag.size() - 1);
+            newHead += '-';
+            newHead += Compressor::GetName(compression);
+            newHead += "\"\r\n";
+            continue;
+        }
+
+        if (IsHeader(line, "Vary")) {
+            hasVary = true;
+
+            if (!HasToken(GetHeaderValue(line), "Accept-Encoding")) {
+                newHead += line.substr(0, line.size() - 2);
+                newHead += ", Accept-Encoding\r\n";
+                continue;
+            }
+        }
+
+        newHead += line;
+    }
+
+    char length[24];
+    auto lengthEnd = std::to_chars(length, std::end(length), compressed.size()).ptr;
+
+    if (!hasVary)
+        newHead += "Vary: Accept-Encoding\r\n";
+
+    newHead += "Content-Encoding: ";
+    newHead += Compressor::GetName(compression);
+    newHead += "\r\nContent-Length: ";
+    newHead.append(length, lengthEnd);
+    newHead += "\r\n\r\n";
+
+    auto variant = std::make_shared<CachedResponse>();
+    variant->_transferMode = _transferMode;
+    variant->_status = _status;
+    variant->_keepAlive = _keepAlive;
+    variant->_dateOffset = _dateOffset;
+    variant->_date = _date.load();
+    variant->SetWire(newHead, {compressed.data(), compressed.size()});
+
+    return variant;
+}
+
+std::shared_ptr<CachedResponse> CachedResponse::GetNotModified() {
+    std::call_once(_notModified.Once, [&] { _notModified.Response = MakeNotModified(); });
+    return _notModified.Response;
+}
+
+std::shared_ptr<CachedResponse> CachedResponse::MakeNotModified() {
+    auto wire = std::atomic_load(&_wire);
+    auto head = std::string_view(*wire).substr(0, wire->size() - _bodySize);
+    auto statusLineSize = head.find("\r\n") + 2;
+    auto lines = head.substr(statusLineSize, head.size() - statusLineSize - 2);
+    auto newHead = HttpVersion + " " + ToString(Status::NotModified) + "\r\n";
+    auto newStatusLineSize = newHead.size();
+
+    // Same headers, in the same order, so that
+    // the Date header stays where it was.
+    for (std::size_t position = 0; position < lines.size();) {
+        auto end = lines.find("\r\n", position) + 2;
+        auto line = lines.substr(position, end - position);
+
+        position = end;
+
+        if (IsNotModifiedHeader(line.substr(0, line.find(':'))))
+            newHead += line;
+    }
+
+    newHead += "\r\n";
+
+    auto variant = std::make_shared<CachedResponse>();
+    variant->_transferMode = TransferMode::Normal;
+    variant->_status = Status::NotModified;
+    variant->_keepAlive = _keepAlive;
+    variant->_dateOffset = _dateOffset ? _dateOffset - statusLineSize + newStatusLineSize : 0;
+    variant->_date = _date.load();
+    variant->SetWire(newHead, {});
+
+    return variant;
+}
+
+void CachedResponse::SetWire(std::string_view header, std::string_view body) {
+    auto closeConnection = std::string_view("Connection: close\r\n\r\n");
+    auto lines = header.substr(0, header.size() - 2);
+
+    // Leave out any Connection header, as it's
+    // added below, depending on the variant.
+    auto head = std::string();
+    head.reserve(header.size() + 0x20);
+
+    for (std::size_t position = 0; position < lines.size();) {
+        auto end = lines.find("\r\n", position) + 2;
+        auto line = lines.substr(position, end - position);
+
+        position = end;
+
+        if (IsHeader(line, "Connection"))
+            continue;
+        else if (IsHeader(line, "ETag"))
+            _etag = GetHeaderValue(line);
+        else if (IsHeader(line, "Last-Modified"))
+            _lastModified = GetHeaderValue(line);
+
+        head += line;
+    }
+
+    // Let clients revalidate their copies cheaply
+    if (_etag.empty() && _status == Status::Ok && !_file) {
+        // The hash has a fixed width, so that it
+        // doesn't make the size of responses vary.
+        _etag = MakeETag({body.size(), std::hash<std::string_view>()(body)}, 16);
+        head += "ETag: ";
+        head += _etag;
+        head += "\r\n";
+    }
+
+    head += "\r\n";
+
+    auto closeHead = std::string_view(head).substr(0, head.size() - 2);
+
+    auto wire = std::make_shared<std::string>();
+    wire->reserve(head.size() + body.size());
+    *wire += head;
+    *wire += body;
+
+    auto closeWire = std::make_shared<std::string>();
+    closeWire->reserve(closeHead.size() + closeConnection.size() + body.size());
+    *closeWire += closeHead;
+    *closeWire += closeConnection;
+    *closeWire += body;
+
+    // Everything needed is in the wire images now,
+    // and they may be replaced once their date is
+    // refreshed, so nothing may point into them.
+    _wire = std::move(wire);
+    _closeWire = std::move(closeWire);
+    _bodySize = body.size();
+    _header = {};
+    _strBody.reset();
+    _body.reset();
+}
 
 void Response::Reset() {
     auto stream = std::move(_stream);
     auto readyToWrite = std::move(_readyToWrite);
-    *this = Response(std::move(stream), std::move(readyToWrite));
+    auto allocator = std::move(_allocator);
+    auto minChunkSize = _minChunkBufferSize;
+    auto maxChunkSize = _maxChunkBufferSize;
+    *this = Response(std::move(stream), std::move(readyToWrite), std::move(allocator), _arena);
+    SetChunkSize(minChunkSize, maxChunkSize);
+}
+
+void Response::SetCompression(Compression compression) {
+    _compression = compression;
+}
+
+void Response::Compress(std::string_view acceptEncoding) {
+    auto& headers = GetHeaders();
+    auto vary = std::find_if(headers.begin(), headers.end(), [](auto& header) {
+        return EqualsIgnoreCase(header.first, "Vary");
+    });
+
+    if (vary == headers.end())
+        AppendHeader("Vary", "Accept-Encoding");
+    else if (!HasToken(vary->second, "Accept-Encoding"))
+        vary->second = Join(GetArena(), {vary->second, ", Accept-Encoding"});
+
+    SetCompression(Compressor::Negotiate(acceptEncoding));
+}
+
+bool Response::IsNotModified(std::string_view ifNoneMatch, std::string_view ifModifiedSince) const {
+    std::string_view etag;
+    std::string_view lastModified;
+
+    if (_wire) {
+        etag = _response->_etag;
+        lastModified = _response->_lastModified;
+    } else {
+        GetHeader("ETag", &etag);
+        GetHeader("Last-Modified", &lastModified);
+    }
+
+    // When both are sent, the
+    // entity tag is what counts
+    if (!Trim(ifNoneMatch).empty())
+        return !etag.empty() && MatchesETag(ifNoneMatch, etag);
+
+    std::time_t since;
+    std::time_t modified;
+
+    return !lastModified.empty() &&
+           HttpDate::Parse(Trim(ifModifiedSince), since) &&
+           HttpDate::Parse(lastModified, modified) &&
+           modified <= since;
+}
+
+void Response::SetNotModified() {
+    if (!_prepared)
+        throw std::logic_error("Response has not been prepared");
+
+    if (_wire) {
+        UseCached(_response->GetNotModified());
+        return;
+    }
+
+    auto& state = GetState();
+    auto& headers = GetHeaders();
+
+    headers.erase(std::remove_if(headers.begin(), headers.end(), [](auto& header) {
+        return !IsNotModifiedHeader(header.first) && !EqualsIgnoreCase(header.first, "Connection");
+    }), headers.end());
+
+    state._transferMode = TransferMode::Normal;
+    state._stream.reset();
+    state._strBody.reset();
+    state._body.reset();
+    state._file.reset();
+    _compressor.reset();
+
+    Prepare(Status::NotModified);
+}
+
+void Response::SetChunkSize(std::size_t size, std::size_t maxSize) {
+    if (!size)
+        throw std::logic_error("Chunk size must not be 0");
+
+    _chunkBufferSize = size;
+    _minChunkBufferSize = size;
+    _maxChunkBufferSize = std::max(size, maxSize);
 }
 
 void Response::SetStatus(Status status) {
@@ -102,9 +548,87 @@ bool Response::IsPrepared() const {
     return _prepared;
 }
 
+bool Response::IsBuffered() const {
+    auto& state = GetState();
+    return state._transferMode == TransferMode::Normal && !state._file;
+}
+
+std::size_t Response::GatherData(std::vector<std::pair<const void*, std::size_t>>& vec, std::size_t maxBytes) const {
+    auto header = GetHead();
+    auto body = GetBufferedBody();
+    auto quota = maxBytes;
+
+    if (_writePosition < header.size() && quota > 0) {
+        auto headerQuota = std::min(quota, header.size() - _writePosition);
+        vec.push_back(std::make_pair(header.data() + _writePosition, headerQuota));
+        quota -= headerQuota;
+    }
+
+    auto bodyPosition = _writePosition > header.size() ? _writePosition - header.size() : 0;
+
+    if (bodyPosition < body.size() && quota > 0) {
+        auto bodyQuota = std::min(quota, body.size() - bodyPosition);
+        vec.push_back(std::make_pair(body.data() + bodyPosition, bodyQuota));
+        quota -= bodyQuota;
+    }
+
+    return maxBytes - quota;
+}
+
+std::size_t Response::ConsumeData(std::size_t bytesWritten) {
+    auto total = GetHead().size() + GetBufferedBody().size();
+    auto consumed = std::min(bytesWritten, total - _writePosition);
+
+    _writePosition += consumed;
+
+    return consumed;
+}
+
+bool Response::IsFlushed() const {
+    return _writePosition == GetHead().size() + GetBufferedBody().size();
+}
+
+std::string_view Response::GetHead() const {
+    if (_wire)
+        return *_wire;
+    else
+        return GetState()._header;
+}
+
+std::string_view Response::GetBufferedBody() const {
+    auto& state = GetState();
+
+    if (_wire)
+        return {};
+    else if (state._strBody)
+        return *state._strBody;
+    else if (state._body)
+        return {state._body->data(), state._body->size()};
+    else
+        return {};
+}
+
 void Response::UseCached(std::shared_ptr<CachedResponse> cr) {
+    auto keepAlive = !_response || GetKeepAlive();
+
+    if (_compression != Compression::None) {
+        if (auto compressed = cr->GetCompressed(_compression))
+            cr = std::move(compressed);
+    }
+
     _response = std::move(cr);
     _prepared = true;
+
+    _wire = _response->GetWire(keepAlive);
+    _wireKeepAlive = keepAlive;
+}
+
+void Response::SetCacheTtl(std::chrono::milliseconds ttl) {
+    _cacheTtl = ttl;
+}
+
+std::chrono::milliseconds Response::GetCacheTtl() const {
+    return _cacheTtl;
 }
 
 std::shared_ptr<CachedResponse> Response::Cache() {
@@ -114,35 +638,149 @@ std::shared_ptr<CachedResponse> Response::Cache() {
     if (!_prepared)
         throw std::logic_error("Response attempted to be cached before being fully prepared");
 
+    if (_wire)
+        return _response;
+
+    // File content is sent from the file every time,
+    // so only the head goes into the wire images.
+    Freeze();
+
     return _response;
 }
 
+void Response::Freeze() {
+    auto& state = GetState();
+
+    state.SetWire(state._header, GetBufferedBody());
+
+    _wireKeepAlive = state._keepAlive;
+    _wire = _wireKeepAlive ? state._wire : state._closeWire;
+}
+
 void Response::Prepare(Status status) {
-    fmt::MemoryWriter w;
+    auto& state = GetState();
+    std::string_view contentEncoding;
+
+    if (_compression != Compression::None && !state._file && !GetHeader("Content-Encoding", &contentEncoding)) {
+        if (state._transferMode == TransferMode::Chunked) {
+            _compressor = std::make_unique<Compressor>(_compression);
+            AppendHeader("Content-Encoding", Compressor::GetName(_compression));
+        } else if (auto body = GetBufferedBody(); body.size() >= MinCompressedSize) {
+            auto compressed = std::make_shared<std::vector<char>>();
+            Compressor(_compression).Compress(body, *compressed, true);
+
+            if (compressed->size() < body.size()) {
+                state._strBody.reset();
+                state._body = std::move(compressed);
+                AppendHeader("Content-Encoding", Compressor::GetName(_compression));
+            }
+        }
+    }
+
+    if (state._file && status == Status::Ok) {
+        std::string_view value;
+        auto modified = state._file->GetModificationTime();
 
-    w.write("{} {}\r\n", HttpVersion, ToString(status));
+        if (!GetHeader("ETag", &value)) {
+            if (state._fileOffset)
+                AppendHeader("ETag", MakeETag({static_cast<std::uint64_t>(modified), state._fileLength, state._fileOffset}));
+            else
+                AppendHeader("ETag", MakeETag({static_cast<std::uint64_t>(modified), state._fileLength}));
+        }
+
+        if (!GetHeader("Last-Modified", &value)) {
+            char date[HttpDate::Length];
+            HttpDate::Format(modified, date);
+            AppendHeader("Last-Modified", {date, sizeof(date)});
+        }
+    }
+    auto statusString = std::string_view(ToString(status));
+
+    // Compute the size of the header first, so
+    // that it's written into the arena in one go.
+    auto size = HttpVersion.size() + 1 + statusString.size() + 2;
 
-    for (auto& [name, value] : _headers)
-        w.write("{}: {}\r\n", name, value);
+    auto statusLineSize = size;
+    auto dateName = std::string_view("Date: ");
+    auto hasDate = false;
 
-    if (GetState()._transferMode == TransferMode::Normal) {
-        std::size_t contentLength;
+    for (auto& [name, value] : _headers) {
+        size += name.size() + 2 + value.size() + 2;
 
-        if (GetState()._strBody)
-            contentLength = GetState()._strBody->size();
-        else if (GetState()._body)
-            contentLength = GetState()._body->size();
+        if (EqualsIgnoreCase(name, "Date"))
+            hasDate = true;
+    }
+
+    char date[HttpDate::Length];
+
+    // Unless the handler has its own
+    if (!hasDate) {
+        state._date = HttpDate::Get(date);
+        state._dateOffset = statusLineSize + dateName.size();
+        size += dateName.size() + sizeof(date) + 2;
+    } else {
+        state._dateOffset = 0;
+    }
+
+    char contentLength[24];
+    auto contentLengthEnd = contentLength;
+    auto contentLengthName = std::string_view("Content-Length: ");
+    auto hasContentLength = state._transferMode == TransferMode::Normal && status != Status::NotModified;
+
+    if (hasContentLength) {
+        std::size_t length;
+
+        if (state._strBody)
+            length = state._strBody->size();
+        else if (state._body)
+            length = state._body->size();
+        else if (state._file)
+            length = state._fileLength;
         else
-            contentLength = 0;
+            length = 0;
 
-        w.write("Content-Length: {}\r\n", contentLength);
+        contentLengthEnd = std::to_chars(contentLength, std::end(contentLength), length).ptr;
+        size += contentLengthName.size() + (contentLengthEnd - contentLength) + 2;
     }
 
-    w.write("\r\n");
+    size += 2;
+
+    auto header = static_cast<char*>(GetArena().Allocate(size, 1));
+    auto cursor = header;
+
+    auto write = [&](std::string_view s) {
+        std::memcpy(cursor, s.data(), s.size());
+        cursor += s.size();
+    };
 
-    GetState()._header = w.str();
+    write(HttpVersion);
+    write(" ");
+    write(statusString);
+    write("\r\n");
 
-    GetState()._status = status;
+    if (!hasDate) {
+        write(dateName);
+        write({date, sizeof(date)});
+        write("\r\n");
+    }
+
+    for (auto& [name, value] : _headers) {
+        write(name);
+        write(": ");
+        write(value);
+        write("\r\n");
+    }
+
+    if (hasContentLength) {
+        write(contentLengthName);
+        write({contentLength, static_cast<std::size_t>(contentLengthEnd - contentLength)});
+        write("\r\n");
+    }
+
+    write("\r\n");
+
+    state._header = {header, size};
+    state._status = status;
 
     _prepared = true;
 }
@@ -150,11 +788,16 @@ void Response::Prepare(Status status) {
 Response::FlushStatus Response::Flush(std::size_t maxBytes, std::size_t& totalBytesWritten) {
    auto& response = GetState();
 
+   if (_wire && !response._file)
+       return FlushWire(maxBytes, totalBytesWritten);
+
    if (response._transferMode == TransferMode::Normal) {
        if (response._strBody)
            return FlushBody(*response._strBody, maxBytes, totalBytesWritten);
        else if (response._body)
            return FlushBody(*response._body, maxBytes, totalBytesWritten);
+       else if (response._file)
+           return FlushFile(maxBytes, totalBytesWritten);
        else
            return FlushWithHeader(std::string(), maxBytes, totalBytesWritten);
    } else if (response._transferMode == TransferMode::Chunked) {
@@ -169,8 +812,7 @@ Response::FlushStatus Response::Flush(std::size_t maxBytes, std::size_t& totalBy
 
 template <class T>
 Response::FlushStatus Response::FlushWithHeader(const T& data, std::size_t& maxBytes, std::size_t& totalBytesWritten) {
-    auto& response = GetState();
-    auto& header = response._header;
+    auto header = GetHead();
 
     if (_writePosition >= header.size())
         Log::Fatal("Invalid call to Response::FlushWithHeader()");
@@ -181,7 +823,7 @@ Response::FlushStatus Response::FlushWithHeader(const T& data, std::size_t& maxB
 
     if (maxBytes <= headerBytesRemaining || data.empty()) {
         auto quota = std::min(maxBytes, headerBytesRemaining);
-        vec.push_back(std::make_pair(header.c_str() + _writePosition, quota));
+        vec.push_back(std::make_pair(header.data() + _writePosition, quota));
     } else {
         auto dataQuota = std::min(data.size(), maxBytes - headerBytesRemaining);
 
@@ -244,213 +886,361 @@ Response::FlushStatus Response::FlushBody(const T& body, std::size_t& maxBytes,
     }
 }
 
-Response::FlushStatus Response::FlushStream(std::size_t& maxBytes, std::size_t& totalBytesWritten) {
-    auto& response = GetState();
-    auto& header = response._header;
+Response::FlushStatus Response::FlushWire(std::size_t& maxBytes, std::size_t& totalBytesWritten) {
+    auto quota = std::min(maxBytes, _wire->size() - _writePosition);
+    auto bytesWritten = _stream->Write(_wire->data() + _writePosition, quota);
 
-    if (_writePosition < header.size()) {
-        auto result = FlushWithHeader(std::string(), maxBytes, totalBytesWritten);
-
-        if (result != FlushStatus::Done)
-            return result;
+    totalBytesWritten += bytesWritten;
+    _writePosition += bytesWritten;
+    maxBytes -= bytesWritten;
 
-        if (maxBytes == 0)
+    if (_writePosition == _wire->size()) {
+        return FlushStatus::Done;
+    } else {
+        if (maxBytes > 0)
+            return FlushStatus::IncompleteWrite;
+        else
             return FlushStatus::ReachedQuota;
     }
+}
 
-    if (_needNewChunk) {
-        auto result = ReadNextChunk();
+Response::FlushStatus Response::FlushStream(std::size_t& maxBytes, std::size_t& totalBytesWritten) {
+    auto& header = GetState()._header;
 
-        if (result == ReadResult::Buffering)
-            return FlushStatus::WaitingForContent;
-    }
+    // Keep sending chunks for as long as the
+    // socket takes them and there's quota left.
+    for (;;) {
+        if (_chunksWritePosition == _chunksWireSize) {
+            if (_isLastChunk)
+                return FlushStatus::Done;
 
-    auto bytesWritten = _stream->WriteVector(GetChunkVector(maxBytes));
+            if (maxBytes == 0)
+                return FlushStatus::ReachedQuota;
 
-    maxBytes -= bytesWritten;
-    totalBytesWritten += bytesWritten;
+            if (ReadChunks(maxBytes) == ReadResult::Buffering)
+                return FlushStatus::WaitingForContent;
+        }
 
-    UpdateChunkWritePositions(bytesWritten);
+        auto vec = GetChunkVector(maxBytes);
+        auto bytesRequested = std::size_t(0);
 
-    if (_chunkWritePosition < _chunkSize || _chunkTrailWritePosition < 2) {
-        if (maxBytes > 0)
+        for (auto& [data, size] : vec)
+            bytesRequested += size;
+
+        auto bytesWritten = _stream->WriteVector(std::move(vec));
+
+        maxBytes -= bytesWritten;
+        totalBytesWritten += bytesWritten;
+
+        auto headerBytesWritten = std::min(bytesWritten, header.size() - std::min(_writePosition, header.size()));
+        _writePosition += headerBytesWritten;
+        _chunksWritePosition += bytesWritten - headerBytesWritten;
+
+        if (bytesWritten < bytesRequested) {
+            _socketKeepingUp = false;
+            ShrinkChunkSize();
             return FlushStatus::IncompleteWrite;
-        else
-            return FlushStatus::ReachedQuota;
-    } else {
-        if (_isLastChunk) {
-            return FlushStatus::Done;
-        } else {
-            _needNewChunk = true;
-            return FlushStatus::Repeat;
         }
+
+        _socketKeepingUp = true;
+
+        if (_chunksWritePosition < _chunksWireSize || _writePosition < header.size())
+            return FlushStatus::ReachedQuota;
     }
 }
 
-void Response::UpdateChunkWritePositions(std::size_t bytesWritten) {
-    if (_chunkHeaderWritePosition < _chunkHeader.size()) {
-        auto chunkHeaderRemaining = _chunkHeader.size() - _chunkHeaderWritePosition;
-        auto chunkHeaderWritten = std::min(bytesWritten, chunkHeaderRemaining);
+Response::FlushStatus Response::FlushFile(std::size_t& maxBytes, std::size_t& totalBytesWritten) {
+    auto& response = GetState();
+    auto header = GetHead();
+    auto connection = dynamic_cast<TcpConnection*>(_stream.get());
+
+    if (_writePosition < header.size()) {
+        // Hold the header back, so that it's sent
+        // in the same packet as the start of the file.
+        if (connection && _writePosition == 0 && response._fileLength)
+            connection->Cork(true);
 
-        _chunkHeaderWritePosition += chunkHeaderWritten;
-        bytesWritten -= chunkHeaderWritten;
+        auto result = FlushWithHeader(std::string(), maxBytes, totalBytesWritten);
+
+        if (result != FlushStatus::Done)
+            return result;
 
-        if (bytesWritten == 0 || _chunkHeaderWritePosition < _chunkHeader.size())
-            return;
+        if (maxBytes == 0)
+            return FlushStatus::ReachedQuota;
     }
 
-    if (_chunkWritePosition < _chunkSize) {
-        auto chunkBodyRemaining = _chunkSize - _chunkWritePosition;
-        auto chunkBodyWritten = std::min(bytesWritten, chunkBodyRemaining);
+    auto bodyBytesConsumed = _writePosition - header.size();
+    auto offset = response._fileOffset + bodyBytesConsumed;
+    auto quota = std::min<std::uint64_t>(maxBytes, response._fileLength - bodyBytesConsumed);
+    std::size_t bytesWritten;
 
-        _chunkWritePosition += chunkBodyWritten;
-        bytesWritten -= chunkBodyWritten;
+    try {
+        if (auto output = dynamic_cast<FileStream*>(_stream.get()))
+            bytesWritten = response._file->WriteTo(*output, quota, offset);
+        else
+            bytesWritten = CopyFile(*response._file, *_stream, quota, offset);
+    } catch (...) {
+        // Whatever was held back has to go out anyway
+        if (connection && response._fileLength)
+            connection->Cork(false);
 
-        if (bytesWritten == 0 || _chunkWritePosition < _chunkSize)
-            return;
+        throw;
     }
 
-    if (_chunkTrailWritePosition < 2) {
-        auto chunkTrailRemaining = 2 - _chunkTrailWritePosition;
-        auto chunkTrailWritten = std::min(bytesWritten, chunkTrailRemaining);
+    totalBytesWritten += bytesWritten;
+    _writePosition += bytesWritten;
+    maxBytes -= bytesWritten;
+
+    auto sentAll = (_writePosition - header.size()) == response._fileLength;
+
+    if (sentAll) {
+        if (connection && response._fileLength)
+            connection->Cork(false);
 
-        _chunkTrailWritePosition += chunkTrailWritten;
+        return FlushStatus::Done;
+    } else {
+        if (maxBytes > 0)
+            return FlushStatus::IncompleteWrite;
+        else
+            return FlushStatus::ReachedQuota;
     }
 }
 
-Response::ReadResult Response::ReadNextChunk() {
+Response::ReadResult Response::ReadChunks(std::size_t maxBytes) {
     auto& response = GetState();
     auto& input = response._stream;
     auto& buffer = response._body;
+    auto bufferedInput = std::dynamic_pointer_cast<BufferedInputStream>(input);
+    auto maxWireSize = std::min(maxBytes, GetSendBufferSize());
+    auto bufferPosition = std::size_t(0);
+
+    _chunks.clear();
+    _chunksWireSize = 0;
+    _chunksWritePosition = 0;
+
+    auto addChunk = [&](std::size_t size) {
+        auto& chunk = _chunks.emplace_back();
+        auto [end, ec] = std::to_chars(chunk.Header, chunk.Header + sizeof(chunk.Header) - 2, size, 16);
+        std::memcpy(end, "\r\n", 2);
+
+        chunk.HeaderSize = end + 2 - chunk.Header;
+        chunk.Offset = bufferPosition;
+        chunk.Size = size;
+
+        bufferPosition += size;
+        _chunksWireSize += chunk.HeaderSize + size + 2;
+    };
+
+    do {
+        if (input->EndOfStream()) {
+            if (_compressor) {
+                // The end of the compressed
+                // data needs a chunk of its own
+                buffer->resize(bufferPosition);
+                _compressor->Compress({}, *buffer, true);
+                addChunk(buffer->size() - bufferPosition);
+            }
 
-    if (input->EndOfStream()) {
-        _chunkHeader = "0\r\n";
-        _chunkSize = 0;
-        _chunkWritePosition = 0;
-        _chunkHeaderWritePosition = 0;
-        _chunkTrailWritePosition = 0;
-        _needNewChunk = false;
-        _isLastChunk = true;
-        return ReadResult::DataAvailable;
-    }
+            addChunk(0);
+            _isLastChunk = true;
+            break;
+        }
+
+        if (bufferedInput && bufferedInput->GetBufferedInputSize() == 0) {
+            // Send whatever there is before waiting
+            if (!_chunks.empty() || _writePosition < response._header.size())
+                break;
 
-    if (auto bufferedInput = std::dynamic_pointer_cast<BufferedInputStream>(input)) {
-        if (bufferedInput->GetBufferedInputSize() == 0) {
             bufferedInput->BufferInputAsync();
             return ReadResult::Buffering;
         }
-    }
 
-    _chunkSize = input->Read(buffer->data(), buffer->size());
-    _chunkHeader = fmt::format("{:X}\r\n", _chunkSize);
+        std::size_t size;
+
+        if (_compressor) {
+            auto& raw = _uncompressedChunk;
+            raw.resize(_chunkBufferSize);
+            raw.resize(input->Read(raw.data(), raw.size()));
+
+            buffer->resize(bufferPosition);
+            _compressor->Compress({raw.data(), raw.size()}, *buffer, false);
+            size = buffer->size() - bufferPosition;
+        } else {
+            if (buffer->size() < bufferPosition + _chunkBufferSize)
+                buffer->resize(bufferPosition + _chunkBufferSize);
+
+            size = input->Read(buffer->data() + bufferPosition, _chunkBufferSize);
+        }
+
+        if (size == 0 && !_chunks.empty())
+            break;
 
-    _chunkWritePosition = 0;
-    _chunkHeaderWritePosition = 0;
-    _chunkTrailWritePosition = 0;
-    _needNewChunk = false;
+        addChunk(size);
+
+        if (_socketKeepingUp)
+            GrowChunkSize();
+    } while (_chunks.size() < MaxGatheredChunks && _chunksWireSize < maxWireSize);
 
     return ReadResult::DataAvailable;
 }
 
-std::vector<std::pair<const void*, std::size_t>> Response::GetChunkVector(std::size_t maxBytes) {
-    auto vec = std::vector<std::pair<const void*, std::size_t>>();
+void Response::GrowChunkSize() {
+    // No point in growing past what
+    // the socket can take at once.
+    auto maxSize = std::max(std::min(_maxChunkBufferSize, GetSendBufferSize()), _minChunkBufferSize);
 
-    auto& chunk = GetState()._body;
-    auto chunkHeaderRemaining = _chunkHeader.size() - _chunkHeaderWritePosition;
-    auto chunkBodyRemaining = _chunkSize - _chunkWritePosition;
+    _chunkBufferSize = std::min(_chunkBufferSize * 2, maxSize);
+}
 
-    if (chunkHeaderRemaining > 0) {
-        auto headerQuota = std::min(maxBytes, chunkHeaderRemaining);
-        vec.push_back(std::make_pair(_chunkHeader.data() + _chunkHeaderWritePosition, headerQuota));
+void Response::ShrinkChunkSize() {
+    _chunkBufferSize = std::max(_chunkBufferSize / 2, _minChunkBufferSize);
+}
 
-        maxBytes -= headerQuota;
+std::size_t Response::GetSendBufferSize() {
+    if (!_sendBufferSize) {
+        if (auto connection = dynamic_cast<TcpConnection*>(_stream.get()))
+            _sendBufferSize = connection->GetSendBufferSize();
+        else
+            _sendBufferSize = std::numeric_limits<std::size_t>::max();
+    }
 
-        if (_chunkSize > 0 && maxBytes > 0) {
-            auto dataQuota = std::min(maxBytes, _chunkSize);
-            vec.push_back(std::make_pair(chunk->data(), dataQuota));
+    return _sendBufferSize;
+}
 
-            maxBytes -= dataQuota;
+std::vector<std::pair<const void*, std::size_t>> Response::GetChunkVector(std::size_t maxBytes) const {
+    auto vec = std::vector<std::pair<const void*, std::size_t>>();
+    auto& response = GetState();
+    auto& header = response._header;
+    auto& buffer = *response._body;
 
-            if (maxBytes > 0) {
-                auto quota = std::min(maxBytes, 2lu);
-                vec.push_back(std::make_pair("\r\n", quota));
-            }
-        }
-    } else if (chunkBodyRemaining > 0) {
-        auto quota = std::min(maxBytes, chunkBodyRemaining);
-        vec.push_back(std::make_pair(chunk->data() + _chunkWritePosition, quota));
+    vec.reserve(1 + 3 * _chunks.size());
 
-        maxBytes -= quota;
+    auto add = [&](const void* data, std::size_t size) {
+        auto quota = std::min(maxBytes, size);
 
-        if (maxBytes > 0) {
-            auto quota = std::min(maxBytes, 2lu);
-            vec.push_back(std::make_pair("\r\n", quota));
+        if (quota > 0) {
+            vec.push_back(std::make_pair(data, quota));
+            maxBytes -= quota;
         }
-    } else {
-        auto chunkTrailRemaining = 2lu - _chunkTrailWritePosition;
-        auto quota = std::min(maxBytes, chunkTrailRemaining);
-        auto trail = "\r\n";
-        vec.push_back(std::make_pair(trail + _chunkTrailWritePosition, quota));
+    };
+
+    if (_writePosition < header.size())
+        add(header.data() + _writePosition, header.size() - _writePosition);
+
+    // Skip whatever was already written
+    auto skip = _chunksWritePosition;
+
+    auto addPart = [&](const char* data, std::size_t size) {
+        auto skipped = std::min(skip, size);
+        skip -= skipped;
+        add(data + skipped, size - skipped);
+    };
+
+    for (auto& chunk : _chunks) {
+        if (maxBytes == 0)
+            break;
+
+        addPart(chunk.Header, chunk.HeaderSize);
+        addPart(buffer.data() + chunk.Offset, chunk.Size);
+        addPart("\r\n", 2);
     }
 
     return vec;
 }
 
 bool Response::GetKeepAlive() const {
-    return GetState()._keepAlive;
+    if (_wire)
+        return _wireKeepAlive;
+    else
+        return GetState()._keepAlive;
 }
 
 void Response::CloseConnection() {
+    // A cached response is shared, so
+    // just pick the variant to send.
+    if (_wire) {
+        _wire = _response->GetWire(false);
+        _wireKeepAlive = false;
+        return;
+    }
+
     AppendHeader("Connection", "close");
     GetState()._keepAlive = false;
 }
 
 void Response::KeepConnectionAlive() {
+    if (_wire) {
+        _wire = _response->GetWire(true);
+        _wireKeepAlive = true;
+        return;
+    }
+
     AppendHeader("Connection", "keep-alive");
     GetState()._keepAlive = true;
 }
 
-void Response::AppendHeader(std::string name, std::string value) {
-    _headers.emplace_back(std::move(name), std::move(value));
+void Response::AppendHeader(std::string_view name, std::string_view value) {
+    auto& arena = GetArena();
+    GetHeaders().emplace_back(arena.Store(name), arena.Store(value));
+}
+
+bool Response::GetHeader(std::string_view name, std::string_view* value) const {
+    for (auto& [n, v] : _headers) {
+        if (EqualsIgnoreCase(n, name)) {
+            *value = v;
+            return true;
+        }
+    }
+
+    return false;
 }
 
-void Response::SetCookie(std::string name, std::string value) {
-    AppendHeader("Set-Cookie", fmt::format("{}={}", std::move(name), std::move(value)));
+void Response::SetCookie(std::string_view name, std::string_view value) {
+    GetHeaders().emplace_back("Set-Cookie", Join(GetArena(), {name, "=", value}));
 }
 
-void Response::SetCookie(std::string name, std::string value, const CookieOptions& opts) {
-    fmt::MemoryWriter w;
-    std::string stringOpt;
+void Response::SetCookie(std::string_view name, std::string_view value, const CookieOptions& opts) {
+    std::string domain;
+    std::string path;
+    std::string expires;
     std::chrono::seconds durationOpt;
     std::time_t expirationOpt;
+    char maxAgeBuffer[24];
+    std::string_view maxAge;
 
-    if (opts.GetDomain(&stringOpt))
-        w << "; Domain=" << stringOpt;
+    auto hasDomain = opts.GetDomain(&domain);
+    auto hasPath = opts.GetPath(&path);
+    auto hasMaxAge = opts.GetMaxAge(&durationOpt);
+    auto hasExpiration = opts.GetExpiration(&expirationOpt);
 
-    if (opts.GetPath(&stringOpt))
-        w << "; Path=" << stringOpt;
-
-    if (opts.GetMaxAge(&durationOpt))
-        w << "; Max-Age=" << durationOpt.count();
-
-    if (opts.GetExpiration(&expirationOpt))
-        w << "; Expires=" << CookieDate(expirationOpt);
+    if (hasMaxAge) {
+        auto end = std::to_chars(maxAgeBuffer, std::end(maxAgeBuffer), durationOpt.count()).ptr;
+        maxAge = {maxAgeBuffer, static_cast<std::size_t>(end - maxAgeBuffer)};
+    }
 
-    if (opts.IsHttpOnly())
-        w << "; HttpOnly";
+    if (hasExpiration)
+        expires = CookieDate(expirationOpt);
 
-    if (opts.IsSecure())
-        w << "; Secure";
+    auto cookie = Join(GetArena(), {
+        name, "=", value,
+        hasDomain ? "; Domain=" : "", domain,
+        hasPath ? "; Path=" : "", path,
+        hasMaxAge ? "; Max-Age=" : "", maxAge,
+        hasExpiration ? "; Expires=" : "", expires,
+        opts.IsHttpOnly() ? "; HttpOnly" : "",
+        opts.IsSecure() ? "; Secure" : ""
+    });
 
-    AppendHeader("Set-Cookie", fmt::format("{}={}{}", std::move(name), std::move(value), w.str()));
+    GetHeaders().emplace_back("Set-Cookie", cookie);
 }
 
 void Response::SetContent(std::string body) {
     auto& r = GetState();
     r._transferMode = TransferMode::Normal;
-    r._strBody = std::make_shared<std::string>(std::move(body));
+    r._strBody = std::allocate_shared<std::string>(SlabAllocator<std::string>(_allocator), std::move(body));
     r._body.reset();
     r._stream.reset();
+    r._file.reset();
 }
 
 void Response::SetContent(std::shared_ptr<std::vector<char>> body) {
@@ -459,6 +1249,21 @@ void Response::SetContent(std::shared_ptr<std::vector<char>> body) {
     r._body = std::move(body);
     r._strBody.reset();
     r._stream.reset();
+    r._file.reset();
+}
+
+void Response::SetContent(std::shared_ptr<FileStream> file, std::uint64_t offset, std::uint64_t length) {
+    if (offset + length > file->GetSize())
+        throw std::runtime_error("Requested file content is past the end of the file");
+
+    auto& r = GetState();
+    r._transferMode = TransferMode::Normal;
+    r._file = std::move(file);
+    r._fileOffset = offset;
+    r._fileLength = length;
+    r._strBody.reset();
+    r._body.reset();
+    r._stream.reset();
 }
 
 void Response::SetContent(std::shared_ptr<InputStream> stream) {
@@ -475,11 +1280,12 @@ void Response::SetContent(std::shared_ptr<InputStream> stream) {
     r._body = std::make_shared<std::vector<char>>(GetBufferSize()); // use as buffer
     AppendHeader("Transfer-Encoding", "chunked");
     r._strBody.reset();
+    r._file.reset();
 }
 
 std::size_t Response::GetBufferSize() const {
     if (GetState()._transferMode == TransferMode::Chunked)
-        return 0x1000;
+        return _chunkBufferSize;
     else
         return std::numeric_limits<std::size_t>::max();
 }
@@ -488,9 +1294,28 @@ Status Response::GetStatus() const {
     return GetState()._status;
 }
 
+MonotonicArena& Response::GetArena() {
+    if (_arena)
+        return *_arena;
+
+    if (!_ownArena)
+        _ownArena = std::make_shared<MonotonicArena>(SlabAllocator<char>(_allocator));
+
+    return *_ownArena;
+}
+
+Response::HeaderList& Response::GetHeaders() {
+    if (_headers.capacity() == 0) {
+        _headers = HeaderList(&GetArena());
+        _headers.reserve(8);
+    }
+
+    return _headers;
+}
+
 CachedResponse& Response::GetState() const {
     if (!_response)
-        _response = std::make_shared<CachedResponse>();
+        _response = std::allocate_shared<CachedResponse>(_allocator);
     return *_response;
 }
 
@@ -0,0 +1,311 @@
+#include "ResponseCache.h"
+#include "Compressor.h"
+#include "StringUtils.h"
+
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+
+namespace Chili {
+
+namespace {
+
+std::vector<std::string> ParseVary(std::string_view vary) {
+    auto names = std::vector<std::string>();
+
+    while (!vary.empty()) {
+        auto name = PopListElement(vary);
+
+        if (!name.empty())
+            names.emplace_back(name);
+    }
+
+    return names;
+}
+
+} // unnamed namespace
+
+void ResponseCache::FrequencySketch::Increment(std::size_t hash) {
+    for (std::size_t row = 0; row < SketchDepth; ++row) {
+        auto i = GetIndex(hash, row);
+        auto& byte = _counters[i / 2];
+        auto shift = (i % 2) * 4;
+
+        if (((byte >> shift) & 0xf) < 0xf)
+            byte += 1 << shift;
+    }
+
+    // Halve all counters once in a while,
+    // so that old hits count for less.
+    if (++_additions == SketchWidth * 10) {
+        for (auto& byte : _counters)
+            byte = (byte >> 1) & 0x77;
+
+        _additions /= 2;
+    }
+}
+
+unsigned ResponseCache::FrequencySketch::Estimate(std::size_t hash) const {
+    auto result = 0xfu;
+
+    for (std::size_t row = 0; row < SketchDepth; ++row) {
+        auto i = GetIndex(hash, row);
+        auto count = (_counters[i / 2] >> ((i % 2) * 4)) & 0xfu;
+
+        result = std::min(result, count);
+    }
+
+    return result;
+}
+
+void ResponseCache::FrequencySketch::Clear() {
+    _counters.fill(0);
+    _additions = 0;
+}
+
+std::size_t ResponseCache::FrequencySketch::GetIndex(std::size_t hash, std::size_t row) const {
+    static constexpr std::uint64_t seeds[SketchDepth] = {
+        0x9e3779b97f4a7c15,
+        0xc2b2ae3d27d4eb4f,
+        0x165667b19e3779f9,
+        0x27d4eb2f165667c5
+    };
+
+    auto h = static_cast<std::uint64_t>(hash) * seeds[row];
+    h ^= h >> 32;
+
+    return row * SketchWidth + h % SketchWidth;
+}
+
+ResponseCache::ResponseCache(std::size_t maxBytes, Eviction eviction, std::size_t shards) :
+    _shardCount(shards),
+    _maxShardSize(shards ? maxBytes / shards : 0),
+    _eviction(eviction),
+    _shards(std::make_unique<Shard[]>(shards)) {
+    if (!shards)
+        throw std::logic_error("Response cache must have at least one shard");
+}
+
+std::shared_ptr<CachedResponse> ResponseCache::Find(const Request& request) {
+    auto key = MakeKey(request.GetMethod(), request.GetUri());
+    auto hash = std::hash<std::string_view>()(key);
+    auto& shard = GetShard(hash);
+
+    std::lock_guard lock(shard.Mutex);
+
+    shard.Sketch.Increment(hash);
+
+    auto it = shard.Index.find(key);
+
+    if (it == shard.Index.end())
+        return nullptr;
+
+    auto resource = it->second;
+    auto& variants = resource->Variants;
+    auto values = GetVaryValues(request, resource->Vary);
+
+    for (auto variant = variants.begin(); variant != variants.end(); ++variant) {
+        if (variant->VaryValues != values)
+            continue;
+
+        if (variant->Expiry <= Clock::GetCurrentTime()) {
+            resource->Size -= variant->Size;
+            shard.Size -= variant->Size;
+            variants.erase(variant);
+
+            if (variants.empty())
+                EraseResource(shard, resource);
+
+            return nullptr;
+        }
+
+        shard.Resources.splice(shard.Resources.begin(), shard.Resources, resource);
+
+        return variant->Response;
+    }
+
+    return nullptr;
+}
+
+bool ResponseCache::Insert(const Request& request,
+                           std::shared_ptr<CachedResponse> response,
+                           std::chrono::milliseconds ttl,
+                           std::string_view vary) {
+    auto names = ParseVary(vary);
+
+    // A response that varies on anything
+    // but the request's headers isn't reused.
+    if (std::find(names.begin(), names.end(), "*") != names.end())
+        return false;
+
+    auto key = MakeKey(request.GetMethod(), request.GetUri());
+    auto hash = std::hash<std::string_view>()(key);
+    auto& shard = GetShard(hash);
+    auto values = GetVaryValues(request, names);
+    auto variantSize = response->GetSize() + values.size();
+
+    std::lock_guard lock(shard.Mutex);
+
+    auto it = shard.Index.find(key);
+    auto resource = shard.Resources.end();
+
+    if (it != shard.Index.end()) {
+        resource = it->second;
+
+        shard.Resources.splice(shard.Resources.begin(), shard.Resources, resource);
+
+        auto& variants = resource->Variants;
+
+        if (resource->Vary != names) {
+            // The response now varies on different
+            // headers, so older variants are useless.
+            for (auto& variant : variants) {
+                resource->Size -= variant.Size;
+                shard.Size -= variant.Size;
+            }
+
+            variants.clear();
+            resource->Vary = names;
+        }
+
+        auto variant = std::find_if(variants.begin(), variants.end(), [&](auto& v) {
+            return v.VaryValues == values;
+        });
+
+        if (variant != variants.end()) {
+            resource->Size -= variant->Size;
+            shard.Size -= variant->Size;
+            variants.erase(variant);
+        }
+
+        if (!MakeRoom(shard, variantSize, hash, resource)) {
+            if (variants.empty())
+                EraseResource(shard, resource);
+
+            return false;
+        }
+    } else {
+        if (!MakeRoom(shard, key.size() + variantSize, hash, shard.Resources.end()))
+            return false;
+
+        resource = shard.Resources.emplace(shard.Resources.begin());
+        resource->Key = std::move(key);
+        resource->Hash = hash;
+        resource->Vary = std::move(names);
+        resource->Size = resource->Key.size();
+        shard.Size += resource->Size;
+        shard.Index.emplace(resource->Key, resource);
+    }
+
+    auto& variant = resource->Variants.emplace_back();
+    variant.VaryValues = std::move(values);
+    variant.Response = std::move(response);
+    variant.Expiry = Clock::GetCurrentTime() + ttl;
+    variant.Size = variantSize;
+
+    resource->Size += variantSize;
+    shard.Size += variantSize;
+
+    return true;
+}
+
+void ResponseCache::Erase(Method method, std::string_view uri) {
+    auto key = MakeKey(method, uri);
+    auto hash = std::hash<std::string_view>()(key);
+    auto& shard = GetShard(hash);
+
+    std::lock_guard lock(shard.Mutex);
+
+    if (auto it = shard.Index.find(key); it != shard.Index.end())
+        EraseResource(shard, it->second);
+}
+
+void ResponseCache::Clear() {
+    for (std::size_t i = 0; i < _shardCount; ++i) {
+        auto& shard = _shards[i];
+        std::lock_guard lock(shard.Mutex);
+        shard.Index.clear();
+        shard.Resources.clear();
+        shard.Sketch.Clear();
+        shard.Size = 0;
+    }
+}
+
+std::size_t ResponseCache::GetSize() const {
+    std::size_t size = 0;
+
+    for (std::size_t i = 0; i < _shardCount; ++i) {
+        auto& shard = _shards[i];
+        std::lock_guard lock(shard.Mutex);
+        size += shard.Size;
+    }
+
+    return size;
+}
+
+std::string ResponseCache::MakeKey(Method method, std::string_view uri) {
+    auto key = std::string();
+
+    key.reserve(1 + uri.size());
+    key += static_cast<char>('0' + static_cast<int>(method));
+    key += uri;
+
+    return key;
+}
+
+std::string ResponseCache::GetVaryValues(const Request& request, const std::vector<std::string>& vary) {
+    auto values = std::string();
+
+    for (auto& name : vary) {
+        std::string_view value;
+
+        // Tell a missing header from an empty one
+        if (request.GetHeader(name, &value)) {
+            values += ':';
+
+            // Clients list the encodings they accept in all sorts
+            // of ways, but only the one picked makes a difference,
+            // so that each compressed variant is kept just once.
+            if (EqualsIgnoreCase(name, "Accept-Encoding"))
+                values += Compressor::GetName(Compressor::Negotiate(value));
+            else
+                values += value;
+        }
+
+        values += '\n';
+    }
+
+    return values;
+}
+
+ResponseCache::Shard& ResponseCache::GetShard(std::size_t hash) {
+    return _shards[hash % _shardCount];
+}
+
+void ResponseCache::EraseResource(Shard& shard, ResourceList::iterator resource) {
+    shard.Size -= resource->Size;
+    shard.Index.erase(resource->Key);
+    shard.Resources.erase(resource);
+}
+
+bool ResponseCache::MakeRoom(Shard& shard, std::size_t size, std::size_t hash, ResourceList::iterator keep) {
+    if (size > _maxShardSize)
+        return false;
+
+    while (shard.Size + size > _maxShardSize) {
+        auto victim = std::prev(shard.Resources.end());
+
+        // Never evict the resource being added to
+        if (victim == keep)
+            return false;
+
+        if (_eviction == Eviction::TinyLfu && shard.Sketch.Estimate(hash) <= shard.Sketch.Estimate(victim->Hash))
+            return false;
+
+        EraseResource(shard, victim);
+    }
+
+    return true;
+}
+
+} // namespace Chili
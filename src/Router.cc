@@ -20,7 +20,7 @@ Router::Router() {
 
 void Router::InvokeRoute(Channel& channel) const {
     const RouteHandler* handler;
-    Args args;
+    Args args(&channel.GetArena());
     Protocol::Status status;
 
     if (FindMatch(channel.GetRequest(), handler, args)) {
@@ -35,8 +35,11 @@ void Router::InvokeRoute(Channel& channel) const {
 }
 
 bool Router::FindMatch(const Request& request, const RouteHandler*& outHandler, Args& outArgs) const {
+    using SubMatch = std::sub_match<const char*>;
+    using Matches = std::match_results<const char*, ArenaAllocator<SubMatch>>;
+
     auto method = static_cast<int>(request.GetMethod());
-    auto uri = std::string(request.GetUri());
+    auto uri = request.GetUri();
 
     auto methodRoutes = _routes.find(method);
 
@@ -45,13 +48,13 @@ bool Router::FindMatch(const Request& request, const RouteHandler*& outHandler,
 
         for (auto& route : routes) {
             auto& [regex, handler] = route;
-            std::smatch matches;
+            Matches matches(outArgs.get_allocator());
 
-            if (std::regex_match(uri, matches, regex)) {
+            if (std::regex_match(uri.data(), uri.data() + uri.size(), matches, regex)) {
                 outArgs.reserve(matches.size() - 1);
 
                 for (auto i = begin(matches) + 1, e = end(matches); i != e; ++i)
-                    outArgs.push_back(std::move(*i));
+                    outArgs.emplace_back(i->first, i->length());
 
                 outHandler = &handler;
 
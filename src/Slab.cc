@@ -0,0 +1,116 @@
+#include "Slab.h"
+#include "ConcurrentMemoryPool.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace Chili {
+
+namespace {
+
+template <std::size_t Size>
+struct Block {
+    char Data[Size];
+};
+
+} // unnamed namespace
+
+SlabCache::SlabCache(std::size_t blocksPerClass) {
+    CreateSizeClasses(blocksPerClass, std::make_index_sequence<SizeClasses>{});
+}
+
+template <std::size_t... Indices>
+void SlabCache::CreateSizeClasses(std::size_t blocksPerClass, std::index_sequence<Indices...>) {
+    static_assert((MinBlockSize << (SizeClasses - 1)) == MaxBlockSize);
+    _sizeClasses = {CreateSizeClass<(MinBlockSize << Indices)>(blocksPerClass)...};
+}
+
+template <std::size_t Size>
+SlabCache::SizeClass SlabCache::CreateSizeClass(std::size_t blocks) {
+    using Pool = ConcurrentMemoryPool<Block<Size>>;
+
+    // Keep thread caches of bigger blocks smaller
+    auto cacheSize = std::clamp<std::size_t>(0x10000 / Size, 4, 0x40);
+    auto pool = Pool::Create(Detail::MinPagesFor(blocks * Size), cacheSize);
+
+    SizeClass sc;
+
+    sc.Allocate = [](void* p) {
+        return static_cast<Pool*>(p)->Allocate();
+    };
+
+    sc.Deallocate = [](void* p, void* mem) {
+        static_cast<Pool*>(p)->Deallocate(mem);
+    };
+
+    sc.GetFreeSlots = [](const void* p) {
+        return static_cast<const Pool*>(p)->GetFreeSlots();
+    };
+
+    sc.GetCapacity = [](const void* p) {
+        return static_cast<const Pool*>(p)->GetCapacity();
+    };
+
+    sc.ReleaseIdleArenas = [](void* p) {
+        return static_cast<Pool*>(p)->ReleaseIdleArenas();
+    };
+
+    sc.Pool = std::move(pool);
+
+    return sc;
+}
+
+void* SlabCache::Allocate(std::size_t size) {
+    if (size <= MaxBlockSize) {
+        auto& sc = _sizeClasses[GetSizeClassIndex(size)];
+        return sc.Allocate(sc.Pool.get());
+    }
+
+    return ::operator new(size);
+}
+
+void SlabCache::Deallocate(void* mem, std::size_t size) noexcept {
+    if (size <= MaxBlockSize) {
+        auto& sc = _sizeClasses[GetSizeClassIndex(size)];
+        sc.Deallocate(sc.Pool.get(), mem);
+    } else {
+        ::operator delete(mem);
+    }
+}
+
+std::size_t SlabCache::GetFreeBlocks(std::size_t size) const {
+    if (size > MaxBlockSize)
+        return 0;
+
+    auto& sc = _sizeClasses[GetSizeClassIndex(size)];
+    return sc.GetFreeSlots(sc.Pool.get());
+}
+
+std::size_t SlabCache::GetCapacity(std::size_t size) const {
+    if (size > MaxBlockSize)
+        return 0;
+
+    auto& sc = _sizeClasses[GetSizeClassIndex(size)];
+    return sc.GetCapacity(sc.Pool.get());
+}
+
+std::size_t SlabCache::ReleaseIdleMemory() {
+    std::size_t released = 0;
+
+    for (auto& sc : _sizeClasses)
+        released += sc.ReleaseIdleArenas(sc.Pool.get());
+
+    return released;
+}
+
+std::size_t SlabCache::GetSizeClassIndex(std::size_t size) {
+    std::size_t index = 0;
+
+    for (auto blockSize = MinBlockSize; blockSize < size; blockSize <<= 1)
+        ++index;
+
+    return index;
+}
+
+} // namespace Chili
+
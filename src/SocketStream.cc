@@ -6,6 +6,9 @@
 #include <sys/socket.h>
 #include <sys/uio.h>
 
+#include <algorithm>
+#include <cstring>
+
 namespace Chili {
 
 SocketStream& SocketStream::IncrementUseCount(SocketStream& s) {
@@ -23,6 +26,12 @@ SocketStream::SocketStream(SocketStream::NativeHandle nh) :
         _useCount = std::make_shared<std::atomic_int>(1);
 }
 
+SocketStream::SocketStream(SocketStream::NativeHandle nh, const SlabAllocator<std::atomic_int>& allocator) :
+    FileStream{nh} {
+    if (_nativeHandle != InvalidHandle)
+        _useCount = std::allocate_shared<std::atomic_int>(allocator, 1);
+}
+
 SocketStream::SocketStream(const SocketStream& rhs) :
     FileStream{rhs},
     _useCount{rhs._useCount} {
@@ -57,11 +66,33 @@ SocketStream& SocketStream::operator=(SocketStream&& rhs) {
     return *this;
 }
 
+std::size_t SocketStream::Read(void* buffer, std::size_t maxBytes) {
+    {
+        std::lock_guard lock(_deliveryMutex);
+
+        if (auto size = std::min(maxBytes, _delivered.size() - _deliveredPosition)) {
+            std::memcpy(buffer, _delivered.data() + _deliveredPosition, size);
+            ConsumeDelivered(size);
+            return size;
+        }
+
+        // Anything there is to read is going to be delivered
+        if (_delivering)
+            return 0;
+    }
+
+    return FileStream::Read(buffer, maxBytes);
+}
+
 std::size_t SocketStream::Write(const void* buffer, std::size_t maxBytes) {
     auto bytesWritten = ::send(_nativeHandle, buffer, maxBytes, MSG_NOSIGNAL);
 
-    if (bytesWritten == -1)
-        throw SystemError{};
+    if (bytesWritten == -1) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK)
+            return 0;
+        else
+            throw SystemError{};
+    }
 
     return bytesWritten;
 }
@@ -74,25 +105,78 @@ std::size_t SocketStream::WriteVector(std::vector<std::pair<const void*, std::si
 
     auto bytesWritten = ::sendmsg(_nativeHandle, &mh, MSG_NOSIGNAL);
 
-    if (bytesWritten == -1)
-        throw SystemError{};
+    if (bytesWritten == -1) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK)
+            return 0;
+        else
+            throw SystemError{};
+    }
 
     return bytesWritten;
 }
 
 std::size_t SocketStream::WriteTo(FileStream& fs, std::size_t maxBytes) {
+    {
+        std::lock_guard lock(_deliveryMutex);
+
+        // Delivered data is already in memory, so
+        // it can only be written the usual way.
+        if (auto size = std::min(maxBytes, _delivered.size() - _deliveredPosition)) {
+            auto bytesWritten = fs.Write(_delivered.data() + _deliveredPosition, size);
+            ConsumeDelivered(bytesWritten);
+            return bytesWritten;
+        }
+
+        if (_delivering)
+            return 0;
+    }
+
     ::ssize_t result = ::splice(_nativeHandle,
                                 nullptr,
                                 fs.GetNativeHandle(),
                                 nullptr,
                                 maxBytes,
                                 0);
-    if (result == -1)
-        throw SystemError{};
+    if (result == -1) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK)
+            return 0;
+        else
+            throw SystemError{};
+    }
 
     return result;
 }
 
+void SocketStream::BeginDelivery() {
+    std::lock_guard lock(_deliveryMutex);
+    _delivering = true;
+}
+
+std::size_t SocketStream::Deliver(const void* data, std::size_t size) {
+    std::lock_guard lock(_deliveryMutex);
+
+    auto bytes = static_cast<const char*>(data);
+    _delivered.insert(_delivered.end(), bytes, bytes + size);
+
+    return _delivered.size() - _deliveredPosition;
+}
+
+void SocketStream::EndDelivery() {
+    std::lock_guard lock(_deliveryMutex);
+    _delivering = false;
+}
+
+// Must be called with the delivery mutex locked
+void SocketStream::ConsumeDelivered(std::size_t size) {
+    _deliveredPosition += size;
+
+    // Keep the capacity for whatever comes next
+    if (_deliveredPosition == _delivered.size()) {
+        _delivered.clear();
+        _deliveredPosition = 0;
+    }
+}
+
 void SocketStream::Close() {
     if ((_nativeHandle != InvalidHandle) && !--*_useCount)
         Shutdown();
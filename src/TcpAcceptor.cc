@@ -44,9 +44,10 @@ void Listen(SocketStream& socket) {
 
 } // unnamed namespace
 
-TcpAcceptor::TcpAcceptor(const IPEndpoint& ep, int listeners)
-    : Acceptor{listeners}
-    , _endpoint{ep} {}
+TcpAcceptor::TcpAcceptor(const IPEndpoint& ep, int listeners, Poller::Backend backend)
+    : Acceptor{listeners, backend}
+    , _endpoint{ep}
+    , _slab{std::make_shared<SlabCache>()} {}
 
 void TcpAcceptor::ResetListenerSocket(SocketStream& socket) {
     socket = SocketStream();
@@ -64,8 +65,16 @@ void TcpAcceptor::ResetListenerSocket(SocketStream& socket) {
     Listen(socket);
 }
 
-void TcpAcceptor::RelinquishSocket(int fd, IPEndpoint ep) {
-    OnAccepted(std::make_shared<TcpConnection>(fd, std::move(ep)));
+void TcpAcceptor::RelinquishSocket(int fd, std::optional<IPEndpoint> ep) {
+    // Connections come and go, so they're recycled through
+    // our own slab, along with their sockets' use counts.
+    auto allocator = SlabAllocator<TcpConnection>(_slab);
+    auto socket = SocketStream(fd, SlabAllocator<std::atomic_int>(allocator));
+
+    if (ep)
+        OnAccepted(std::allocate_shared<TcpConnection>(allocator, std::move(socket), std::move(*ep)));
+    else
+        OnAccepted(std::allocate_shared<TcpConnection>(allocator, std::move(socket)));
 }
 
 void* TcpAcceptor::AddressBuffer() {
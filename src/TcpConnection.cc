@@ -25,19 +25,49 @@ void Connect(SocketStream& socket, const IPEndpoint& ep) {
 TcpConnection::TcpConnection(const IPEndpoint& ep) :
     SocketStream{::socket(AF_INET, SOCK_STREAM, 0)},
     _endpoint{ep} {
-    Connect(*this, _endpoint);
+    Connect(*this, *_endpoint);
 }
 
 TcpConnection::TcpConnection(SocketStream s, const IPEndpoint& ep) :
     SocketStream{std::move(s)},
     _endpoint{ep} {}
 
+TcpConnection::TcpConnection(SocketStream s) :
+    SocketStream{std::move(s)} {}
+
+const IPEndpoint& TcpConnection::Endpoint() const {
+    std::call_once(_endpointLookup, [this] {
+        if (_endpoint)
+            return;
+
+        ::sockaddr_in addr;
+        ::socklen_t size = sizeof(addr);
+
+        if (-1 == ::getpeername(_nativeHandle, reinterpret_cast<::sockaddr*>(&addr), &size))
+            throw SystemError();
+
+        _endpoint = IPEndpoint(addr);
+    });
+
+    return *_endpoint;
+}
+
 void TcpConnection::Cork(bool enabled) {
     int value = enabled ? 1 : 0;
     if (-1 == ::setsockopt(_nativeHandle, IPPROTO_TCP, TCP_CORK, &value, sizeof(value)))
         throw SystemError();
 }
 
+std::size_t TcpConnection::GetSendBufferSize() const {
+    int value;
+    ::socklen_t len = sizeof(value);
+
+    if (-1 == ::getsockopt(_nativeHandle, SOL_SOCKET, SO_SNDBUF, &value, &len))
+        throw SystemError();
+
+    return value;
+}
+
 void TcpConnection::Flush() {
     int originalValue;
     ::socklen_t len;
@@ -0,0 +1,191 @@
+#include "TimerWheel.h"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+namespace Chili {
+
+bool TimerWheel::Timer::IsArmed() const {
+    return _armed;
+}
+
+Clock::TimePoint TimerWheel::Timer::GetDeadline() const {
+    return _deadline;
+}
+
+TimerWheel::TimerWheel(std::chrono::milliseconds resolution, std::size_t slots) :
+    _resolution(resolution),
+    _slots(slots, nullptr),
+    _due(slots, 0),
+    _currentTick(Clock::GetCurrentTime()) {
+    if (resolution.count() <= 0 || slots == 0)
+        throw std::logic_error("Invalid timer wheel dimensions");
+}
+
+void TimerWheel::Insert(Timer& t, Clock::TimePoint deadline) {
+    Cancel(t);
+
+    // Deadlines that have already passed go into
+    // the current slot, to be expired on the next
+    // call to Expire().
+    std::size_t ticks = 0;
+
+    if (deadline > _currentTick)
+        ticks = (deadline - _currentTick + _resolution - std::chrono::nanoseconds(1)) / _resolution;
+
+    t._deadline = deadline;
+    t._expiry = _tick + ticks;
+    t._rounds = ticks / _slots.size();
+
+    Link(t, (_current + ticks) % _slots.size());
+
+    _nextExpiry = std::min(_nextExpiry, t._expiry);
+}
+
+void TimerWheel::Cancel(Timer& t) {
+    if (t._armed)
+        Unlink(t);
+}
+
+std::size_t TimerWheel::Expire(Clock::TimePoint now) {
+    std::size_t expired = 0;
+
+    if (!_count) {
+        // Nothing to catch up with, so
+        // just skip ahead to the present.
+        if (_currentTick < now) {
+            auto ticks = (now - _currentTick) / _resolution;
+            _current = (_current + ticks) % _slots.size();
+            _currentTick += ticks * _resolution;
+            _tick += ticks;
+        }
+
+        return 0;
+    }
+
+    while (_currentTick <= now) {
+        // Gather everything that's due in this slot first,
+        // since the callbacks are allowed to re-arm their
+        // timers, possibly into this very slot.
+        Timer* due = nullptr;
+
+        for (auto t = _slots[_current]; t;) {
+            auto next = t->_next;
+
+            if (t->_rounds == 0) {
+                Unlink(*t);
+                t->_next = due;
+                due = t;
+            } else if (!--t->_rounds) {
+                // Due when this slot comes around again
+                ++_due[_current];
+            }
+
+            t = next;
+        }
+
+        _current = (_current + 1) % _slots.size();
+        _currentTick += _resolution;
+        ++_tick;
+
+        while (due) {
+            auto t = due;
+            due = due->_next;
+            t->_next = nullptr;
+            ++expired;
+
+            if (t->OnExpired)
+                t->OnExpired();
+        }
+    }
+
+    return expired;
+}
+
+Clock::TimePoint TimerWheel::GetNextExpiry() const {
+    if (!_count)
+        return Clock::TimePoint::max();
+
+    if (_nextExpiryStale || _nextExpiry < _tick)
+        UpdateNextExpiry();
+
+    return _currentTick + (_nextExpiry - _tick) * _resolution;
+}
+
+void TimerWheel::UpdateNextExpiry() const {
+    auto end = _tick + _slots.size();
+
+    _nextExpiryStale = false;
+
+    // No timer expires before the stale expiry, so look
+    // on from there. Timers due within this revolution
+    // are counted per slot, so none need to be walked.
+    for (auto tick = std::max(_nextExpiry, _tick); tick < end; ++tick) {
+        if (_due[(_current + tick - _tick) % _slots.size()]) {
+            _nextExpiry = tick;
+            return;
+        }
+    }
+
+    // All timers have rounds left, and finding the earliest
+    // means walking them all, so it's only done once per
+    // revolution. Otherwise, wake up at the end of this
+    // one, which no timer can expire before.
+    if (_tick < _nextWalk) {
+        _nextExpiry = end;
+        return;
+    }
+
+    _nextWalk = end;
+    _nextExpiry = std::numeric_limits<std::uint64_t>::max();
+
+    for (auto head : _slots)
+        for (auto t = head; t; t = t->_next)
+            _nextExpiry = std::min(_nextExpiry, t->_expiry);
+}
+
+std::size_t TimerWheel::GetCount() const {
+    return _count;
+}
+
+void TimerWheel::Link(Timer& t, std::size_t slot) {
+    auto& head = _slots[slot];
+
+    t._slot = slot;
+    t._prev = nullptr;
+    t._next = head;
+
+    if (head)
+        head->_prev = &t;
+
+    head = &t;
+    t._armed = true;
+    ++_count;
+
+    if (!t._rounds)
+        ++_due[slot];
+}
+
+void TimerWheel::Unlink(Timer& t) {
+    if (t._prev)
+        t._prev->_next = t._next;
+    else
+        _slots[t._slot] = t._next;
+
+    if (t._next)
+        t._next->_prev = t._prev;
+
+    t._prev = nullptr;
+    t._next = nullptr;
+    t._armed = false;
+    --_count;
+
+    if (!t._rounds)
+        --_due[t._slot];
+
+    if (t._expiry == _nextExpiry)
+        _nextExpiryStale = true;
+}
+
+} // namespace Chili
@@ -0,0 +1,94 @@
+#include <gmock/gmock.h>
+
+#include "ChunkedDecoder.h"
+
+#include <string>
+
+using namespace ::testing;
+
+namespace Chili {
+
+class ChunkedDecoderTest : public Test {
+protected:
+    /**
+     * Decodes the input in pieces of the specified size,
+     * and returns the number of input bytes consumed.
+     */
+    std::size_t Decode(const std::string& input, std::size_t pieceSize = -1) {
+        std::size_t position = 0;
+
+        while (position < input.size() && !_decoder.IsDone()) {
+            auto size = std::min(pieceSize, input.size() - position);
+            std::string_view data;
+            position += _decoder.Decode(input.data() + position, size, data);
+            _output.append(data.data(), data.size());
+        }
+
+        return position;
+    }
+
+    ChunkedDecoder _decoder;
+    std::string _output;
+};
+
+TEST_F(ChunkedDecoderTest, decodes_chunks) {
+    std::string input = "4\r\nWiki\r\n5\r\npedia\r\nE\r\n in\r\n\r\nchunks.\r\n0\r\n\r\n";
+
+    EXPECT_EQ(input.size(), Decode(input));
+    EXPECT_TRUE(_decoder.IsDone());
+    EXPECT_EQ("Wikipedia in\r\n\r\nchunks.", _output);
+}
+
+TEST_F(ChunkedDecoderTest, decodes_byte_by_byte) {
+    std::string input = "4\r\nWiki\r\n5\r\npedia\r\n0\r\n\r\n";
+
+    EXPECT_EQ(input.size(), Decode(input, 1));
+    EXPECT_TRUE(_decoder.IsDone());
+    EXPECT_EQ("Wikipedia", _output);
+}
+
+TEST_F(ChunkedDecoderTest, skips_extensions_and_trailers) {
+    std::string input = "4;name=\"value\"\r\nWiki\r\n0\r\nExpires: never\r\nX-Other: 1\r\n\r\n";
+
+    EXPECT_EQ(input.size(), Decode(input, 3));
+    EXPECT_TRUE(_decoder.IsDone());
+    EXPECT_EQ("Wiki", _output);
+}
+
+TEST_F(ChunkedDecoderTest, stops_at_end_of_body) {
+    std::string body = "a\r\n0123456789\r\n0\r\n\r\n";
+
+    EXPECT_EQ(body.size(), Decode(body + "GET / HTTP/1.1\r\n"));
+    EXPECT_EQ("0123456789", _output);
+}
+
+TEST_F(ChunkedDecoderTest, data_consumed_elsewhere_can_be_skipped) {
+    std::string_view data;
+
+    _decoder.Decode("a\r\n", 3, data);
+    EXPECT_EQ(10, _decoder.GetDataRemaining());
+
+    _decoder.SkipData(4);
+    EXPECT_EQ(6, _decoder.GetDataRemaining());
+
+    _decoder.SkipData(6);
+    EXPECT_EQ(0, _decoder.GetDataRemaining());
+    EXPECT_THROW(_decoder.SkipData(1), std::logic_error);
+
+    Decode("\r\n0\r\n\r\n");
+    EXPECT_TRUE(_decoder.IsDone());
+}
+
+TEST_F(ChunkedDecoderTest, rejects_malformed_chunks) {
+    EXPECT_THROW(Decode("x\r\n"), std::runtime_error);
+    _decoder.Reset();
+    EXPECT_THROW(Decode("\r\n"), std::runtime_error);
+    _decoder.Reset();
+    EXPECT_THROW(Decode("4\r\nWikiX\r\n"), std::runtime_error);
+    _decoder.Reset();
+    EXPECT_THROW(Decode("4\n"), std::runtime_error);
+    _decoder.Reset();
+    EXPECT_THROW(Decode("10000000000000000\r\n"), std::runtime_error);
+}
+
+} // namespace Chili
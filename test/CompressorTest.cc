@@ -0,0 +1,86 @@
+#include <gmock/gmock.h>
+
+#include "Compressor.h"
+#include "TestUtils.h"
+
+#include <string>
+
+using namespace ::testing;
+
+namespace Chili {
+
+class CompressorTest : public Test {
+protected:
+    std::string Decompress(const std::vector<char>& data) {
+        return Chili::Decompress({data.data(), data.size()});
+    }
+};
+
+TEST_F(CompressorTest, compress_at_once) {
+    auto text = std::string(0x1000, 'x') + "hello";
+
+    for (auto compression : {Compression::Gzip, Compression::Deflate}) {
+        std::vector<char> output;
+        Compressor(compression).Compress(text, output, true);
+
+        EXPECT_LT(output.size(), text.size());
+        EXPECT_EQ(text, Decompress(output));
+    }
+
+    std::vector<char> output;
+    Compressor(Compression::Gzip).Compress(text, output, true);
+
+    ASSERT_GE(output.size(), 2);
+    EXPECT_EQ('\x1f', output[0]); // gzip magic
+    EXPECT_EQ('\x8b', output[1]);
+}
+
+TEST_F(CompressorTest, compress_in_pieces) {
+    Compressor compressor(Compression::Gzip);
+    std::vector<char> output;
+
+    compressor.Compress("hello ", output, false);
+    auto firstSize = output.size();
+
+    // Each piece is flushed, so it can be decoded on its own
+    EXPECT_GT(firstSize, 0);
+    EXPECT_EQ("hello ", Decompress(output));
+
+    compressor.Compress({}, output, false);
+    EXPECT_EQ(firstSize, output.size());
+
+    compressor.Compress("world", output, false);
+    compressor.Compress({}, output, true);
+
+    EXPECT_EQ("hello world", Decompress(output));
+}
+
+TEST_F(CompressorTest, invalid_compression_throws) {
+    EXPECT_THROW(Compressor(Compression::None), std::logic_error);
+}
+
+TEST_F(CompressorTest, negotiate) {
+    EXPECT_EQ(Compression::None, Compressor::Negotiate(""));
+    EXPECT_EQ(Compression::None, Compressor::Negotiate("identity"));
+    EXPECT_EQ(Compression::None, Compressor::Negotiate("br"));
+    EXPECT_EQ(Compression::Gzip, Compressor::Negotiate("gzip, deflate"));
+    EXPECT_EQ(Compression::Gzip, Compressor::Negotiate("deflate, gzip"));
+    EXPECT_EQ(Compression::Gzip, Compressor::Negotiate("GZIP"));
+    EXPECT_EQ(Compression::Gzip, Compressor::Negotiate("x-gzip"));
+    EXPECT_EQ(Compression::Deflate, Compressor::Negotiate("deflate"));
+    EXPECT_EQ(Compression::Deflate, Compressor::Negotiate("gzip;q=0.5, deflate"));
+    EXPECT_EQ(Compression::Deflate, Compressor::Negotiate("gzip ; q=0.5 , deflate;q=0.501"));
+    EXPECT_EQ(Compression::Gzip, Compressor::Negotiate("br;q=1.0, gzip;q=0.8, *;q=0.1"));
+    EXPECT_EQ(Compression::Gzip, Compressor::Negotiate("*"));
+    EXPECT_EQ(Compression::Deflate, Compressor::Negotiate("gzip;q=0, *"));
+    EXPECT_EQ(Compression::None, Compressor::Negotiate("gzip;q=0, deflate;q=0.000"));
+    EXPECT_EQ(Compression::None, Compressor::Negotiate("*;q=0"));
+}
+
+TEST_F(CompressorTest, name) {
+    EXPECT_EQ("gzip", Compressor::GetName(Compression::Gzip));
+    EXPECT_EQ("deflate", Compressor::GetName(Compression::Deflate));
+    EXPECT_EQ("identity", Compressor::GetName(Compression::None));
+}
+
+} // namespace Chili
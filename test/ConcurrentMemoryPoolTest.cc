@@ -0,0 +1,214 @@
+#include <gmock/gmock.h>
+
+#include "ConcurrentMemoryPool.h"
+
+#include <random>
+#include <thread>
+#include <vector>
+
+using namespace ::testing;
+
+namespace Chili {
+
+namespace {
+
+struct Item {
+    Item() = default;
+
+    Item(int x, int y) :
+        x(x), y(y) {}
+
+    int x;
+    int y;
+};
+
+class DestructionVerifier {
+public:
+    DestructionVerifier(bool& destroyed) :
+        _destroyed(&destroyed) {
+        *_destroyed = false;
+    }
+
+    ~DestructionVerifier() {
+        *_destroyed = true;
+    }
+
+private:
+    bool* _destroyed;
+};
+
+} // unnamed namespace
+
+class ConcurrentMemoryPoolTest : public Test {
+protected:
+    void AllocDeallocRandomly(ConcurrentMemoryPool<Item>& mp) {
+        std::vector<Item*> ptrs;
+        std::random_device rd;
+
+        for (int i = 0; i < 10000; ++i) {
+            if (ptrs.empty() || rd() % 2) {
+                auto item = static_cast<Item*>(mp.Allocate());
+                item->x = i;
+                ptrs.push_back(item);
+            } else {
+                auto index = rd() % ptrs.size();
+                mp.Deallocate(ptrs[index]);
+                ptrs.erase(begin(ptrs) + index);
+            }
+        }
+
+        for (auto ptr : ptrs)
+            mp.Deallocate(ptr);
+    }
+};
+
+TEST_F(ConcurrentMemoryPoolTest, alloc_and_construct) {
+    auto mp = ConcurrentMemoryPool<Item>::Create();
+
+    auto item = mp->New(1, 2);
+
+    EXPECT_EQ(1, item->x);
+    EXPECT_EQ(2, item->y);
+    EXPECT_EQ(mp->GetCapacity() - 1, mp->GetFreeSlots());
+}
+
+TEST_F(ConcurrentMemoryPoolTest, new_returns_smart_ptr) {
+    bool destroyed = false;
+
+    auto mp = ConcurrentMemoryPool<DestructionVerifier>::Create();
+    mp->New(destroyed);
+
+    EXPECT_TRUE(destroyed);
+    EXPECT_EQ(mp->GetCapacity(), mp->GetFreeSlots());
+}
+
+TEST_F(ConcurrentMemoryPoolTest, grows_by_chaining_arenas) {
+    auto mp = ConcurrentMemoryPool<Item>::Create(1);
+
+    EXPECT_EQ(0, mp->GetCapacity());
+    EXPECT_EQ(0, mp->GetArenaCount());
+
+    auto first = mp->Allocate();
+    auto perArena = mp->GetCapacity();
+
+    std::vector<void*> ptrs{first};
+
+    for (std::size_t i = 0; i < perArena * 3; ++i)
+        ptrs.push_back(mp->Allocate());
+
+    EXPECT_EQ(4, mp->GetArenaCount());
+    EXPECT_EQ(perArena * 4, mp->GetCapacity());
+
+    for (auto ptr : ptrs)
+        mp->Deallocate(ptr);
+
+    EXPECT_EQ(mp->GetCapacity(), mp->GetFreeSlots());
+}
+
+TEST_F(ConcurrentMemoryPoolTest, releases_idle_arenas) {
+    auto mp = ConcurrentMemoryPool<Item>::Create(1, 2);
+
+    std::vector<void*> ptrs;
+
+    do {
+        ptrs.push_back(mp->Allocate());
+    } while (mp->GetArenaCount() < 3);
+
+    for (auto ptr : ptrs)
+        mp->Deallocate(ptr);
+
+    // The thread cache still holds a couple of slots,
+    // which keep their arena from being released.
+    auto released = mp->ReleaseIdleArenas();
+
+    EXPECT_LE(1, released);
+    EXPECT_EQ(3 - released, mp->GetArenaCount());
+    EXPECT_EQ(mp->GetCapacity(), mp->GetFreeSlots());
+
+    for (auto& ptr : ptrs)
+        ptr = mp->Allocate();
+
+    EXPECT_EQ(3, mp->GetArenaCount());
+
+    for (auto ptr : ptrs)
+        mp->Deallocate(ptr);
+}
+
+TEST_F(ConcurrentMemoryPoolTest, thread_caches_are_returned_on_exit) {
+    auto mp = ConcurrentMemoryPool<Item>::Create(1);
+
+    std::thread([&] {
+        auto ptrs = std::vector<void*>();
+
+        for (int i = 0; i < 10; ++i)
+            ptrs.push_back(mp->Allocate());
+
+        for (auto ptr : ptrs)
+            mp->Deallocate(ptr);
+    }).join();
+
+    EXPECT_EQ(1, mp->ReleaseIdleArenas());
+    EXPECT_EQ(0, mp->GetArenaCount());
+}
+
+TEST_F(ConcurrentMemoryPoolTest, ids_of_destroyed_pools_are_reused) {
+    auto caches = Detail::GetThreadCaches().size();
+
+    for (int i = 0; i < 100; ++i) {
+        auto mp = ConcurrentMemoryPool<Item>::Create(1);
+        mp->Deallocate(mp->Allocate());
+    }
+
+    EXPECT_GE(caches + 1, Detail::GetThreadCaches().size());
+}
+
+TEST_F(ConcurrentMemoryPoolTest, caches_of_destroyed_pools_are_discarded) {
+    auto mp = ConcurrentMemoryPool<Item>::Create(1);
+    mp->Deallocate(mp->Allocate());
+    mp.reset();
+
+    // Takes over the ID, but not the cached slot
+    mp = ConcurrentMemoryPool<Item>::Create(1);
+
+    auto item = static_cast<Item*>(mp->Allocate());
+    item->x = 1;
+
+    EXPECT_EQ(mp->GetCapacity() - 1, mp->GetFreeSlots());
+
+    mp->Deallocate(item);
+}
+
+TEST_F(ConcurrentMemoryPoolTest, concurrent_alloc_dealloc_randomly) {
+    auto mp = ConcurrentMemoryPool<Item>::Create(1, 8);
+
+    std::vector<std::thread> threads;
+
+    for (int i = 0; i < 5; ++i)
+        threads.emplace_back([&] { AllocDeallocRandomly(*mp); });
+
+    for (auto& t : threads)
+        t.join();
+
+    EXPECT_EQ(mp->GetCapacity(), mp->GetFreeSlots());
+
+    auto arenas = mp->GetArenaCount();
+    EXPECT_EQ(arenas, mp->ReleaseIdleArenas());
+}
+
+TEST_F(ConcurrentMemoryPoolTest, cross_thread_dealloc) {
+    auto mp = ConcurrentMemoryPool<Item>::Create(1, 4);
+    auto ptrs = std::vector<void*>();
+
+    for (int i = 0; i < 1000; ++i)
+        ptrs.push_back(mp->Allocate());
+
+    std::thread([&] {
+        for (auto ptr : ptrs)
+            mp->Deallocate(ptr);
+    }).join();
+
+    EXPECT_EQ(mp->GetCapacity(), mp->GetFreeSlots());
+}
+
+} // namespace Chili
+
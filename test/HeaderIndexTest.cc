@@ -0,0 +1,106 @@
+#include <gmock/gmock.h>
+
+#include "HeaderIndex.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace ::testing;
+
+namespace Chili {
+
+class HeaderIndexTest : public Test {
+public:
+    HeaderIndexTest() :
+        _cache{std::make_shared<SlabCache>(4)},
+        _fields(_cache) {}
+
+protected:
+    void Add(std::string_view name, std::string_view value) {
+        _fields.emplace_back(name, value);
+        _index.Add(name, _fields.size() - 1);
+    }
+
+    std::string_view Get(std::string_view name) const {
+        auto position = _index.Find(name, _fields);
+        return position == HeaderIndex::npos ? "" : _fields[position].second;
+    }
+
+    std::shared_ptr<SlabCache> _cache;
+    HeaderParser::FieldList _fields;
+    HeaderIndex _index;
+};
+
+TEST_F(HeaderIndexTest, identifies_known_headers) {
+    for (int i = 0; i < static_cast<int>(Header::Unknown); ++i) {
+        auto h = static_cast<Header>(i);
+        EXPECT_EQ(h, HeaderIndex::GetKnownHeader(HeaderIndex::GetName(h)));
+    }
+
+    EXPECT_EQ(Header::ContentLength, HeaderIndex::GetKnownHeader("content-LENGTH"));
+    EXPECT_EQ(Header::Unknown, HeaderIndex::GetKnownHeader("Content"));
+    EXPECT_EQ(Header::Unknown, HeaderIndex::GetKnownHeader("X-Real-IP"));
+    EXPECT_EQ(Header::Unknown, HeaderIndex::GetKnownHeader(""));
+}
+
+TEST_F(HeaderIndexTest, finds_known_headers) {
+    Add("Host", "example.com");
+    Add("content-length", "13");
+
+    EXPECT_EQ(0, _index.Find(Header::Host));
+    EXPECT_EQ(1, _index.Find(Header::ContentLength));
+    EXPECT_EQ(HeaderIndex::npos, _index.Find(Header::Cookie));
+    EXPECT_EQ("13", Get("Content-Length"));
+}
+
+TEST_F(HeaderIndexTest, finds_unknown_headers_regardless_of_case) {
+    Add("X-Real-IP", "1.2.3.4");
+    Add("X-Forwarded-For", "5.6.7.8");
+
+    EXPECT_EQ("1.2.3.4", Get("x-real-ip"));
+    EXPECT_EQ("5.6.7.8", Get("X-FORWARDED-FOR"));
+    EXPECT_EQ("", Get("X-Real"));
+    EXPECT_EQ("", Get("X-Forwarded"));
+}
+
+TEST_F(HeaderIndexTest, first_field_wins) {
+    Add("Cookie", "a=1");
+    Add("X-Custom", "first");
+    Add("cookie", "b=2");
+    Add("x-custom", "second");
+
+    EXPECT_EQ("a=1", Get("Cookie"));
+    EXPECT_EQ("first", Get("X-Custom"));
+}
+
+TEST_F(HeaderIndexTest, keeps_finding_headers_after_overflow) {
+    std::vector<std::string> names;
+
+    for (int i = 0; i < 100; ++i)
+        names.push_back("X-Header-" + std::to_string(i));
+
+    for (auto& n : names)
+        Add(n, n);
+
+    Add("Host", "example.com");
+
+    for (auto& n : names)
+        EXPECT_EQ(n, Get(n));
+
+    EXPECT_EQ("example.com", Get("host"));
+    EXPECT_EQ("", Get("X-Header-100"));
+}
+
+TEST_F(HeaderIndexTest, clear_removes_everything) {
+    Add("Host", "example.com");
+    Add("X-Real-IP", "1.2.3.4");
+
+    _index.Clear();
+    _fields.clear();
+
+    EXPECT_EQ(HeaderIndex::npos, _index.Find(Header::Host));
+    EXPECT_EQ("", Get("X-Real-IP"));
+}
+
+} // namespace Chili
@@ -0,0 +1,119 @@
+#include <gmock/gmock.h>
+
+#include "HeaderParser.h"
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace ::testing;
+
+namespace Chili {
+
+class HeaderParserTest : public Test {
+protected:
+    std::vector<HeaderParser> GetParsers() const {
+        std::vector<HeaderParser> result;
+        auto supported = HeaderParser::GetSupportedInstructionSet();
+
+        for (auto is : {HeaderParser::InstructionSet::Generic,
+                        HeaderParser::InstructionSet::Sse42,
+                        HeaderParser::InstructionSet::Avx2})
+            if (is <= supported)
+                result.emplace_back(is);
+
+        return result;
+    }
+
+    HeaderParser::Result Parse(const HeaderParser& parser, std::string header) {
+        _header = std::move(header);
+        _fields.clear();
+
+        auto data = _header.data();
+        auto end = parser.FindEnd(data, data + _header.size());
+
+        if (!end)
+            throw std::runtime_error("No end of header");
+
+        return parser.Parse({data, static_cast<std::size_t>(end - data)}, _fields);
+    }
+
+    std::string _header;
+    HeaderParser::FieldList _fields;
+};
+
+TEST_F(HeaderParserTest, finds_end_at_any_offset) {
+    for (auto& parser : GetParsers()) {
+        for (std::size_t i = 0; i < 70; ++i) {
+            auto data = std::string(i, 'a') + "\r\n\r" + "\r\n\r\n" + std::string(40, 'b');
+            auto end = parser.FindEnd(data.data(), data.data() + data.size());
+
+            ASSERT_EQ(data.data() + i + 7, end);
+        }
+    }
+}
+
+TEST_F(HeaderParserTest, does_not_find_missing_end) {
+    for (auto& parser : GetParsers()) {
+        auto data = std::string(100, 'a') + "\r\n\r\n";
+
+        EXPECT_EQ(nullptr, parser.FindEnd(data.data(), data.data() + data.size() - 1));
+    }
+}
+
+TEST_F(HeaderParserTest, parses_request_line_and_fields) {
+    for (auto& parser : GetParsers()) {
+        auto r = Parse(parser,
+            "POST /path/to/resource?with=a-rather-long-query-string HTTP/1.1\r\n"
+            "Host: request.urih.com\r\n"
+            "User-Agent:  Mozilla/5.0 (X11; Linux x86_64; rv:31.0) Gecko/20100101 Firefox/31.0 \r\n"
+            "Empty:\r\n"
+            "Content-Length: 13\r\n"
+            "\r\n");
+
+        EXPECT_EQ("POST", r.Method);
+        EXPECT_EQ("/path/to/resource?with=a-rather-long-query-string", r.Uri);
+        EXPECT_EQ(1, r.VersionMajor);
+        EXPECT_EQ(1, r.VersionMinor);
+        EXPECT_EQ(13, r.ContentLength);
+        EXPECT_TRUE(r.KeepAlive);
+
+        ASSERT_EQ(4, _fields.size());
+        EXPECT_EQ("Host", _fields[0].first);
+        EXPECT_EQ("request.urih.com", _fields[0].second);
+        EXPECT_EQ("Mozilla/5.0 (X11; Linux x86_64; rv:31.0) Gecko/20100101 Firefox/31.0", _fields[1].second);
+        EXPECT_EQ("Empty", _fields[2].first);
+        EXPECT_EQ("", _fields[2].second);
+    }
+}
+
+TEST_F(HeaderParserTest, connection_header_decides_keep_alive) {
+    for (auto& parser : GetParsers()) {
+        EXPECT_FALSE(Parse(parser, "GET / HTTP/1.1\r\nConnection: Close\r\n\r\n").KeepAlive);
+        EXPECT_FALSE(Parse(parser, "GET / HTTP/1.0\r\n\r\n").KeepAlive);
+        EXPECT_TRUE(Parse(parser, "GET / HTTP/1.0\r\nConnection: TE, keep-alive\r\n\r\n").KeepAlive);
+    }
+}
+
+TEST_F(HeaderParserTest, transfer_encoding_header_decides_chunked) {
+    for (auto& parser : GetParsers()) {
+        EXPECT_FALSE(Parse(parser, "POST / HTTP/1.1\r\nContent-Length: 1\r\n\r\n").Chunked);
+        EXPECT_TRUE(Parse(parser, "POST / HTTP/1.1\r\nTransfer-Encoding: Chunked\r\n\r\n").Chunked);
+        EXPECT_TRUE(Parse(parser, "POST / HTTP/1.1\r\nTransfer-Encoding: gzip, chunked\r\n\r\n").Chunked);
+        EXPECT_THROW(Parse(parser, "POST / HTTP/1.1\r\nTransfer-Encoding: chunked, gzip\r\n\r\n"), std::runtime_error);
+        EXPECT_THROW(Parse(parser, "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\nContent-Length: 1\r\n\r\n"), std::runtime_error);
+    }
+}
+
+TEST_F(HeaderParserTest, rejects_malformed_headers) {
+    for (auto& parser : GetParsers()) {
+        EXPECT_THROW(Parse(parser, "GET /\r\n\r\n"), std::runtime_error);
+        EXPECT_THROW(Parse(parser, "GET / HTTP/x.1\r\n\r\n"), std::runtime_error);
+        EXPECT_THROW(Parse(parser, "GET / HTTP/1.1\r\nNo colon here\r\n\r\n"), std::runtime_error);
+        EXPECT_THROW(Parse(parser, "GET / HTTP/1.1\r\nBad: a rather long value with a \x01 in it\r\n\r\n"), std::runtime_error);
+        EXPECT_THROW(Parse(parser, "GET / HTTP/1.1\r\nContent-Length: 1x\r\n\r\n"), std::runtime_error);
+        EXPECT_THROW(Parse(parser, "GET / HTTP/1.1\r\nContent-Length: 1\r\nContent-Length: 2\r\n\r\n"), std::runtime_error);
+    }
+}
+
+} // namespace Chili
@@ -0,0 +1,80 @@
+#include <gmock/gmock.h>
+
+#include "HttpDate.h"
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace ::testing;
+
+namespace Chili {
+
+class HttpDateTest : public Test {
+protected:
+    std::string Format(std::time_t t) {
+        char buffer[HttpDate::Length];
+        HttpDate::Format(t, buffer);
+        return {buffer, sizeof(buffer)};
+    }
+};
+
+TEST_F(HttpDateTest, format) {
+    EXPECT_EQ("Sun, 06 Nov 1994 08:49:37 GMT", Format(784111777));
+    EXPECT_EQ("Thu, 01 Jan 1970 00:00:00 GMT", Format(0));
+    EXPECT_EQ("Tue, 29 Feb 2028 23:59:59 GMT", Format(1835481599));
+}
+
+TEST_F(HttpDateTest, parse) {
+    std::time_t t;
+
+    ASSERT_TRUE(HttpDate::Parse("Sun, 06 Nov 1994 08:49:37 GMT", t));
+    EXPECT_EQ(784111777, t);
+
+    ASSERT_TRUE(HttpDate::Parse(Format(1835481599), t));
+    EXPECT_EQ(1835481599, t);
+
+    EXPECT_FALSE(HttpDate::Parse("", t));
+    EXPECT_FALSE(HttpDate::Parse("Sunday, 06-Nov-94 08:49:37 GMT", t));
+    EXPECT_FALSE(HttpDate::Parse("Sun Nov  6 08:49:37 1994", t));
+    EXPECT_FALSE(HttpDate::Parse("Sun, 06 Nox 1994 08:49:37 GMT", t));
+    EXPECT_FALSE(HttpDate::Parse("Sun, 06 Nov 1994 08:4x:37 GMT", t));
+    EXPECT_FALSE(HttpDate::Parse("Sun, 06 Nov 1994 08:49:37 UTC", t));
+}
+
+TEST_F(HttpDateTest, current_date) {
+    char buffer[HttpDate::Length];
+    auto before = std::time(nullptr);
+    auto t = HttpDate::Get(buffer);
+    auto after = std::time(nullptr);
+
+    EXPECT_LE(before, t);
+    EXPECT_GE(after, t);
+    EXPECT_EQ(Format(t), std::string(buffer, sizeof(buffer)));
+}
+
+TEST_F(HttpDateTest, concurrent_readers) {
+    std::vector<std::thread> threads;
+    std::atomic<int> mismatches{0};
+
+    for (int i = 0; i < 4; ++i) {
+        threads.emplace_back([&] {
+            char buffer[HttpDate::Length];
+
+            for (int j = 0; j < 10000; ++j) {
+                auto t = HttpDate::Get(buffer);
+
+                if (Format(t) != std::string(buffer, sizeof(buffer)))
+                    ++mismatches;
+            }
+        });
+    }
+
+    for (auto& thread : threads)
+        thread.join();
+
+    EXPECT_EQ(0, mismatches);
+}
+
+} // namespace Chili
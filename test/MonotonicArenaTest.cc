@@ -0,0 +1,92 @@
+#include <gmock/gmock.h>
+
+#include "MonotonicArena.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace ::testing;
+
+namespace Chili {
+
+class MonotonicArenaTest : public Test {
+public:
+    MonotonicArenaTest() :
+        _cache{std::make_shared<SlabCache>(4)} {}
+
+protected:
+    std::shared_ptr<SlabCache> _cache;
+};
+
+TEST_F(MonotonicArenaTest, allocates_sequentially) {
+    MonotonicArena arena(_cache, 0x400);
+
+    auto first = static_cast<char*>(arena.Allocate(10, 1));
+    auto second = static_cast<char*>(arena.Allocate(10, 1));
+
+    EXPECT_EQ(first + 10, second);
+    EXPECT_EQ(20, arena.GetBytesUsed());
+}
+
+TEST_F(MonotonicArenaTest, respects_alignment) {
+    MonotonicArena arena(_cache, 0x400);
+
+    arena.Allocate(1, 1);
+    auto p = arena.Allocate(sizeof(std::uint64_t), alignof(std::uint64_t));
+
+    EXPECT_EQ(0, reinterpret_cast<std::uintptr_t>(p) % alignof(std::uint64_t));
+}
+
+TEST_F(MonotonicArenaTest, stores_strings) {
+    MonotonicArena arena(_cache, 0x400);
+    auto original = std::string("Hello world!");
+
+    auto stored = arena.Store(original);
+    original = "Goodbye";
+
+    EXPECT_EQ("Hello world!", stored);
+}
+
+TEST_F(MonotonicArenaTest, reuses_first_block_after_reset) {
+    MonotonicArena arena(_cache, 0x400);
+
+    auto first = arena.Allocate(0x100);
+
+    // Spill into more blocks, including an oversized one
+    for (int i = 0; i < 10; ++i)
+        arena.Allocate(0x100);
+
+    arena.Allocate(0x1000);
+
+    arena.Reset();
+
+    EXPECT_EQ(0, arena.GetBytesUsed());
+    EXPECT_EQ(first, arena.Allocate(0x100));
+}
+
+TEST_F(MonotonicArenaTest, returns_blocks_to_slab) {
+    auto freeBlocks = std::size_t();
+
+    {
+        MonotonicArena arena(_cache, 0x400);
+        arena.Allocate(0x10);
+        freeBlocks = _cache->GetFreeBlocks(0x400);
+    }
+
+    EXPECT_EQ(freeBlocks + 1, _cache->GetFreeBlocks(0x400));
+}
+
+TEST_F(MonotonicArenaTest, backs_standard_containers) {
+    MonotonicArena arena(_cache, 0x400);
+    std::vector<int, ArenaAllocator<int>> v(&arena);
+
+    for (int i = 0; i < 100; ++i)
+        v.push_back(i);
+
+    EXPECT_EQ(99, v.back());
+    EXPECT_LE(100 * sizeof(int), arena.GetBytesUsed());
+}
+
+} // namespace Chili
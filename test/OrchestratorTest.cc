@@ -11,7 +11,9 @@
 #include "TestUtils.h"
 #include "WaitEvent.h"
 
+#include <algorithm>
 #include <atomic>
+#include <cstring>
 #include <chrono>
 #include <random>
 
@@ -81,7 +83,9 @@ protected:
 
     using FactoryFunction = std::function<std::shared_ptr<Channel>(std::shared_ptr<FileStream>)>;
 
-    std::shared_ptr<HttpServer> MakeServer(FactoryFunction factoryFunction) {
+    std::shared_ptr<HttpServer> MakeServer(FactoryFunction factoryFunction,
+                                           int shards = 1,
+                                           Poller::Backend backend = Poller::Backend::Epoll) {
         struct Factory : ChannelFactory {
             Factory(FactoryFunction f) :
                 _f(std::move(f)) {}
@@ -93,7 +97,7 @@ protected:
             FactoryFunction _f;
         };
 
-        return std::make_shared<HttpServer>(_ep, std::make_unique<Factory>(std::move(factoryFunction)));
+        return std::make_shared<HttpServer>(_ep, std::make_unique<Factory>(std::move(factoryFunction)), 1, shards, 8, backend);
     }
 
     template <class Processor>
@@ -131,13 +135,13 @@ protected:
 
         conn.SetBlocking(false);
 
-        return result;
+        return RemoveDateHeaders(std::move(result));
     }
 
     std::string ReadAvailable(FileStream& conn) {
         char buffer[0x1000];
         auto bytesRead = conn.Read(buffer, sizeof(buffer));
-        return {buffer, bytesRead};
+        return RemoveDateHeaders({buffer, bytesRead});
     }
 
     IPEndpoint _ep{{{127, 0, 0, 1}}, 63184};
@@ -191,6 +195,117 @@ TEST_F(OrchestratorTest, one_client_header_and_body) {
     EXPECT_EQ(okResponse, response);
 }
 
+TEST_F(OrchestratorTest, one_client_chunked_body) {
+    auto server = MakeServer(MakeProcessor([=](Channel& c) {
+        c.FetchContent([&c] {
+            auto& content = c.GetRequest().GetContent();
+            c.GetResponse().SetContent(std::string(content.data(), content.size()));
+            c.GetResponse().SetStatus(Status::Ok);
+            c.SendResponse();
+        });
+    }));
+
+    server->Start();
+
+    std::string request = "POST /upload HTTP/1.1\r\n"
+                          "Host: request.urih.com\r\n"
+                          "Connection: close\r\n"
+                          "Transfer-Encoding: chunked\r\n"
+                          "\r\n"
+                          "8\r\nRequest \r\n"
+                          "5\r\nbody!\r\n"
+                          "0\r\n\r\n";
+
+    auto client = CreateClient();
+    client->Write(request.data(), request.size());
+
+    std::string response;
+    ASSERT_NO_THROW(response = ReadToEnd(*client));
+    EXPECT_EQ("HTTP/1.1 200 OK\r\n"
+              "Connection: close\r\n"
+              "Content-Length: 13\r\n"
+              "\r\n"
+              "Request body!", response);
+}
+
+TEST_F(OrchestratorTest, one_client_streamed_body) {
+    auto server = MakeServer(MakeProcessor([=](Channel& c) {
+        auto streamed = std::make_shared<std::string>();
+
+        c.StreamContent([=](std::string_view data) {
+            streamed->append(data.data(), data.size());
+        }, [&c, streamed] {
+            c.GetResponse().SetContent(std::to_string(streamed->size()));
+            c.GetResponse().SetStatus(Status::Ok);
+            c.SendResponse();
+        });
+    }));
+
+    server->Start();
+
+    std::string body(0x10000, 'a');
+    auto request = fmt::format("POST /upload HTTP/1.1\r\n"
+                               "Host: request.urih.com\r\n"
+                               "Connection: close\r\n"
+                               "Content-Length: {}\r\n"
+                               "\r\n", body.size()) + body;
+
+    auto client = CreateClient();
+    client->Write(request.data(), request.size());
+
+    std::string response;
+    ASSERT_NO_THROW(response = ReadToEnd(*client));
+    EXPECT_EQ("HTTP/1.1 200 OK\r\n"
+              "Connection: close\r\n"
+              "Content-Length: 5\r\n"
+              "\r\n"
+              "65536", response);
+}
+
+TEST_F(OrchestratorTest, one_client_spliced_body) {
+    auto file = std::make_shared<FileStream>(OpenTempFile());
+    auto progress = std::make_shared<std::vector<std::size_t>>();
+
+    auto server = MakeServer(MakeProcessor([=](Channel& c) {
+        c.SpliceContent(file, [&c, file] {
+            std::string content(c.GetRequest().GetContentLength(), '\0');
+            ::pread(file->GetNativeHandle(), content.data(), content.size(), 0);
+
+            c.GetResponse().SetContent(content.substr(content.size() - 4));
+            c.GetResponse().SetStatus(Status::Ok);
+            c.SendResponse();
+        }, [=](std::size_t length) {
+            progress->push_back(length);
+        });
+    }));
+
+    server->Start();
+
+    std::string body(0x40000, 'a');
+    body.replace(body.size() - 4, 4, "last");
+
+    auto request = fmt::format("POST /upload HTTP/1.1\r\n"
+                               "Host: request.urih.com\r\n"
+                               "Connection: close\r\n"
+                               "Content-Length: {}\r\n"
+                               "\r\n", body.size()) + body;
+
+    auto client = CreateClient();
+    client->Write(request.data(), request.size());
+
+    std::string response;
+    ASSERT_NO_THROW(response = ReadToEnd(*client));
+    EXPECT_EQ("HTTP/1.1 200 OK\r\n"
+              "Connection: close\r\n"
+              "Content-Length: 4\r\n"
+              "\r\n"
+              "last", response);
+
+    ASSERT_FALSE(progress->empty());
+    EXPECT_TRUE(std::is_sorted(progress->begin(), progress->end()));
+    EXPECT_EQ(body.size(), progress->back());
+}
+
 TEST_F(OrchestratorTest, one_client_header_and_body_throttled) {
     auto ready = std::make_shared<WaitEvent>();
 
@@ -439,6 +554,454 @@ TEST_F(OrchestratorTest, reponse_stream_wake_up_for_more_data) {
     ASSERT_EQ(expected, response);
 }
 
+TEST_F(OrchestratorTest, large_streamed_response) {
+    struct RepeatingInputStream : public InputStream {
+        std::size_t Read(void* buffer, std::size_t n) override {
+            n = std::min(n, _remaining);
+            std::memset(buffer, 'a', n);
+            _remaining -= n;
+            return n;
+        }
+
+        bool EndOfStream() const override {
+            return _remaining == 0;
+        }
+
+    private:
+        std::size_t _remaining = 0x100000;
+    };
+
+    auto server = MakeServer(MakeProcessor([=](Channel& c) {
+        c.GetResponse().SetContent(std::make_shared<RepeatingInputStream>());
+        c.GetResponse().SetStatus(Status::Ok);
+        c.SendResponse();
+    }));
+
+    server->SetChunkSize(0x1000, 0x10000);
+    server->Start();
+
+    auto client = CreateClient();
+    client->Write(requestData, sizeof(requestData));
+
+    std::string response;
+    ASSERT_NO_THROW(response = ReadToEnd(*client));
+
+    auto bodyPosition = response.find("\r\n\r\n") + 4;
+    auto decodedSize = std::size_t(0);
+
+    for (auto p = bodyPosition; p < response.size();) {
+        auto lineEnd = response.find("\r\n", p);
+        ASSERT_NE(std::string::npos, lineEnd);
+        auto size = std::stoul(response.substr(p, lineEnd - p), nullptr, 16);
+
+        ASSERT_EQ(std::string(size, 'a'), response.substr(lineEnd + 2, size));
+        ASSERT_EQ("\r\n", response.substr(lineEnd + 2 + size, 2));
+
+        decodedSize += size;
+        p = lineEnd + 2 + size + 2;
+    }
+
+    EXPECT_EQ(0x100000u, decodedSize);
+    EXPECT_EQ("0\r\n\r\n", response.substr(response.size() - 5));
+}
+
+TEST_F(OrchestratorTest, file_response) {
+    auto file = std::make_shared<FileStream>(OpenTempFile());
+    std::string content(0x20000, 'a');
+    content.replace(content.size() - 4, 4, "last");
+    file->Write(content.data(), content.size());
+
+    auto server = MakeServer(MakeProcessor([=](Channel& c) {
+        c.GetResponse().SetContent(file, 0, content.size());
+        c.GetResponse().SetStatus(Status::Ok);
+        c.SendResponse();
+    }));
+
+    server->Start();
+
+    auto client = CreateClient();
+    client->Write(requestData, sizeof(requestData));
+
+    std::string response;
+    ASSERT_NO_THROW(response = ReadToEnd(*client));
+    EXPECT_THAT(response, HasSubstr("\r\nETag: \""));
+    EXPECT_THAT(response, HasSubstr("\r\nLast-Modified: "));
+    EXPECT_EQ(fmt::format("HTTP/1.1 200 OK\r\n"
+                          "Connection: close\r\n"
+                          "Content-Length: {}\r\n"
+                          "\r\n", content.size()) + content,
+              RemoveHeaders(RemoveHeaders(response, "ETag"), "Last-Modified"));
+}
+
+TEST_F(OrchestratorTest, pipelined_requests) {
+    auto server = MakeServer(MakeProcessor([=](Channel& c) {
+        c.GetResponse().SetContent(std::string(c.GetRequest().GetUri()));
+        c.GetResponse().SetStatus(Status::Ok);
+        c.SendResponse();
+    }));
+
+    server->Start();
+
+    std::string requests;
+    std::string expected;
+
+    for (auto uri : {"/first", "/second", "/third", "/last"}) {
+        auto last = std::string(uri) == "/last";
+
+        requests += fmt::format("GET {} HTTP/1.1\r\n"
+                                "Host: request.urih.com\r\n"
+                                "Connection: {}\r\n"
+                                "\r\n", uri, last ? "close" : "keep-alive");
+
+        expected += fmt::format("HTTP/1.1 200 OK\r\n"
+                                "{}"
+                                "Content-Length: {}\r\n"
+                                "\r\n"
+                                "{}", last ? "Connection: close\r\n" : "", std::strlen(uri), uri);
+    }
+
+    auto client = CreateClient();
+    client->Write(requests.data(), requests.size());
+
+    std::string response;
+    ASSERT_NO_THROW(response = ReadToEnd(*client));
+    EXPECT_EQ(expected, response);
+}
+
+TEST_F(OrchestratorTest, pipelined_partial_request) {
+    auto server = MakeServer(MakeProcessor([=](Channel& c) {
+        c.GetResponse().SetContent(std::string(c.GetRequest().GetUri()));
+        c.GetResponse().SetStatus(Status::Ok);
+        c.SendResponse();
+    }));
+
+    server->Start();
+
+    std::string first = "GET /first HTTP/1.1\r\n"
+                        "Host: request.urih.com\r\n"
+                        "\r\n";
+
+    std::string second = "GET /second HTTP/1.1\r\n"
+                         "Host: request.urih.com\r\n"
+                         "Connection: close\r\n"
+                         "\r\n";
+
+    auto client = CreateClient();
+    auto requests = first + second.substr(0, 24);
+    client->Write(requests.data(), requests.size());
+
+    // The first response has to arrive before
+    // the rest of the second request is sent.
+    std::string response;
+    char buffer[1];
+
+    client->SetBlocking(true);
+
+    while (response.size() < 6 || response.compare(response.size() - 6, 6, "/first")) {
+        std::size_t bytesRead = 0;
+        ASSERT_NO_THROW(bytesRead = client->Read(buffer, sizeof(buffer), 1s));
+        ASSERT_NE(0, bytesRead);
+        response.append(buffer, bytesRead);
+    }
+
+    client->SetBlocking(false);
+
+    EXPECT_EQ("HTTP/1.1 200 OK\r\n"
+              "Content-Length: 6\r\n"
+              "\r\n"
+              "/first", RemoveDateHeaders(response));
+
+    client->Write(second.data() + 24, second.size() - 24);
+
+    ASSERT_NO_THROW(response = ReadToEnd(*client));
+    EXPECT_EQ("HTTP/1.1 200 OK\r\n"
+              "Connection: close\r\n"
+              "Content-Length: 7\r\n"
+              "\r\n"
+              "/second", response);
+}
+
+TEST_F(OrchestratorTest, cached_responses) {
+    auto processed = std::make_shared<std::atomic_int>(0);
+
+    auto server = MakeServer(MakeProcessor([=](Channel& c) {
+        ++*processed;
+        c.GetResponse().SetCacheTtl(1min);
+        c.GetResponse().SetContent(std::string(c.GetRequest().GetUri()));
+        c.GetResponse().SetStatus(Status::Ok);
+        c.SendResponse();
+    }));
+
+    server->SetResponseCache(std::make_shared<ResponseCache>(0x10000));
+    server->Start();
+
+    std::string requests;
+    std::string expected;
+
+    auto uris = {"/first", "/first", "/second", "/first", "/second", "/first"};
+
+    for (auto& uri : uris) {
+        auto last = &uri == std::prev(uris.end());
+
+        requests += fmt::format("GET {} HTTP/1.1\r\n"
+                                "Host: request.urih.com\r\n"
+                                "Connection: {}\r\n"
+                                "\r\n", uri, last ? "close" : "keep-alive");
+
+        // The last one is served from the cache, in the
+        // variant that has the Connection header last.
+        expected += fmt::format("HTTP/1.1 200 OK\r\n"
+                                "Content-Length: {}\r\n"
+                                "{}"
+                                "\r\n"
+                                "{}", std::strlen(uri), last ? "Connection: close\r\n" : "", uri);
+    }
+
+    auto client = CreateClient();
+    client->Write(requests.data(), requests.size());
+
+    std::string response;
+    ASSERT_NO_THROW(response = ReadToEnd(*client));
+    EXPECT_EQ(expected, RemoveHeaders(response, "ETag"));
+    EXPECT_EQ(2, *processed);
+}
+
+TEST_F(OrchestratorTest, cached_responses_compressed) {
+    auto processed = std::make_shared<std::atomic_int>(0);
+    auto text = std::string(0x1000, 'x');
+
+    auto server = MakeServer(MakeProcessor([=](Channel& c) {
+        ++*processed;
+        c.GetResponse().SetCacheTtl(1min);
+        c.GetResponse().SetContent(text);
+        c.GetResponse().SetStatus(Status::Ok);
+        c.SendResponse();
+    }));
+
+    server->SetResponseCache(std::make_shared<ResponseCache>(0x100000));
+    server->Start();
+
+    auto request = [&](std::string headers) {
+        auto client = CreateClient();
+        auto data = "GET /text HTTP/1.1\r\n"
+                    "Host: request.urih.com\r\n"
+                    "Connection: close\r\n" + headers + "\r\n";
+
+        client->Write(data.data(), data.size());
+
+        return ReadToEnd(*client);
+    };
+
+    auto response = request("");
+    ASSERT_EQ(text, response.substr(response.find("\r\n\r\n") + 4));
+
+    // Answered from the cache, in its gzip variant
+    response = request("Accept-Encoding: gzip\r\n");
+    auto head = response.substr(0, response.find("\r\n\r\n") + 4);
+
+    EXPECT_NE(std::string::npos, head.find("\r\nContent-Encoding: gzip\r\n"));
+    EXPECT_NE(std::string::npos, head.find("\r\nVary: Accept-Encoding\r\n"));
+    EXPECT_EQ(text, Decompress(response.substr(head.size())));
+    EXPECT_EQ(1, *processed);
+}
+
+TEST_F(OrchestratorTest, conditional_requests) {
+    auto processed = std::make_shared<std::atomic_int>(0);
+
+    auto server = MakeServer(MakeProcessor([=](Channel& c) {
+        ++*processed;
+        c.GetResponse().SetCacheTtl(1min);
+        c.GetResponse().SetContent(std::string("hello"));
+        c.GetResponse().SetStatus(Status::Ok);
+        c.SendResponse();
+    }));
+
+    server->SetResponseCache(std::make_shared<ResponseCache>(0x100000));
+    server->Start();
+
+    auto request = [&](std::string headers) {
+        auto client = CreateClient();
+        auto data = "GET /hello HTTP/1.1\r\n"
+                    "Host: request.urih.com\r\n"
+                    "Connection: close\r\n" + headers + "\r\n";
+
+        client->Write(data.data(), data.size());
+
+        return ReadToEnd(*client);
+    };
+
+    auto response = request("");
+    auto etagStart = response.find("\r\nETag: ") + 8;
+    auto etag = response.substr(etagStart, response.find("\r\n", etagStart) - etagStart);
+
+    ASSERT_EQ("HTTP/1.1 200 OK\r\n", response.substr(0, 17));
+    ASSERT_FALSE(etag.empty());
+
+    // Answered from the cache, without the content
+    EXPECT_EQ("HTTP/1.1 304 Not Modified\r\n"
+              "ETag: " + etag + "\r\n"
+              "Connection: close\r\n"
+              "\r\n", request("If-None-Match: " + etag + "\r\n"));
+
+    EXPECT_EQ(response, request("If-None-Match: \"other\"\r\n"));
+    EXPECT_EQ(1, *processed);
+}
+
+TEST_F(OrchestratorTest, inactive_client_disconnected) {
+    auto server = MakeServer(MakeProcessor([=](Channel& c) {
+        c.GetResponse().SetStatus(Status::Ok);
+        c.SendResponse();
+    }));
+
+    server->SetInactivityTimeout(100ms);
+    server->Start();
+
+    auto idleClient = CreateClient();
+    auto activeClient = CreateClient();
+
+    activeClient->Write(requestData, sizeof(requestData));
+
+    std::string response;
+    ASSERT_NO_THROW(response = ReadToEnd(*activeClient));
+    ASSERT_EQ(okResponse, response);
+
+    ASSERT_NO_THROW(response = ReadToEnd(*idleClient));
+    ASSERT_EQ("", response);
+}
+
+TEST_F(OrchestratorTest, inactivity_timeout_shortened) {
+    auto server = MakeServer(MakeProcessor([=](Channel& c) {
+        c.GetResponse().SetStatus(Status::Ok);
+        c.SendResponse();
+    }));
+
+    server->SetInactivityTimeout(1h);
+    server->Start();
+
+    auto idleClient = CreateClient();
+
+    std::this_thread::sleep_for(50ms);
+    server->SetInactivityTimeout(100ms);
+
+    std::string response;
+    ASSERT_NO_THROW(response = ReadToEnd(*idleClient));
+    ASSERT_EQ("", response);
+}
+
+TEST_F(OrchestratorTest, sharded_server) {
+    for (auto policy : {HttpServer::ShardingPolicy::RoundRobin, HttpServer::ShardingPolicy::LeastLoaded}) {
+        auto server = MakeServer(MakeProcessor([=](Channel& c) {
+            c.GetResponse().SetStatus(Status::Ok);
+            c.SendResponse();
+        }), 4);
+
+        server->SetShardingPolicy(policy);
+        server->Start();
+
+        std::vector<std::unique_ptr<TcpConnection>> clients;
+
+        for (int i = 0; i < 16; ++i) {
+            clients.push_back(CreateClient());
+            clients.back()->Write(requestData, sizeof(requestData));
+        }
+
+        for (auto& client : clients) {
+            std::string response;
+            ASSERT_NO_THROW(response = ReadToEnd(*client));
+            ASSERT_EQ(okResponse, response);
+        }
+    }
+}
+
+TEST_F(OrchestratorTest, io_uring_backend) {
+    auto server = MakeServer(MakeProcessor([=](Channel& c) {
+        c.GetResponse().SetStatus(Status::Ok);
+        c.SendResponse();
+    }), 1, Poller::Backend::IoUring);
+
+    server->Start();
+
+    std::vector<std::unique_ptr<TcpConnection>> clients;
+
+    for (int i = 0; i < 16; ++i) {
+        clients.push_back(CreateClient());
+        clients.back()->Write(requestData, sizeof(requestData));
+    }
+
+    for (auto& client : clients) {
+        std::string response;
+        ASSERT_NO_THROW(response = ReadToEnd(*client));
+        ASSERT_EQ(okResponse, response);
+    }
+}
+
+TEST_F(OrchestratorTest, io_uring_spliced_body) {
+    auto file = std::make_shared<FileStream>(OpenTempFile());
+    std::string body(0x100000, '\0');
+
+    for (std::size_t i = 0; i < body.size(); ++i)
+        body[i] = 'a' + i % 23;
+
+    // Enough to be delivered in parts, and to pile up
+    // beyond what a socket may have delivered to it.
+    auto server = MakeServer(MakeProcessor([=](Channel& c) {
+        c.SpliceContent(file, [&c, file, body] {
+            std::string content(c.GetRequest().GetContentLength(), '\0');
+            ::pread(file->GetNativeHandle(), content.data(), content.size(), 0);
+
+            c.GetResponse().SetContent(content == body ? "same" : "diff");
+            c.GetResponse().SetStatus(Status::Ok);
+            c.SendResponse();
+        });
+    }), 1, Poller::Backend::IoUring);
+
+    server->Start();
+
+    auto request = fmt::format("POST /upload HTTP/1.1\r\n"
+                               "Host: request.urih.com\r\n"
+                               "Connection: close\r\n"
+                               "Content-Length: {}\r\n"
+                               "\r\n", body.size()) + body;
+
+    auto client = CreateClient();
+    auto writer = std::thread([&] {
+        client->Write(request.data(), request.size());
+    });
+
+    auto onExit = CreateExitTrap([&] { writer.join(); });
+
+    std::string response;
+    ASSERT_NO_THROW(response = ReadToEnd(*client));
+    EXPECT_EQ("HTTP/1.1 200 OK\r\n"
+              "Connection: close\r\n"
+              "Content-Length: 4\r\n"
+              "\r\n"
+              "same", response);
+}
+
+TEST_F(OrchestratorTest, inline_activation) {
+    auto server = MakeServer(MakeProcessor([=](Channel& c) {
+        c.GetResponse().SetStatus(Status::Ok);
+        c.SendResponse();
+    }));
+
+    server->SetInlineActivation(true);
+    server->Start();
+
+    std::vector<std::unique_ptr<TcpConnection>> clients;
+
+    for (int i = 0; i < 16; ++i) {
+        clients.push_back(CreateClient());
+        clients.back()->Write(requestData, sizeof(requestData));
+    }
+
+    for (auto& client : clients) {
+        std::string response;
+        ASSERT_NO_THROW(response = ReadToEnd(*client));
+        ASSERT_EQ(okResponse, response);
+    }
+}
+
 TEST_F(OrchestratorTest, stress) {
     auto ready = std::make_shared<WaitEvent>();
     auto readyCount = std::make_shared<std::atomic_int>(0);
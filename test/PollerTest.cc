@@ -9,6 +9,8 @@
 #include <condition_variable>
 #include <thread>
 
+#include <unistd.h>
+
 using namespace ::testing;
 using namespace std::literals;
 
@@ -203,6 +205,216 @@ TEST_F(PollerTest, reports_disconnect) {
     EXPECT_TRUE(reportedDisconnect);
 }
 
+TEST_F(PollerTest, edge_triggered_file_stays_registered) {
+    auto poller = std::make_shared<Poller>(3, Poller::Mode::EdgeTriggered);
+    auto server = PolledTcpServer{_server.GetEndpoint(), poller};
+    WaitEvent firstPartDone, secondPartDone;
+    std::atomic_size_t totalBytesRemaining{10};
+
+    auto pollerTask = poller->Start([&](std::shared_ptr<FileStream> f, int events) {
+        char buffer[1];
+
+        // Readiness is only reported once, so we must read everything
+        while (auto bytesRead = f->Read(buffer, sizeof(buffer)))
+            totalBytesRemaining -= bytesRead;
+
+        if (totalBytesRemaining > 5)
+            return;
+
+        firstPartDone.Signal();
+
+        if (totalBytesRemaining == 0)
+            secondPartDone.Signal();
+
+        // No need to poll it again
+    });
+
+    auto serverTask = server.Start();
+
+    {
+        auto conn = MakeConnection();
+        conn->Write("hello", 5);
+        EXPECT_TRUE(firstPartDone.Wait(1s));
+        EXPECT_EQ(1, poller->GetWatchedCount());
+        conn->Write("world", 5);
+        EXPECT_TRUE(secondPartDone.Wait(1s));
+    }
+
+    server.Stop();
+    serverTask.get();
+
+    poller->Stop();
+    pollerTask.get();
+
+    EXPECT_EQ(0, totalBytesRemaining);
+}
+
+TEST_F(PollerTest, passes_context_with_events) {
+    auto poller = std::make_shared<Poller>(3, Poller::Mode::EdgeTriggered);
+    auto context = std::make_shared<int>(42);
+    WaitEvent received;
+    std::atomic_int value{0};
+
+    auto pollerTask = poller->Start([&](std::shared_ptr<FileStream>, const std::shared_ptr<void>& ctx, int) {
+        value = *std::static_pointer_cast<int>(ctx);
+        received.Signal();
+    });
+
+    auto serverTask = _server.Start();
+
+    {
+        auto conn = MakeConnection();
+        std::this_thread::sleep_for(20ms);
+        conn->Write("hello", 5);
+
+        auto stream = std::make_shared<FileStream>(::dup(conn->GetNativeHandle()));
+        poller->Poll(stream, Poller::Events::NotifyAll, context);
+
+        EXPECT_TRUE(received.Wait(1s));
+        EXPECT_EQ(42, value);
+
+        poller->Remove(stream);
+        EXPECT_EQ(0, poller->GetWatchedCount());
+    }
+
+    _server.Stop();
+    serverTask.get();
+
+    poller->Stop();
+    pollerTask.get();
+}
+
+TEST_F(PollerTest, io_uring_signals_read_events) {
+    if (!IoUring::IsSupported())
+        GTEST_SKIP();
+
+    auto poller = std::make_shared<Poller>(3, Poller::Mode::OneShot, Poller::Backend::IoUring);
+    auto server = PolledTcpServer{_server.GetEndpoint(), poller};
+    std::atomic_int countedReadEvents{0};
+
+    EXPECT_EQ(Poller::Backend::IoUring, poller->GetBackend());
+
+    auto pollerTask = poller->Start([&](std::shared_ptr<FileStream> fs, int events) {
+        countedReadEvents += !!(events & Poller::Events::Readable);
+    });
+
+    auto serverTask = server.Start();
+
+    {
+        auto c1 = MakeConnection();
+        auto c2 = MakeConnection();
+
+        c1->Write("hello", 5);
+        c2->Write("hello", 5);
+
+        std::this_thread::sleep_for(100ms);
+    }
+
+    server.Stop();
+    serverTask.get();
+
+    poller->Stop();
+    pollerTask.get();
+
+    EXPECT_EQ(2, countedReadEvents);
+}
+
+TEST_F(PollerTest, io_uring_edge_triggered_file_stays_registered) {
+    if (!IoUring::IsSupported())
+        GTEST_SKIP();
+
+    auto poller = std::make_shared<Poller>(3, Poller::Mode::EdgeTriggered, Poller::Backend::IoUring);
+    auto server = PolledTcpServer{_server.GetEndpoint(), poller};
+    WaitEvent firstPartDone, secondPartDone;
+    std::atomic_size_t totalBytesRemaining{10};
+
+    auto pollerTask = poller->Start([&](std::shared_ptr<FileStream> f, int events) {
+        char buffer[1];
+
+        while (auto bytesRead = f->Read(buffer, sizeof(buffer)))
+            totalBytesRemaining -= bytesRead;
+
+        if (totalBytesRemaining > 5)
+            return;
+
+        firstPartDone.Signal();
+
+        if (totalBytesRemaining == 0)
+            secondPartDone.Signal();
+    });
+
+    auto serverTask = server.Start();
+
+    {
+        auto conn = MakeConnection();
+        conn->Write("hello", 5);
+        EXPECT_TRUE(firstPartDone.Wait(1s));
+        EXPECT_EQ(1, poller->GetWatchedCount());
+        conn->Write("world", 5);
+        EXPECT_TRUE(secondPartDone.Wait(1s));
+    }
+
+    std::this_thread::sleep_for(50ms);
+
+    server.Stop();
+    serverTask.get();
+
+    poller->Stop();
+    pollerTask.get();
+
+    EXPECT_EQ(0, totalBytesRemaining);
+}
+
+TEST_F(PollerTest, io_uring_receives_sockets) {
+    if (!IoUring::IsSupported())
+        GTEST_SKIP();
+
+    auto poller = std::make_shared<Poller>(1, Poller::Mode::EdgeTriggered, Poller::Backend::IoUring);
+    auto server = PolledTcpServer{_server.GetEndpoint(), poller};
+    std::string expected(0x100000, '\0');
+    std::string received;
+    WaitEvent done;
+
+    for (std::size_t i = 0; i < expected.size(); ++i)
+        expected[i] = 'a' + i % 23;
+
+    poller->SetRingReceive(true);
+
+    auto pollerTask = poller->Start([&](std::shared_ptr<FileStream> f, int events) {
+        char buffer[0x1000];
+
+        // Let the data pile up at first, so that the
+        // socket goes back to being read directly.
+        if (received.empty())
+            std::this_thread::sleep_for(50ms);
+
+        while (auto bytesRead = f->Read(buffer, sizeof(buffer)))
+            received.append(buffer, bytesRead);
+
+        if (received.size() == expected.size())
+            done.Signal();
+    });
+
+    auto serverTask = server.Start();
+
+    {
+        auto conn = MakeConnection();
+
+        for (std::size_t i = 0; i < expected.size(); i += 0x10000)
+            conn->Write(expected.data() + i, 0x10000);
+
+        EXPECT_TRUE(done.Wait(1s));
+    }
+
+    server.Stop();
+    serverTask.get();
+
+    poller->Stop();
+    pollerTask.get();
+
+    EXPECT_EQ(expected, received);
+}
+
 TEST_F(PollerTest, notifies_on_stop) {
     auto pollerTask = _poller->Start([](std::shared_ptr<FileStream>, int) {
     });
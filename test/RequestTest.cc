@@ -47,6 +47,21 @@ const char requestMissingEndOfHeaderData[] =
 
 const char requestBodyData[] = "Request body!";
 
+const char chunkedRequestHeaderData[] =
+"POST /upload HTTP/1.1\r\n"
+"Host: request.urih.com\r\n"
+"Transfer-Encoding: chunked\r\n"
+"\r\n";
+
+const char chunkedRequestBodyData[] =
+"8\r\n"
+"Request \r\n"
+"5;name=value\r\n"
+"body!\r\n"
+"0\r\n"
+"X-Trailer: ignored\r\n"
+"\r\n";
+
 const char hugeRequestHeaderData[] =
 "GET /path/to/res HTTP/1.1\r\n"
 "User-agent: Mozilla/5.0 (X11; Linux x86_64; rv:31.0) Gecko/20100101 Firefox/31.0 Iceweasel/31.8.0\r\n"
@@ -166,6 +181,18 @@ TEST_F(RequestTest, header_getters) {
     EXPECT_FALSE(r->KeepAlive());
 }
 
+TEST_F(RequestTest, header_lookup_matches_whole_names) {
+    auto r = MakeRequest(MakeContiguousInputStream());
+
+    EXPECT_EQ("request.urih.com", r->GetHeader(Header::Host));
+    EXPECT_EQ("95.35.33.46", r->GetHeader("x-REAL-ip"));
+    EXPECT_TRUE(r->HasHeader(Header::Cookie));
+    EXPECT_FALSE(r->HasHeader(Header::Expect));
+    EXPECT_FALSE(r->HasHeader("Content"));
+    EXPECT_FALSE(r->HasHeader("X-real"));
+    EXPECT_THROW(r->GetHeader(Header::Expect), std::runtime_error);
+}
+
 TEST_F(RequestTest, body) {
     auto r = MakeRequest(MakeContiguousInputStream());
 
@@ -192,6 +219,50 @@ TEST_F(RequestTest, huge_body) {
     EXPECT_EQ(expected, actual);
 }
 
+TEST_F(RequestTest, streamed_body) {
+    auto r = MakeRequest(MakeHugeAndMessyInputStream());
+
+    std::string streamed;
+    std::size_t largestSlice = 0;
+
+    r->SetContentSink([&](std::string_view data) {
+        streamed.append(data.data(), data.size());
+        largestSlice = std::max(largestSlice, data.size());
+    });
+
+    std::size_t totalBytesRead = 0;
+    while (!r->ConsumeContent(0x1000, totalBytesRead))
+        ;
+
+    EXPECT_EQ(std::string("Request body!") + std::string(10000, 'a'), streamed);
+    EXPECT_TRUE(r->IsContentAvailable());
+    EXPECT_TRUE(r->GetContent().empty());
+    EXPECT_LE(largestSlice, 0x1000);
+}
+
+TEST_F(RequestTest, streamed_chunked_body) {
+    auto stream = std::make_shared<NonContiguousInputStream>(std::initializer_list<std::string>{
+        ToString(chunkedRequestHeaderData),
+        ToString(chunkedRequestBodyData)
+    });
+
+    Request req(stream);
+    std::size_t totalBytesRead = 0;
+    std::string streamed;
+
+    ASSERT_TRUE(req.ConsumeHeader(-1, totalBytesRead));
+
+    req.SetContentSink([&](std::string_view data) {
+        streamed.append(data.data(), data.size());
+    });
+
+    while (!req.ConsumeContent(0x4, totalBytesRead))
+        ;
+
+    EXPECT_EQ("Request body!", streamed);
+    EXPECT_TRUE(req.GetContent().empty());
+}
+
 TEST_F(RequestTest, non_contiguous_header_and_body) {
     auto r = MakeRequest(MakeNonContiguousInputStream());
     std::size_t totalBytesRead = 0;
@@ -207,6 +278,145 @@ TEST_F(RequestTest, non_contiguous_header_and_body) {
     EXPECT_TRUE(r->KeepAlive());
 }
 
+TEST_F(RequestTest, chunked_body) {
+    auto body = ToString(chunkedRequestBodyData);
+    auto stream = std::make_shared<NonContiguousInputStream>(std::initializer_list<std::string>{
+        ToString(chunkedRequestHeaderData) + body.substr(0, 6),
+        body.substr(6, 20),
+        body.substr(26)
+    });
+
+    Request req(stream);
+    std::size_t totalBytesRead = 0;
+
+    ASSERT_TRUE(req.ConsumeHeader(-1, totalBytesRead));
+    EXPECT_TRUE(req.IsChunked());
+    EXPECT_TRUE(req.HasContent());
+    EXPECT_FALSE(req.IsContentAvailable());
+    EXPECT_EQ(0, req.GetContentLength());
+
+    while (!req.ConsumeContent(0x4, totalBytesRead))
+        ;
+
+    EXPECT_TRUE(req.IsContentAvailable());
+    EXPECT_EQ("Request body!", std::string(req.GetContent().data(), req.GetContent().size()));
+}
+
+TEST_F(RequestTest, chunked_body_keeps_pipelined_requests) {
+    auto stream = std::make_shared<NonContiguousInputStream>(std::initializer_list<std::string>{
+        ToString(chunkedRequestHeaderData),
+        ToString(chunkedRequestBodyData) + ToString(requestHeaderData)
+    });
+
+    Request req(stream);
+    std::size_t totalBytesRead = 0;
+
+    ASSERT_TRUE(req.ConsumeHeader(-1, totalBytesRead));
+    ASSERT_TRUE(req.ConsumeContent(-1, totalBytesRead));
+    EXPECT_EQ("Request body!", std::string(req.GetContent().data(), req.GetContent().size()));
+    EXPECT_TRUE(req.HasPipelinedData());
+
+    req.Reset();
+
+    ASSERT_TRUE(req.ConsumeHeader(-1, totalBytesRead));
+    EXPECT_EQ(0, totalBytesRead);
+    EXPECT_FALSE(req.IsChunked());
+    EXPECT_EQ(13, req.GetContentLength());
+    EXPECT_EQ("100-continue", req.GetHeader("Expect"));
+}
+
+TEST_F(RequestTest, chunked_body_after_large_header) {
+    auto header = ToString(chunkedRequestHeaderData);
+
+    // Leave no room in the request buffer past the header
+    header.insert(header.size() - 2, "X-Padding: \r\n");
+    auto padding = std::string(0x2000 - header.size(), 'p');
+    header.insert(header.size() - 4, padding);
+
+    auto stream = std::make_shared<NonContiguousInputStream>(std::initializer_list<std::string>{
+        header,
+        ToString(chunkedRequestBodyData) + ToString(requestHeaderData)
+    });
+
+    Request req(stream);
+    std::size_t totalBytesRead = 0;
+
+    ASSERT_TRUE(req.ConsumeHeader(-1, totalBytesRead));
+    EXPECT_EQ(0x2000, totalBytesRead);
+
+    while (!req.ConsumeContent(0x4, totalBytesRead))
+        ;
+
+    EXPECT_EQ("Request body!", std::string(req.GetContent().data(), req.GetContent().size()));
+    EXPECT_EQ(padding, req.GetHeader("X-Padding"));
+
+    req.Reset();
+
+    ASSERT_TRUE(req.ConsumeHeader(-1, totalBytesRead));
+    EXPECT_EQ(13, req.GetContentLength());
+    EXPECT_EQ("100-continue", req.GetHeader("Expect"));
+}
+
+TEST_F(RequestTest, reset_keeps_pipelined_requests) {
+    auto stream = std::make_shared<StringInputStream>(ToString(requestData) + ToString(requestHeaderData) + "Request");
+    Request req(stream);
+    std::size_t totalBytesRead = 0;
+
+    ASSERT_TRUE(req.ConsumeHeader(-1, totalBytesRead));
+    EXPECT_EQ(0, stream->Remaining());
+    EXPECT_FALSE(req.KeepAlive());
+
+    req.Reset();
+
+    // The whole second header was already read
+    ASSERT_TRUE(req.ConsumeHeader(-1, totalBytesRead));
+    EXPECT_EQ(0, totalBytesRead);
+    EXPECT_EQ("/path/to/res", req.GetUri());
+    EXPECT_EQ("100-continue", req.GetHeader("Expect"));
+    EXPECT_TRUE(req.KeepAlive());
+    EXPECT_FALSE(req.ConsumeContent(-1, totalBytesRead));
+}
+
+TEST_F(RequestTest, partial_pipelined_header) {
+    auto header = ToString(requestHeaderData);
+    auto stream = std::make_shared<StringInputStream>(ToString(requestData) + header.substr(0, header.size() - 1));
+    Request req(stream);
+    std::size_t totalBytesRead = 0;
+
+    ASSERT_TRUE(req.ConsumeHeader(-1, totalBytesRead));
+    EXPECT_TRUE(req.HasPipelinedData());
+    EXPECT_FALSE(req.HasPipelinedHeader());
+}
+
+TEST_F(RequestTest, complete_pipelined_header) {
+    auto stream = std::make_shared<StringInputStream>(ToString(requestData) + ToString(requestHeaderData));
+    Request req(stream);
+    std::size_t totalBytesRead = 0;
+
+    ASSERT_TRUE(req.ConsumeHeader(-1, totalBytesRead));
+    EXPECT_TRUE(req.HasPipelinedData());
+    EXPECT_TRUE(req.HasPipelinedHeader());
+}
+
+TEST_F(RequestTest, reset_reads_rest_of_partial_leftover) {
+    auto header = ToString(requestHeaderData);
+    auto stream = std::make_shared<NonContiguousInputStream>(std::initializer_list<std::string>{
+        ToString(requestData) + header.substr(0, 10),
+        header.substr(10)
+    });
+
+    Request req(stream);
+    std::size_t totalBytesRead = 0;
+
+    ASSERT_TRUE(req.ConsumeHeader(-1, totalBytesRead));
+    req.Reset();
+
+    ASSERT_TRUE(req.ConsumeHeader(-1, totalBytesRead));
+    EXPECT_EQ(header.size() - 10, totalBytesRead);
+    EXPECT_EQ(13, req.GetContentLength());
+    EXPECT_EQ("100-continue", req.GetHeader("Expect"));
+}
+
 TEST_F(RequestTest, invalid_header_throws) {
     char buffer[0x2000] = {0};
     std::fill(std::begin(buffer), std::end(buffer), 1);
@@ -0,0 +1,185 @@
+#include <gmock/gmock.h>
+
+#include "ResponseCache.h"
+
+#include <cstring>
+#include <memory>
+#include <string>
+
+using namespace ::testing;
+using namespace std::literals;
+
+namespace Chili {
+
+namespace {
+
+class StringInputStream : public InputStream {
+public:
+    StringInputStream(std::string str) :
+        _str(std::move(str)) {}
+
+    std::size_t Read(void* buffer, std::size_t bufferSize) override {
+        auto readBytes = std::min(_str.size() - _position, bufferSize);
+        std::memcpy(buffer, _str.data() + _position, readBytes);
+        _position += readBytes;
+        return readBytes;
+    }
+
+    bool EndOfStream() const override {
+        return _position == _str.size();
+    }
+
+private:
+    std::string _str;
+    std::size_t _position = 0;
+};
+
+} // unnamed namespace
+
+class ResponseCacheTest : public Test {
+protected:
+    std::unique_ptr<Request> MakeRequest(std::string requestLine, std::string headers = {}) {
+        auto data = requestLine + "\r\n" + headers + "\r\n";
+        auto request = std::make_unique<Request>(std::make_shared<StringInputStream>(data));
+        std::size_t bytesRead;
+
+        if (!request->ConsumeHeader(data.size(), bytesRead))
+            throw std::runtime_error("Bad test request");
+
+        return request;
+    }
+
+    std::shared_ptr<CachedResponse> MakeResponse(std::string content) {
+        Response response;
+        response.SetContent(std::move(content));
+        response.SetStatus(Status::Ok);
+        return response.Cache();
+    }
+};
+
+TEST_F(ResponseCacheTest, finds_inserted_response) {
+    ResponseCache cache(0x10000);
+    auto request = MakeRequest("GET /hello HTTP/1.1");
+    auto response = MakeResponse("hello");
+
+    EXPECT_EQ(nullptr, cache.Find(*request));
+    EXPECT_TRUE(cache.Insert(*request, response, 1min));
+    EXPECT_EQ(response, cache.Find(*request));
+    EXPECT_EQ(response, cache.Find(*MakeRequest("GET /hello HTTP/1.1", "Host: x\r\n")));
+    EXPECT_GT(cache.GetSize(), response->GetSize());
+}
+
+TEST_F(ResponseCacheTest, keyed_by_method_and_uri) {
+    ResponseCache cache(0x10000);
+
+    ASSERT_TRUE(cache.Insert(*MakeRequest("GET /hello HTTP/1.1"), MakeResponse("hello"), 1min));
+
+    EXPECT_EQ(nullptr, cache.Find(*MakeRequest("HEAD /hello HTTP/1.1")));
+    EXPECT_EQ(nullptr, cache.Find(*MakeRequest("GET /hello/ HTTP/1.1")));
+    EXPECT_EQ(nullptr, cache.Find(*MakeRequest("GET /hello?x=1 HTTP/1.1")));
+
+    cache.Erase(Method::Get, "/hello");
+
+    EXPECT_EQ(nullptr, cache.Find(*MakeRequest("GET /hello HTTP/1.1")));
+    EXPECT_EQ(0, cache.GetSize());
+}
+
+TEST_F(ResponseCacheTest, vary_headers_select_variant) {
+    ResponseCache cache(0x10000);
+    auto gzip = MakeRequest("GET /hello HTTP/1.1", "Accept-Encoding: gzip\r\n");
+    auto plain = MakeRequest("GET /hello HTTP/1.1");
+    auto gzipResponse = MakeResponse("gzipped");
+    auto plainResponse = MakeResponse("hello");
+
+    ASSERT_TRUE(cache.Insert(*gzip, gzipResponse, 1min, "Accept-Encoding"));
+    EXPECT_EQ(nullptr, cache.Find(*plain));
+
+    ASSERT_TRUE(cache.Insert(*plain, plainResponse, 1min, "accept-encoding, Cookie"));
+    EXPECT_EQ(plainResponse, cache.Find(*plain));
+    EXPECT_EQ(nullptr, cache.Find(*gzip)); // Vary changed
+
+    ASSERT_TRUE(cache.Insert(*gzip, gzipResponse, 1min, "accept-encoding, Cookie"));
+    EXPECT_EQ(gzipResponse, cache.Find(*gzip));
+    EXPECT_EQ(plainResponse, cache.Find(*plain));
+
+    EXPECT_FALSE(cache.Insert(*plain, plainResponse, 1min, "*"));
+}
+
+TEST_F(ResponseCacheTest, accept_encoding_keyed_by_negotiated_coding) {
+    ResponseCache cache(0x10000);
+    auto gzipResponse = MakeResponse("gzipped");
+    auto plainResponse = MakeResponse("hello");
+
+    ASSERT_TRUE(cache.Insert(*MakeRequest("GET /hello HTTP/1.1", "Accept-Encoding: gzip, deflate\r\n"),
+                             gzipResponse, 1min, "Accept-Encoding"));
+    ASSERT_TRUE(cache.Insert(*MakeRequest("GET /hello HTTP/1.1", "Accept-Encoding: identity\r\n"),
+                             plainResponse, 1min, "Accept-Encoding"));
+
+    EXPECT_EQ(gzipResponse, cache.Find(*MakeRequest("GET /hello HTTP/1.1", "Accept-Encoding: deflate;q=0.5, gzip\r\n")));
+    EXPECT_EQ(gzipResponse, cache.Find(*MakeRequest("GET /hello HTTP/1.1", "Accept-Encoding: br, gzip\r\n")));
+    EXPECT_EQ(plainResponse, cache.Find(*MakeRequest("GET /hello HTTP/1.1", "Accept-Encoding: br\r\n")));
+    EXPECT_EQ(nullptr, cache.Find(*MakeRequest("GET /hello HTTP/1.1", "Accept-Encoding: deflate\r\n")));
+}
+
+TEST_F(ResponseCacheTest, expired_response_not_found) {
+    ResponseCache cache(0x10000);
+    auto request = MakeRequest("GET /hello HTTP/1.1");
+
+    ASSERT_TRUE(cache.Insert(*request, MakeResponse("hello"), 0ms));
+    EXPECT_EQ(nullptr, cache.Find(*request));
+    EXPECT_EQ(0, cache.GetSize());
+}
+
+TEST_F(ResponseCacheTest, lru_evicts_least_recently_used) {
+    auto size = MakeResponse(std::string(0x100, 'x'))->GetSize() + 4;
+    ResponseCache cache(2 * size, ResponseCache::Eviction::Lru, 1);
+    auto a = MakeRequest("GET /a HTTP/1.1");
+    auto b = MakeRequest("GET /b HTTP/1.1");
+    auto c = MakeRequest("GET /c HTTP/1.1");
+
+    ASSERT_TRUE(cache.Insert(*a, MakeResponse(std::string(0x100, 'a')), 1min));
+    ASSERT_TRUE(cache.Insert(*b, MakeResponse(std::string(0x100, 'b')), 1min));
+    ASSERT_NE(nullptr, cache.Find(*a));
+    ASSERT_TRUE(cache.Insert(*c, MakeResponse(std::string(0x100, 'c')), 1min));
+
+    EXPECT_NE(nullptr, cache.Find(*a));
+    EXPECT_EQ(nullptr, cache.Find(*b));
+    EXPECT_NE(nullptr, cache.Find(*c));
+    EXPECT_LE(cache.GetSize(), 2 * size);
+
+    EXPECT_FALSE(cache.Insert(*b, MakeResponse(std::string(0x1000, 'b')), 1min));
+}
+
+TEST_F(ResponseCacheTest, tiny_lfu_keeps_frequently_requested) {
+    auto size = MakeResponse(std::string(0x100, 'x'))->GetSize() + 4;
+    ResponseCache cache(2 * size, ResponseCache::Eviction::TinyLfu, 1);
+    auto hot = MakeRequest("GET /a HTTP/1.1");
+    auto warm = MakeRequest("GET /b HTTP/1.1");
+    auto cold = MakeRequest("GET /c HTTP/1.1");
+
+    cache.Find(*hot);
+    ASSERT_TRUE(cache.Insert(*hot, MakeResponse(std::string(0x100, 'a')), 1min));
+
+    for (int i = 0; i < 5; ++i)
+        ASSERT_NE(nullptr, cache.Find(*hot));
+
+    cache.Find(*warm);
+    ASSERT_TRUE(cache.Insert(*warm, MakeResponse(std::string(0x100, 'b')), 1min));
+    ASSERT_NE(nullptr, cache.Find(*warm));
+
+    // The least recently used resource is the hot one,
+    // and it's more popular than the cold one.
+    cache.Find(*cold);
+    EXPECT_FALSE(cache.Insert(*cold, MakeResponse(std::string(0x100, 'c')), 1min));
+    EXPECT_NE(nullptr, cache.Find(*hot));
+    EXPECT_NE(nullptr, cache.Find(*warm));
+
+    // Once it's been requested as often, it gets in
+    for (int i = 0; i < 10; ++i)
+        cache.Find(*cold);
+
+    EXPECT_TRUE(cache.Insert(*cold, MakeResponse(std::string(0x100, 'c')), 1min));
+    EXPECT_NE(nullptr, cache.Find(*cold));
+}
+
+} // namespace Chili
@@ -1,13 +1,19 @@
 #include <gmock/gmock.h>
 
+#include "HttpDate.h"
 #include "Response.h"
+#include "TestFileUtils.h"
+#include "TestUtils.h"
 
 #include <algorithm>
+#include <charconv>
 #include <chrono>
 #include <ctime>
 #include <cstring>
 #include <sstream>
+#include <thread>
 #include <time.h> // some functions aren't in <ctime>
+#include <unistd.h>
 
 using namespace ::testing;
 
@@ -19,15 +25,25 @@ class StringOutputStream : public OutputStream {
 public:
     std::size_t Write(const void* buffer, std::size_t bufferSize) override {
         _stream.write(static_cast<const char*>(buffer), bufferSize);
+        ++_writeCount;
         return bufferSize;
     }
 
     std::string ToString() const {
+        return RemoveDateHeaders(_stream.str());
+    }
+
+    std::string GetData() const {
         return _stream.str();
     }
 
+    std::size_t GetWriteCount() const {
+        return _writeCount;
+    }
+
 private:
     std::ostringstream _stream;
+    std::size_t _writeCount = 0;
 };
 
 class ChunkedStringInputStream : public InputStream {
@@ -58,6 +74,27 @@ private:
     std::size_t _currentChunk = 0;
 };
 
+class StringInputStream : public InputStream {
+public:
+    StringInputStream(std::string data) :
+        _data(std::move(data)) {}
+
+    std::size_t Read(void* buffer, std::size_t size) override {
+        auto n = std::min(size, _data.size() - _position);
+        std::memcpy(buffer, _data.data() + _position, n);
+        _position += n;
+        return n;
+    }
+
+    bool EndOfStream() const override {
+        return _position == _data.size();
+    }
+
+private:
+    std::string _data;
+    std::size_t _position = 0;
+};
+
 } // unnamed namespace
 
 class ResponseTest : public Test {
@@ -79,6 +116,26 @@ protected:
         return std::make_shared<ChunkedStringInputStream>(std::move(chunks));
     }
 
+    std::pair<std::string, std::string> SplitHead(const std::string& data) const {
+        auto headSize = data.find("\r\n\r\n") + 4;
+        return {data.substr(0, headSize), data.substr(headSize)};
+    }
+
+    std::string Dechunk(std::string_view data) const {
+        std::string result;
+
+        while (!data.empty()) {
+            auto size = std::size_t(0);
+            auto [end, ec] = std::from_chars(data.data(), data.data() + data.size(), size, 16);
+            auto chunk = data.substr(end + 2 - data.data(), size);
+
+            result += chunk;
+            data.remove_prefix(chunk.data() + size + 2 - data.data());
+        }
+
+        return result;
+    }
+
     void Flush(std::unique_ptr<Response>& r, std::size_t quota = 1) {
         std::size_t consumed;
         while (r->Flush(quota, consumed) != Response::FlushStatus::Done)
@@ -96,6 +153,37 @@ TEST_F(ResponseTest, just_status) {
     EXPECT_EQ("HTTP/1.1 100 Continue\r\nContent-Length: 0\r\n\r\n", stream->ToString());
 }
 
+TEST_F(ResponseTest, date_header) {
+    auto stream = MakeStream();
+    auto r = MakeResponse(stream);
+    char before[HttpDate::Length];
+    char after[HttpDate::Length];
+
+    HttpDate::Get(before);
+    r->SetStatus(Status::NoContent);
+    HttpDate::Get(after);
+    Flush(r, 0x100);
+
+    auto prefix = std::string("HTTP/1.1 204 No Content\r\nDate: ");
+    auto data = stream->GetData();
+    auto date = data.substr(prefix.size(), HttpDate::Length);
+
+    ASSERT_EQ(prefix, data.substr(0, prefix.size()));
+    EXPECT_THAT(date, AnyOf(std::string(before, sizeof(before)), std::string(after, sizeof(after))));
+
+    // Unless the handler sets its own
+    stream = MakeStream();
+    r = MakeResponse(stream);
+    r->AppendHeader("Date", "Sun, 06 Nov 1994 08:49:37 GMT");
+    r->SetStatus(Status::NoContent);
+    Flush(r, 0x100);
+
+    EXPECT_EQ("HTTP/1.1 204 No Content\r\n"
+              "Date: Sun, 06 Nov 1994 08:49:37 GMT\r\n"
+              "Content-Length: 0\r\n"
+              "\r\n", stream->GetData());
+}
+
 TEST_F(ResponseTest, some_headers) {
     auto stream = MakeStream();
     auto r = MakeResponse(stream);
@@ -114,6 +202,31 @@ TEST_F(ResponseTest, some_headers) {
     EXPECT_EQ(expected, stream->ToString());
 }
 
+TEST_F(ResponseTest, headers_in_arena) {
+    auto stream = MakeStream();
+    auto arena = MonotonicArena();
+    auto r = std::make_unique<Response>(stream, std::make_shared<Signal<>>(), SlabAllocator<CachedResponse>(), &arena);
+
+    {
+        auto value = std::string("Hello world!");
+        r->AppendHeader("First", value);
+    }
+
+    EXPECT_LT(0, arena.GetBytesUsed());
+
+    r->SetStatus(Status::Ok);
+    auto cached = r->Cache();
+    arena.Reset();
+    Flush(r);
+
+    auto expected = "HTTP/1.1 200 OK\r\n"
+        "First: Hello world!\r\n"
+        "Content-Length: 0\r\n"
+        "\r\n";
+
+    EXPECT_EQ(expected, RemoveHeaders(stream->ToString(), "ETag"));
+}
+
 TEST_F(ResponseTest, headers_and_body) {
     auto stream = MakeStream();
     auto r = MakeResponse(stream);
@@ -251,7 +364,469 @@ TEST_F(ResponseTest, send_cached) {
 	"Content-Length: 0\r\n"
         "\r\n";
 
-    EXPECT_EQ(expected, stream->ToString());
+    EXPECT_EQ(expected, RemoveHeaders(stream->ToString(), "ETag"));
+}
+
+TEST_F(ResponseTest, send_cached_wire_variants) {
+    auto r = MakeResponse(MakeStream());
+    r->AppendHeader("Server", "Chili");
+    r->KeepConnectionAlive();
+    r->SetContent(std::string("hello"));
+    r->SetStatus(Status::Ok);
+    auto cached = r->Cache();
+
+    auto head = std::string("HTTP/1.1 200 OK\r\n"
+                            "Server: Chili\r\n"
+                            "Content-Length: 5\r\n");
+
+    auto keepAliveStream = MakeStream();
+    r = MakeResponse(keepAliveStream);
+    r->UseCached(cached);
+    EXPECT_TRUE(r->GetKeepAlive());
+    Flush(r, 0x100);
+
+    EXPECT_EQ(head + "\r\nhello", RemoveHeaders(keepAliveStream->ToString(), "ETag"));
+    EXPECT_EQ(1, keepAliveStream->GetWriteCount());
+
+    auto closeStream = MakeStream();
+    r = MakeResponse(closeStream);
+    r->CloseConnection();
+    r->UseCached(cached);
+    EXPECT_FALSE(r->GetKeepAlive());
+    Flush(r, 0x100);
+
+    EXPECT_EQ(head + "Connection: close\r\n\r\nhello", RemoveHeaders(closeStream->ToString(), "ETag"));
+    EXPECT_EQ(1, closeStream->GetWriteCount());
+
+    // The cached response itself is left alone
+    closeStream = MakeStream();
+    r = MakeResponse(closeStream);
+    r->UseCached(cached);
+    r->CloseConnection();
+    Flush(r, 0x100);
+
+    EXPECT_EQ(head + "Connection: close\r\n\r\nhello", RemoveHeaders(closeStream->ToString(), "ETag"));
+    EXPECT_TRUE(cached == r->Cache());
+}
+
+TEST_F(ResponseTest, compressed_content) {
+    auto stream = MakeStream();
+    auto r = MakeResponse(stream);
+    auto text = std::string(0x1000, 'x');
+
+    r->SetContent(text);
+    r->Compress("deflate, gzip");
+    r->SetStatus(Status::Ok);
+    Flush(r, 0x10000);
+
+    auto [head, body] = SplitHead(stream->ToString());
+
+    EXPECT_EQ("HTTP/1.1 200 OK\r\n"
+              "Vary: Accept-Encoding\r\n"
+              "Content-Encoding: gzip\r\n"
+              "Content-Length: " + std::to_string(body.size()) + "\r\n"
+              "\r\n", head);
+    EXPECT_LT(body.size(), text.size());
+    EXPECT_EQ(text, Decompress(body));
+}
+
+TEST_F(ResponseTest, compression_skipped) {
+    auto stream = MakeStream();
+    auto r = MakeResponse(stream);
+
+    // Too small to be worth it
+    r->SetContent(std::string("hello"));
+    r->Compress("gzip");
+    r->SetStatus(Status::Ok);
+    Flush(r, 0x100);
+
+    EXPECT_EQ("HTTP/1.1 200 OK\r\n"
+              "Vary: Accept-Encoding\r\n"
+              "Content-Length: 5\r\n"
+              "\r\n"
+              "hello", stream->ToString());
+
+    // Not accepted by the client
+    stream = MakeStream();
+    r = MakeResponse(stream);
+    r->AppendHeader("Vary", "Cookie");
+    r->SetContent(std::string(0x1000, 'x'));
+    r->Compress("gzip;q=0");
+    r->SetStatus(Status::Ok);
+    Flush(r, 0x10000);
+
+    EXPECT_EQ("HTTP/1.1 200 OK\r\n"
+              "Vary: Cookie, Accept-Encoding\r\n"
+              "Content-Length: 4096\r\n"
+              "\r\n" + std::string(0x1000, 'x'), stream->ToString());
+}
+
+TEST_F(ResponseTest, compression_varies_on_whole_tokens) {
+    auto stream = MakeStream();
+    auto r = MakeResponse(stream);
+    auto text = std::string(0x1000, 'x');
+
+    // Merely containing the name isn't varying on it
+    r->AppendHeader("Vary", "X-Accept-Encoding-Hint");
+    r->SetContent(text);
+    r->Compress("gzip");
+    r->SetStatus(Status::Ok);
+    Flush(r, 0x10000);
+
+    auto head = SplitHead(stream->ToString()).first;
+
+    EXPECT_THAT(head, HasSubstr("Vary: X-Accept-Encoding-Hint, Accept-Encoding\r\n"));
+
+    // And the same goes for cached responses
+    r = MakeResponse(MakeStream());
+    r->AppendHeader("Vary", "X-Accept-Encoding-Hint");
+    r->SetContent(text);
+    r->SetStatus(Status::Ok);
+    auto cached = r->Cache();
+
+    stream = MakeStream();
+    r = MakeResponse(stream);
+    r->SetCompression(Compression::Gzip);
+    r->UseCached(cached);
+    Flush(r, 0x10000);
+
+    head = SplitHead(stream->ToString()).first;
+
+    EXPECT_THAT(head, HasSubstr("Vary: X-Accept-Encoding-Hint, Accept-Encoding\r\n"));
+    EXPECT_THAT(head, HasSubstr("Content-Encoding: gzip\r\n"));
+}
+
+TEST_F(ResponseTest, compressed_stream) {
+    auto stream = MakeStream();
+    auto r = MakeResponse(stream);
+    auto text = std::string();
+    auto chunks = std::vector<std::string>();
+
+    for (char c = 'a'; c < 'e'; ++c) {
+        chunks.push_back(std::string(0x100, c));
+        text += chunks.back();
+    }
+
+    r->SetContent(MakeChunkedStream(chunks));
+    r->SetCompression(Compression::Deflate);
+    r->SetStatus(Status::Ok);
+
+    std::size_t consumed = 0;
+    while (r->Flush(0x10000, consumed) != Response::FlushStatus::Done)
+        ;
+
+    auto [head, body] = SplitHead(stream->ToString());
+
+    EXPECT_EQ("HTTP/1.1 200 OK\r\n"
+              "Transfer-Encoding: chunked\r\n"
+              "Content-Encoding: deflate\r\n"
+              "\r\n", head);
+    EXPECT_EQ(text, Decompress(Dechunk(body)));
+}
+
+TEST_F(ResponseTest, cached_compressed_variant) {
+    auto r = MakeResponse(MakeStream());
+    auto text = std::string(0x1000, 'x');
+
+    r->SetContent(text);
+    r->SetStatus(Status::Ok);
+    auto cached = r->Cache();
+
+    auto send = [&](Compression compression, bool keepAlive) {
+        auto stream = MakeStream();
+        auto r = MakeResponse(stream);
+
+        if (!keepAlive)
+            r->CloseConnection();
+
+        r->SetCompression(compression);
+        r->UseCached(cached);
+        Flush(r, 0x10000);
+
+        return SplitHead(stream->ToString());
+    };
+
+    auto [head, body] = send(Compression::Gzip, true);
+
+    EXPECT_EQ("HTTP/1.1 200 OK\r\n"
+              "Vary: Accept-Encoding\r\n"
+              "Content-Encoding: gzip\r\n"
+              "Content-Length: " + std::to_string(body.size()) + "\r\n"
+              "\r\n", RemoveHeaders(head, "ETag"));
+    EXPECT_THAT(head, HasSubstr("-gzip\"\r\n"));
+    EXPECT_EQ(text, Decompress(body));
+
+    // Compressed once, and then reused
+    EXPECT_EQ(std::make_pair(head, body), send(Compression::Gzip, true));
+
+    auto [closeHead, closeBody] = send(Compression::Gzip, false);
+
+    EXPECT_EQ(head.substr(0, head.size() - 2) + "Connection: close\r\n\r\n", closeHead);
+    EXPECT_EQ(body, closeBody);
+
+    EXPECT_EQ(text, send(Compression::None, true).second);
+    EXPECT_EQ(text, Decompress(send(Compression::Deflate, true).second));
+}
+
+TEST_F(ResponseTest, file_content) {
+    auto file = std::make_shared<FileStream>(OpenTempFile());
+    auto output = std::make_shared<FileStream>(OpenTempFile());
+    auto r = std::make_unique<Response>(output, std::make_shared<Signal<>>());
+
+    file->Write("0123456789", 10);
+
+    r->SetContent(file, 2, 5);
+    r->SetStatus(Status::Ok);
+
+    std::size_t consumed;
+    while (r->Flush(3, consumed) != Response::FlushStatus::Done)
+        ;
+
+    auto expected = std::string("HTTP/1.1 200 OK\r\n"
+        "Content-Length: 5\r\n"
+        "\r\n"
+        "23456");
+
+    std::string actual(expected.size() + 0x100, '\0');
+    actual.resize(::pread(output->GetNativeHandle(), actual.data(), actual.size(), 0));
+
+    EXPECT_EQ(expected, RemoveHeaders(RemoveHeaders(RemoveDateHeaders(actual), "ETag"), "Last-Modified"));
+    EXPECT_FALSE(r->IsBuffered());
+
+    // The file position isn't changed
+    EXPECT_EQ(10, ::lseek(file->GetNativeHandle(), 0, SEEK_CUR));
+}
+
+TEST_F(ResponseTest, file_content_to_other_output) {
+    auto file = std::make_shared<FileStream>(OpenTempFile());
+    auto output = std::make_shared<StringOutputStream>();
+    auto r = std::make_unique<Response>(output, std::make_shared<Signal<>>());
+    auto content = std::string(0x2800, 'f');
+
+    file->Write(content.data(), content.size());
+
+    r->SetContent(file, 0, content.size());
+    r->SetStatus(Status::Ok);
+
+    Flush(r, 0x100);
+
+    auto expected = "HTTP/1.1 200 OK\r\n"
+                    "Content-Length: 10240\r\n"
+                    "\r\n" + content;
+
+    EXPECT_EQ(expected, RemoveHeaders(RemoveHeaders(output->ToString(), "ETag"), "Last-Modified"));
+}
+
+TEST_F(ResponseTest, file_cached_wire_variants) {
+    auto file = std::make_shared<FileStream>(OpenTempFile());
+    auto r = std::make_unique<Response>(std::make_shared<FileStream>(OpenTempFile()), std::make_shared<Signal<>>());
+
+    file->Write("0123456789", 10);
+
+    r->KeepConnectionAlive();
+    r->SetContent(file, 2, 5);
+    r->SetStatus(Status::Ok);
+    auto cached = r->Cache();
+
+    auto send = [&](bool close) {
+        auto output = std::make_shared<FileStream>(OpenTempFile());
+        auto r = std::make_unique<Response>(output, std::make_shared<Signal<>>());
+        r->UseCached(cached);
+
+        if (close)
+            r->CloseConnection();
+
+        EXPECT_EQ(!close, r->GetKeepAlive());
+
+        std::size_t consumed;
+        while (r->Flush(0x100, consumed) != Response::FlushStatus::Done)
+            ;
+
+        std::string actual(0x100, '\0');
+        actual.resize(::pread(output->GetNativeHandle(), actual.data(), actual.size(), 0));
+
+        return RemoveHeaders(RemoveHeaders(RemoveDateHeaders(actual), "ETag"), "Last-Modified");
+    };
+
+    auto head = std::string("HTTP/1.1 200 OK\r\n"
+                            "Content-Length: 5\r\n");
+
+    // Closing one connection doesn't close the other
+    EXPECT_EQ(head + "Connection: close\r\n\r\n23456", send(true));
+    EXPECT_EQ(head + "\r\n23456", send(false));
+}
+
+TEST_F(ResponseTest, file_cached_date_refreshed) {
+    auto file = std::make_shared<FileStream>(OpenTempFile());
+    auto r = std::make_unique<Response>(std::make_shared<FileStream>(OpenTempFile()), std::make_shared<Signal<>>());
+
+    file->Write("0123456789", 10);
+
+    r->SetContent(file, 2, 5);
+    r->SetStatus(Status::Ok);
+    auto cached = r->Cache();
+
+    char stale[HttpDate::Length];
+    HttpDate::Get(stale);
+
+    // Wait for the next second
+    char before[HttpDate::Length];
+
+    do {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        HttpDate::Get(before);
+    } while (!std::memcmp(before, stale, sizeof(stale)));
+
+    auto send = [&](bool notModified) {
+        auto output = std::make_shared<FileStream>(OpenTempFile());
+        auto r = std::make_unique<Response>(output, std::make_shared<Signal<>>());
+        r->UseCached(cached);
+
+        if (notModified)
+            r->SetNotModified();
+
+        std::size_t consumed;
+        while (r->Flush(0x100, consumed) != Response::FlushStatus::Done)
+            ;
+
+        std::string actual(0x100, '\0');
+        actual.resize(::pread(output->GetNativeHandle(), actual.data(), actual.size(), 0));
+
+        auto dateStart = actual.find("\r\nDate: ") + 8;
+        return actual.substr(dateStart, HttpDate::Length);
+    };
+
+    auto date = send(false);
+    auto notModifiedDate = send(true);
+
+    char after[HttpDate::Length];
+    HttpDate::Get(after);
+
+    EXPECT_THAT(date, AnyOf(std::string(before, sizeof(before)), std::string(after, sizeof(after))));
+    EXPECT_THAT(notModifiedDate, AnyOf(std::string(before, sizeof(before)), std::string(after, sizeof(after))));
+}
+
+TEST_F(ResponseTest, file_shrunk) {
+    auto file = std::make_shared<FileStream>(OpenTempFile());
+    auto output = std::make_shared<FileStream>(OpenTempFile());
+    auto r = std::make_unique<Response>(output, std::make_shared<Signal<>>());
+
+    file->Write("0123456789", 10);
+
+    r->SetContent(file, 2, 5);
+    r->SetStatus(Status::Ok);
+
+    ASSERT_EQ(0, ::ftruncate(file->GetNativeHandle(), 4));
+
+    auto flush = [&] {
+        std::size_t consumed;
+        while (r->Flush(0x100, consumed) != Response::FlushStatus::Done)
+            ;
+    };
+
+    // It would never be done otherwise
+    EXPECT_THROW(flush(), std::runtime_error);
+}
+
+TEST_F(ResponseTest, cached_not_modified) {
+    auto r = MakeResponse(MakeStream());
+    r->AppendHeader("Cache-Control", "max-age=60");
+    r->AppendHeader("Server", "Chili");
+    r->SetContent(std::string("hello"));
+    r->SetStatus(Status::Ok);
+    auto cached = r->Cache();
+
+    auto stream = MakeStream();
+    r = MakeResponse(stream);
+    r->UseCached(cached);
+    Flush(r, 0x100);
+
+    auto output = stream->ToString();
+    auto etagStart = output.find("\r\nETag: ") + 8;
+    auto etag = output.substr(etagStart, output.find("\r\n", etagStart) - etagStart);
+
+    ASSERT_EQ('"', etag.front());
+    ASSERT_EQ('"', etag.back());
+
+    r = MakeResponse(MakeStream());
+    r->UseCached(cached);
+
+    EXPECT_FALSE(r->IsNotModified("", ""));
+    EXPECT_FALSE(r->IsNotModified("\"other\"", ""));
+    EXPECT_TRUE(r->IsNotModified(etag, ""));
+    EXPECT_TRUE(r->IsNotModified("\"other\", W/" + etag, ""));
+    EXPECT_TRUE(r->IsNotModified("*", ""));
+
+    stream = MakeStream();
+    r = MakeResponse(stream);
+    r->CloseConnection();
+    r->UseCached(cached);
+    r->SetNotModified();
+    Flush(r, 0x100);
+
+    EXPECT_EQ(Status::NotModified, r->GetStatus());
+    EXPECT_EQ("HTTP/1.1 304 Not Modified\r\n"
+              "Cache-Control: max-age=60\r\n"
+              "ETag: " + etag + "\r\n"
+              "Connection: close\r\n"
+              "\r\n", stream->ToString());
+}
+
+TEST_F(ResponseTest, file_not_modified) {
+    auto file = std::make_shared<FileStream>(OpenTempFile());
+    auto output = std::make_shared<FileStream>(OpenTempFile());
+    auto r = std::make_unique<Response>(output, std::make_shared<Signal<>>());
+
+    file->Write("0123456789", 10);
+
+    r->AppendHeader("Server", "Chili");
+    r->SetContent(file, 2, 5);
+    r->SetStatus(Status::Ok);
+
+    std::string_view etag;
+    std::string_view lastModified;
+    char modified[HttpDate::Length];
+    char earlier[HttpDate::Length];
+
+    HttpDate::Format(file->GetModificationTime(), modified);
+    HttpDate::Format(file->GetModificationTime() - 1, earlier);
+
+    ASSERT_TRUE(r->GetHeader("ETag", &etag));
+    ASSERT_TRUE(r->GetHeader("Last-Modified", &lastModified));
+    EXPECT_EQ(std::string_view(modified, sizeof(modified)), lastModified);
+
+    EXPECT_TRUE(r->IsNotModified("", {modified, sizeof(modified)}));
+    EXPECT_FALSE(r->IsNotModified("", {earlier, sizeof(earlier)}));
+    EXPECT_FALSE(r->IsNotModified("", "yesterday"));
+
+    // If-None-Match takes precedence
+    EXPECT_TRUE(r->IsNotModified(etag, {earlier, sizeof(earlier)}));
+    EXPECT_FALSE(r->IsNotModified("\"other\"", {modified, sizeof(modified)}));
+
+    auto expected = "HTTP/1.1 304 Not Modified\r\n"
+        "ETag: " + std::string(etag) + "\r\n"
+        "Last-Modified: " + std::string(lastModified) + "\r\n"
+        "\r\n";
+
+    r->SetNotModified();
+
+    std::size_t consumed;
+    while (r->Flush(0x100, consumed) != Response::FlushStatus::Done)
+        ;
+
+    std::string actual(0x100, '\0');
+    actual.resize(::pread(output->GetNativeHandle(), actual.data(), actual.size(), 0));
+
+    EXPECT_EQ(expected, RemoveDateHeaders(actual));
+}
+
+TEST_F(ResponseTest, file_content_past_end_throws) {
+    auto file = std::make_shared<FileStream>(OpenTempFile());
+    auto r = MakeResponse(MakeStream());
+
+    file->Write("0123456789", 10);
+
+    EXPECT_THROW(r->SetContent(file, 8, 5), std::runtime_error);
 }
 
 TEST_F(ResponseTest, chunked) {
@@ -286,5 +861,90 @@ TEST_F(ResponseTest, chunked) {
     EXPECT_EQ(expected, stream->ToString());
 }
 
-} // namespace Chili
+TEST_F(ResponseTest, chunked_with_fixed_size) {
+    auto stream = MakeStream();
+    auto r = MakeResponse(stream);
+
+    r->SetChunkSize(4);
+    r->SetContent(std::make_shared<StringInputStream>("hello world"));
+    r->SetStatus(Status::Ok);
+    Flush(r, 0x100);
+
+    auto expected = "HTTP/1.1 200 OK\r\n"
+        "Transfer-Encoding: chunked\r\n"
+        "\r\n"
+        "4\r\n"
+        "hell\r\n"
+        "4\r\n"
+        "o wo\r\n"
+        "3\r\n"
+        "rld\r\n"
+        "0\r\n"
+        "\r\n";
+
+    EXPECT_EQ(expected, stream->ToString());
+}
+
+TEST_F(ResponseTest, chunked_with_adaptive_size) {
+    auto stream = MakeStream();
+    auto r = MakeResponse(stream);
+
+    r->SetChunkSize(2, 16);
+    r->SetContent(std::make_shared<StringInputStream>("abcdefghijklmnopqrstuvwxyz0123"));
+    r->SetStatus(Status::Ok);
+    Flush(r, 0x100);
+
+    auto expected = "HTTP/1.1 200 OK\r\n"
+        "Transfer-Encoding: chunked\r\n"
+        "\r\n"
+        "2\r\n"
+        "ab\r\n"
+        "4\r\n"
+        "cdef\r\n"
+        "8\r\n"
+        "ghijklmn\r\n"
+        "10\r\n"
+        "opqrstuvwxyz0123\r\n"
+        "0\r\n"
+        "\r\n";
 
+    EXPECT_EQ(expected, stream->ToString());
+}
+
+TEST_F(ResponseTest, chunks_gathered_into_one_write) {
+    auto stream = MakeStream();
+    auto r = MakeResponse(stream);
+
+    auto data = MakeChunkedStream({
+        "<b>",
+        "hello ",
+        "world",
+        "</b>"
+    });
+
+    r->SetContent(data);
+    r->SetStatus(Status::Ok);
+
+    std::size_t consumed = 0;
+    ASSERT_EQ(Response::FlushStatus::Done, r->Flush(0x1000, consumed));
+
+    auto expected = "HTTP/1.1 200 OK\r\n"
+        "Transfer-Encoding: chunked\r\n"
+        "\r\n"
+        "3\r\n"
+        "<b>\r\n"
+        "6\r\n"
+        "hello \r\n"
+        "5\r\n"
+        "world\r\n"
+        "4\r\n"
+        "</b>\r\n"
+        "0\r\n"
+        "\r\n";
+
+    EXPECT_EQ(expected, stream->ToString());
+    EXPECT_EQ(std::strlen(expected) + std::strlen("\r\nDate: ") + HttpDate::Length, consumed);
+    EXPECT_EQ(1, stream->GetWriteCount());
+}
+
+} // namespace Chili
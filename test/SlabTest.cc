@@ -0,0 +1,117 @@
+#include <gmock/gmock.h>
+
+#include "Slab.h"
+
+#include <memory>
+#include <vector>
+
+using namespace ::testing;
+
+namespace Chili {
+
+class SlabTest : public Test {
+public:
+    SlabTest() :
+        _cache{std::make_shared<SlabCache>(4)} {}
+
+protected:
+    std::shared_ptr<SlabCache> _cache;
+};
+
+TEST_F(SlabTest, recycles_blocks) {
+    auto mem = _cache->Allocate(100);
+    auto capacity = _cache->GetCapacity(100);
+
+    EXPECT_LT(0, capacity);
+    EXPECT_EQ(capacity - 1, _cache->GetFreeBlocks(100));
+
+    _cache->Deallocate(mem, 100);
+    EXPECT_EQ(capacity, _cache->GetFreeBlocks(100));
+
+    EXPECT_EQ(mem, _cache->Allocate(128));
+    _cache->Deallocate(mem, 128);
+}
+
+TEST_F(SlabTest, size_classes_are_separate) {
+    auto mem = _cache->Allocate(SlabCache::MaxBlockSize);
+
+    EXPECT_EQ(0, _cache->GetCapacity(SlabCache::MinBlockSize));
+    EXPECT_EQ(_cache->GetCapacity(SlabCache::MaxBlockSize) - 1, _cache->GetFreeBlocks(SlabCache::MaxBlockSize));
+
+    _cache->Deallocate(mem, SlabCache::MaxBlockSize);
+}
+
+TEST_F(SlabTest, grows_when_exhausted) {
+    std::vector<void*> blocks;
+
+    blocks.push_back(_cache->Allocate(1000));
+
+    auto capacity = _cache->GetCapacity(1000);
+
+    while (_cache->GetFreeBlocks(1000))
+        blocks.push_back(_cache->Allocate(1000));
+
+    blocks.push_back(_cache->Allocate(1000));
+    EXPECT_EQ(2 * capacity, _cache->GetCapacity(1000));
+
+    // This one comes from the heap
+    auto huge = _cache->Allocate(SlabCache::MaxBlockSize + 1);
+    _cache->Deallocate(huge, SlabCache::MaxBlockSize + 1);
+
+    for (auto b : blocks)
+        _cache->Deallocate(b, 1000);
+
+    EXPECT_EQ(2 * capacity, _cache->GetFreeBlocks(1000));
+}
+
+TEST_F(SlabTest, releases_idle_memory) {
+    std::vector<void*> blocks;
+
+    // Bigger blocks are hardly kept in thread caches,
+    // so some of their arenas end up entirely idle.
+    for (int i = 0; i < 0x10; ++i)
+        blocks.push_back(_cache->Allocate(SlabCache::MaxBlockSize));
+
+    for (auto b : blocks)
+        _cache->Deallocate(b, SlabCache::MaxBlockSize);
+
+    EXPECT_LT(0, _cache->ReleaseIdleMemory());
+    EXPECT_EQ(0, _cache->ReleaseIdleMemory());
+
+    // Their memory is there again when allocated from
+    blocks.clear();
+
+    for (int i = 0; i < 0x10; ++i) {
+        blocks.push_back(_cache->Allocate(SlabCache::MaxBlockSize));
+        static_cast<char*>(blocks.back())[SlabCache::MaxBlockSize - 1] = 'x';
+    }
+
+    for (auto b : blocks)
+        _cache->Deallocate(b, SlabCache::MaxBlockSize);
+}
+
+TEST_F(SlabTest, allocates_shared_objects) {
+    struct Object {
+        int Values[20];
+    };
+
+    {
+        auto obj = std::allocate_shared<Object>(SlabAllocator<Object>(_cache));
+        obj->Values[19] = 42;
+
+        // The control block takes a little more room, but
+        // not enough to go beyond the object's size class.
+        EXPECT_EQ(_cache->GetCapacity(sizeof(Object)) - 1, _cache->GetFreeBlocks(sizeof(Object)));
+    }
+
+    EXPECT_EQ(_cache->GetCapacity(sizeof(Object)), _cache->GetFreeBlocks(sizeof(Object)));
+}
+
+TEST_F(SlabTest, default_allocator_uses_heap) {
+    auto v = std::vector<char, SlabAllocator<char>>(1000);
+    v[999] = 'x';
+    EXPECT_EQ(nullptr, v.get_allocator().GetCache());
+}
+
+} // namespace Chili
+
@@ -1,11 +1,14 @@
 #include <gmock/gmock.h>
 
+#include "TcpAcceptor.h"
 #include "TcpConnection.h"
 #include "TestUtils.h"
 #include "ThreadedTcpServer.h"
 #include "Timeout.h"
 
 #include <chrono>
+#include <mutex>
+#include <vector>
 
 using namespace ::testing;
 using namespace std::literals;
@@ -27,6 +30,10 @@ protected:
         return std::make_unique<ThreadedTcpServer>(_testEp, std::make_shared<ThreadPool>(tc._n));
     }
 
+    std::unique_ptr<TcpAcceptor> CreateAcceptor(Poller::Backend backend) {
+        return std::make_unique<TcpAcceptor>(_testEp, 1, backend);
+    }
+
     std::unique_ptr<TcpConnection> CreateClient() {
         return std::make_unique<TcpConnection>(_testEp);
     }
@@ -67,6 +74,40 @@ TEST_F(TcpTest, hello_goodbye) {
     task.get();
 }
 
+TEST_F(TcpTest, multishot_accept) {
+    if (!IoUring::IsSupported())
+        GTEST_SKIP();
+
+    auto acceptor = CreateAcceptor(Poller::Backend::IoUring);
+    auto endpoints = std::vector<IPEndpoint>();
+    std::mutex mutex;
+
+    acceptor->OnAccepted += [&](std::shared_ptr<TcpConnection> conn) {
+        {
+            // Accepted without it, so it's looked up
+            std::lock_guard lock(mutex);
+            endpoints.push_back(conn->Endpoint());
+        }
+
+        conn->Write("goodbye", 7);
+    };
+
+    auto task = acceptor->Start();
+
+    for (int i = 0; i < 3; ++i) {
+        auto client = CreateClient();
+        WaitForGoodbye(*client);
+    }
+
+    acceptor->Stop();
+    task.get();
+
+    ASSERT_EQ(3, endpoints.size());
+
+    for (auto& ep : endpoints)
+        EXPECT_EQ((std::array<std::uint8_t, 4>{127, 0, 0, 1}), ep.GetAddress());
+}
+
 TEST_F(TcpTest, timeout_on_read) {
     auto server = CreateServer();
     auto task = server->Start([=](std::shared_ptr<TcpConnection> conn) {
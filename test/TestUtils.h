@@ -4,8 +4,11 @@
 
 #include <cstdlib>
 #include <memory>
+#include <stdexcept>
 #include <string>
+#include <string_view>
 #include <type_traits>
+#include <zlib.h>
 
 namespace Chili {
 
@@ -21,6 +24,54 @@ inline std::string GetEnvironmentVariable(const std::string& name) {
     return result ? result : "";
 }
 
+/**
+ * Removes any headers of the specified name from the response.
+ */
+inline std::string RemoveHeaders(std::string response, std::string_view name) {
+    auto line = "\r\n" + std::string(name) + ": ";
+    std::string::size_type position = 0;
+
+    while ((position = response.find(line, position)) != std::string::npos)
+        response.erase(position, response.find("\r\n", position + 2) - position);
+
+    return response;
+}
+
+/**
+ * Removes any Date headers from the response,
+ * as their value depends on when the test ran.
+ */
+inline std::string RemoveDateHeaders(std::string response) {
+    return RemoveHeaders(std::move(response), "Date");
+}
+
+/**
+ * Decompresses data in either zlib or gzip format.
+ */
+inline std::string Decompress(std::string_view data) {
+    z_stream stream{};
+    std::string result;
+    char buffer[0x100];
+    int status;
+
+    if (::inflateInit2(&stream, MAX_WBITS + 32) != Z_OK)
+        throw std::runtime_error("inflateInit2() failed");
+
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+    stream.avail_in = static_cast<uInt>(data.size());
+
+    do {
+        stream.next_out = reinterpret_cast<Bytef*>(buffer);
+        stream.avail_out = sizeof(buffer);
+        status = ::inflate(&stream, Z_NO_FLUSH);
+        result.append(buffer, sizeof(buffer) - stream.avail_out);
+    } while (status == Z_OK && (stream.avail_in > 0 || stream.avail_out == 0));
+
+    ::inflateEnd(&stream);
+
+    return result;
+}
+
 class AutoProfile {
 public:
     AutoProfile() {
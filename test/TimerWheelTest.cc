@@ -0,0 +1,184 @@
+#include <gmock/gmock.h>
+
+#include "TimerWheel.h"
+
+#include <chrono>
+#include <vector>
+
+using namespace ::testing;
+using namespace std::literals;
+
+namespace Chili {
+
+class TimerWheelTest : public Test {
+public:
+    TimerWheelTest() :
+        _wheel(1ms, 16),
+        _start(Clock::GetCurrentTime()) {
+    }
+
+protected:
+    TimerWheel _wheel;
+    Clock::TimePoint _start;
+};
+
+TEST_F(TimerWheelTest, expires_timers_by_deadline) {
+    std::vector<int> order;
+
+    TimerWheel::Timer t1, t2, t3;
+    t1.OnExpired = [&] { order.push_back(1); };
+    t2.OnExpired = [&] { order.push_back(2); };
+    t3.OnExpired = [&] { order.push_back(3); };
+
+    _wheel.Insert(t2, _start + 5ms);
+    _wheel.Insert(t1, _start + 2ms);
+    _wheel.Insert(t3, _start + 9ms);
+
+    EXPECT_EQ(3, _wheel.GetCount());
+    EXPECT_EQ(0, _wheel.Expire(_start + 1ms));
+    EXPECT_EQ(1, _wheel.Expire(_start + 3ms));
+    EXPECT_EQ(1, _wheel.Expire(_start + 6ms));
+    EXPECT_FALSE(t1.IsArmed());
+    EXPECT_FALSE(t2.IsArmed());
+    EXPECT_TRUE(t3.IsArmed());
+    EXPECT_EQ(1, _wheel.Expire(_start + 10ms));
+
+    EXPECT_THAT(order, ElementsAre(1, 2, 3));
+    EXPECT_EQ(0, _wheel.GetCount());
+}
+
+TEST_F(TimerWheelTest, cancelled_timer_does_not_expire) {
+    bool expired = false;
+
+    TimerWheel::Timer t;
+    t.OnExpired = [&] { expired = true; };
+
+    _wheel.Insert(t, _start + 3ms);
+    _wheel.Cancel(t);
+
+    EXPECT_FALSE(t.IsArmed());
+    EXPECT_EQ(0, _wheel.Expire(_start + 10ms));
+    EXPECT_FALSE(expired);
+
+    // Cancelling twice is fine
+    _wheel.Cancel(t);
+}
+
+TEST_F(TimerWheelTest, expires_deadlines_beyond_one_revolution) {
+    int expired = 0;
+
+    TimerWheel::Timer t;
+    t.OnExpired = [&] { ++expired; };
+
+    _wheel.Insert(t, _start + 40ms);
+
+    EXPECT_EQ(0, _wheel.Expire(_start + 16ms));
+    EXPECT_EQ(0, _wheel.Expire(_start + 39ms));
+    EXPECT_TRUE(t.IsArmed());
+    EXPECT_EQ(1, _wheel.Expire(_start + 41ms));
+    EXPECT_EQ(1, expired);
+}
+
+TEST_F(TimerWheelTest, timer_may_rearm_itself) {
+    int expired = 0;
+
+    TimerWheel::Timer t;
+    t.OnExpired = [&] {
+        if (++expired < 3)
+            _wheel.Insert(t, t.GetDeadline() + 4ms);
+    };
+
+    _wheel.Insert(t, _start + 4ms);
+
+    EXPECT_EQ(3, _wheel.Expire(_start + 20ms));
+    EXPECT_EQ(3, expired);
+    EXPECT_FALSE(t.IsArmed());
+}
+
+TEST_F(TimerWheelTest, moves_armed_timer) {
+    int expired = 0;
+
+    TimerWheel::Timer t;
+    t.OnExpired = [&] { ++expired; };
+
+    _wheel.Insert(t, _start + 2ms);
+    _wheel.Insert(t, _start + 8ms);
+
+    EXPECT_EQ(1, _wheel.GetCount());
+    EXPECT_EQ(0, _wheel.Expire(_start + 5ms));
+    EXPECT_EQ(1, _wheel.Expire(_start + 9ms));
+    EXPECT_EQ(1, expired);
+}
+
+TEST_F(TimerWheelTest, gets_next_expiry) {
+    EXPECT_EQ(Clock::TimePoint::max(), _wheel.GetNextExpiry());
+
+    TimerWheel::Timer t;
+    _wheel.Insert(t, _start + 7ms);
+
+    auto next = _wheel.GetNextExpiry();
+    EXPECT_GE(next, _start + 7ms);
+    EXPECT_LE(next, _start + 8ms);
+
+    _wheel.Cancel(t);
+    EXPECT_EQ(Clock::TimePoint::max(), _wheel.GetNextExpiry());
+}
+
+TEST_F(TimerWheelTest, gets_next_expiry_beyond_one_revolution) {
+    TimerWheel::Timer t1, t2;
+    _wheel.Insert(t1, _start + 35ms);
+    _wheel.Insert(t2, _start + 20ms);
+
+    // The first slot holding a timer is t1's,
+    // but t2 comes around sooner.
+    auto next = _wheel.GetNextExpiry();
+    EXPECT_GE(next, _start + 20ms);
+    EXPECT_LE(next, _start + 21ms);
+
+    _wheel.Cancel(t2);
+
+    next = _wheel.GetNextExpiry();
+    EXPECT_GE(next, _start + 35ms);
+    EXPECT_LE(next, _start + 36ms);
+
+    _wheel.Cancel(t1);
+}
+
+TEST_F(TimerWheelTest, gets_next_expiry_of_many_multi_round_timers) {
+    std::vector<TimerWheel::Timer> timers(100);
+
+    for (std::size_t i = 0; i < timers.size(); ++i)
+        _wheel.Insert(timers[i], _start + 40ms + i * 1ms);
+
+    auto next = _wheel.GetNextExpiry();
+    EXPECT_GE(next, _start + 40ms);
+    EXPECT_LE(next, _start + 41ms);
+
+    // Finding the next one means walking the timers
+    _wheel.Cancel(timers[0]);
+
+    next = _wheel.GetNextExpiry();
+    EXPECT_GE(next, _start + 41ms);
+    EXPECT_LE(next, _start + 42ms);
+
+    // Which is only done once per revolution, so until
+    // then it's the end of the current revolution,
+    // before which no timer can expire. The wheel's
+    // ticks started just before _start.
+    _wheel.Cancel(timers[1]);
+
+    next = _wheel.GetNextExpiry();
+    EXPECT_GT(next, _start + 15ms);
+    EXPECT_LE(next, _start + 16ms);
+
+    EXPECT_EQ(0, _wheel.Expire(next));
+
+    next = _wheel.GetNextExpiry();
+    EXPECT_GE(next, _start + 42ms);
+    EXPECT_LE(next, _start + 43ms);
+
+    for (auto& t : timers)
+        _wheel.Cancel(t);
+}
+
+} // namespace Chili